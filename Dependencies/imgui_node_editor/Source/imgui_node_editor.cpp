@@ -111,6 +111,10 @@ static const float c_LinkSelectThickness        = 5.0f;  // canvas pixels
 static const float c_NavigationZoomMargin       = 0.1f;  // percentage of visible bounds
 static const float c_MouseZoomDuration          = 0.15f; // seconds
 static const float c_SelectionFadeOutDuration   = 0.15f; // seconds
+static const float c_LodMinTextSize             = 5.0f;  // screen pixels, font height below which text is hidden
+static const float c_LodMinFlatTextSize         = 2.5f;  // screen pixels, font height below which nodes are flat
+static const float c_LinkSegmentLength          = 6.0f;  // screen pixels
+static const int   c_LinkMaxSegments            = 64;
 static const auto  c_ScrollButtonIndex          = 1;
 
 
@@ -450,7 +454,7 @@ static void ImDrawList_PolyFillScanFlood(ImDrawList *draw, std::vector<ImVec2>*
 
 static void ImDrawList_AddBezierWithArrows(ImDrawList* drawList, const ImCubicBezierPoints& curve, float thickness,
     float startArrowSize, float startArrowWidth, float endArrowSize, float endArrowWidth,
-    bool fill, ImU32 color, float strokeThickness)
+    bool fill, ImU32 color, float strokeThickness, int segments = 0)
 {
     using namespace ax;
 
@@ -461,7 +465,7 @@ static void ImDrawList_AddBezierWithArrows(ImDrawList* drawList, const ImCubicBe
 
     if (fill)
     {
-        drawList->AddBezierCurve(curve.P0, curve.P1, curve.P2, curve.P3, color, thickness);
+        drawList->AddBezierCurve(curve.P0, curve.P1, curve.P2, curve.P3, color, thickness, segments);
 
         if (startArrowSize > 0.0f)
         {
@@ -585,6 +589,8 @@ void ed::Node::UpdateDrag(const ImVec2& offset)
     auto size = m_Bounds.GetSize();
     m_Bounds.Min = ImFloor(m_DragStart + offset);
     m_Bounds.Max = m_Bounds.Min + size;
+
+    Editor->UpdateSpatialIndex(this);
 }
 
 bool ed::Node::EndDrag()
@@ -596,21 +602,24 @@ void ed::Node::Draw(ImDrawList* drawList, DrawFlags flags)
 {
     if (flags == Detail::Object::None)
     {
+        // Flat nodes are too small for rounding and borders to be seen.
+        const auto isFlat = Editor->GetLevelOfDetail() == LevelOfDetail::Flat;
+
         drawList->ChannelsSetCurrent(m_Channel + c_NodeBackgroundChannel);
 
         drawList->AddRectFilled(
             m_Bounds.Min,
             m_Bounds.Max,
-            m_Color, m_Rounding);
+            m_Color, isFlat ? 0.0f : m_Rounding);
 
         if (IsGroup(this))
         {
             drawList->AddRectFilled(
                 m_GroupBounds.Min,
                 m_GroupBounds.Max,
-                m_GroupColor, m_GroupRounding);
+                m_GroupColor, isFlat ? 0.0f : m_GroupRounding);
 
-            if (m_GroupBorderWidth > 0.0f)
+            if (!isFlat && m_GroupBorderWidth > 0.0f)
             {
                 FringeScaleScope fringe(1.0f);
 
@@ -641,7 +650,8 @@ void ed::Node::Draw(ImDrawList* drawList, DrawFlags flags)
         drawRect(GetRegionBounds(NodeRegion::Header), IM_COL32(0, 255, 255, 64));
 # endif
 
-        DrawBorder(drawList, m_BorderColor, m_BorderWidth);
+        if (!isFlat)
+            DrawBorder(drawList, m_BorderColor, m_BorderWidth);
     }
     else if (flags & Selected)
     {
@@ -858,12 +868,51 @@ void ed::Link::Draw(ImDrawList* drawList, ImU32 color, float extraThickness) con
 
     const auto curve = GetCurve();
 
+    // Full detail keeps ImGui's adaptive tessellation (0 segments). Zoomed out,
+    // tessellate by length on screen instead, the control polygon and chord
+    // average is close enough to the arc length.
+    auto segments = 0;
+    if (Editor->GetLevelOfDetail() != LevelOfDetail::Full)
+    {
+        const auto length = (ImLength(curve.P1 - curve.P0) + ImLength(curve.P2 - curve.P1) + ImLength(curve.P3 - curve.P2) + ImLength(curve.P3 - curve.P0)) * 0.5f;
+        segments = ImClamp(static_cast<int>(length * Editor->GetView().Scale / c_LinkSegmentLength), 1, c_LinkMaxSegments);
+    }
+
     ImDrawList_AddBezierWithArrows(drawList, curve, m_Thickness + extraThickness,
         m_StartPin && m_StartPin->m_ArrowSize  > 0.0f ? m_StartPin->m_ArrowSize  + extraThickness : 0.0f,
         m_StartPin && m_StartPin->m_ArrowWidth > 0.0f ? m_StartPin->m_ArrowWidth + extraThickness : 0.0f,
           m_EndPin &&   m_EndPin->m_ArrowSize  > 0.0f ?   m_EndPin->m_ArrowSize  + extraThickness : 0.0f,
           m_EndPin &&   m_EndPin->m_ArrowWidth > 0.0f ?   m_EndPin->m_ArrowWidth + extraThickness : 0.0f,
-        true, color, 1.0f);
+        true, color, 1.0f, segments);
+}
+
+void ed::Link::SetPins(Pin* startPin, Pin* endPin)
+{
+    if (m_StartPin == startPin && m_EndPin == endPin)
+        return;
+
+    auto detach = [this](Pin* pin)
+    {
+        auto& links = pin->m_Links;
+        auto it = std::find(links.begin(), links.end(), this);
+        if (it != links.end())
+        {
+            *it = links.back();
+            links.pop_back();
+        }
+    };
+
+    if (m_StartPin)
+        detach(m_StartPin);
+    if (m_EndPin && m_EndPin != m_StartPin)
+        detach(m_EndPin);
+
+    m_StartPin = startPin;
+    m_EndPin   = endPin;
+
+    m_StartPin->m_Links.push_back(this);
+    if (m_EndPin != m_StartPin)
+        m_EndPin->m_Links.push_back(this);
 }
 
 void ed::Link::UpdateEndpoints()
@@ -1015,10 +1064,15 @@ ed::EditorContext::EditorContext(const ax::NodeEditor::Config* config)
     , m_Nodes()
     , m_Pins()
     , m_Links()
+    , m_LiveNodeCount(0)
+    , m_LiveLinkCount(0)
+    , m_CulledNodeCount(0)
+    , m_CulledLinkCount(0)
     , m_SelectionId(1)
     , m_LastActiveLink(nullptr)
     , m_Canvas()
     , m_IsCanvasVisible(false)
+    , m_LevelOfDetail(LevelOfDetail::Full)
     , m_NodeBuilder(this)
     , m_HintBuilder(this)
     , m_CurrentAction(nullptr)
@@ -1049,6 +1103,13 @@ ed::EditorContext::~EditorContext()
     if (m_IsInitialized)
         SaveSettings();
 
+    m_LinkIndex.Clear();
+    m_PinIndex.Clear();
+    m_NodeIndex.Clear();
+
+    m_LinkGrid.Clear();
+    m_NodeGrid.Clear();
+
     for (auto link  : m_Links)  delete link.m_Object;
     for (auto pin   : m_Pins)   delete pin.m_Object;
     for (auto node  : m_Nodes)  delete node.m_Object;
@@ -1070,6 +1131,8 @@ void ed::EditorContext::Begin(const char* id, const ImVec2& size)
     for (auto node  : m_Nodes)   node->Reset();
     for (auto pin   : m_Pins)     pin->Reset();
     for (auto link  : m_Links)   link->Reset();
+    m_LiveNodeCount = 0;
+    m_LiveLinkCount = 0;
 
     auto drawList = ImGui::GetWindowDrawList();
 
@@ -1112,6 +1175,14 @@ void ed::EditorContext::Begin(const char* id, const ImVec2& size)
 
     m_Canvas.SetView(m_NavigateAction.GetView());
 
+    const auto textSize = ImGui::GetFontSize() * m_Canvas.ViewScale();
+    if (textSize < c_LodMinFlatTextSize)
+        m_LevelOfDetail = LevelOfDetail::Flat;
+    else if (textSize < c_LodMinTextSize)
+        m_LevelOfDetail = LevelOfDetail::NoText;
+    else
+        m_LevelOfDetail = LevelOfDetail::Full;
+
     // #debug #clip
     //ImGui::Text("CLIP = { x=%g y=%g w=%g h=%g r=%g b=%g }",
     //    clipMin.x, clipMin.y, clipMax.x - clipMin.x, clipMax.y - clipMin.y, clipMax.x, clipMax.y);
@@ -1125,6 +1196,16 @@ void ed::EditorContext::Begin(const char* id, const ImVec2& size)
     m_LastSelectedObjects = m_SelectedObjects;
 }
 
+static inline bool IsDrawnBefore(const ed::Node* lhs, const ed::Node* rhs)
+{
+    return lhs->m_GridEntry.m_Order < rhs->m_GridEntry.m_Order;
+}
+
+static inline bool IsDrawnBefore(const ed::Link* lhs, const ed::Link* rhs)
+{
+    return lhs->m_ID.AsPointer() < rhs->m_ID.AsPointer();
+}
+
 void ed::EditorContext::End()
 {
     //auto& io          = ImGui::GetIO();
@@ -1147,15 +1228,43 @@ void ed::EditorContext::End()
     const bool isDragging  = m_CurrentAction && m_CurrentAction->AsDrag()   != nullptr;
     //const bool isSizing    = CurrentAction && CurrentAction->AsSize()   != nullptr;
 
-    // Draw nodes
-    for (auto node : m_Nodes)
-        if (node->m_IsLive && node->IsVisible())
-            node->Draw(drawList);
+    // Only objects overlapping the view are drawn, in the order they would be without culling.
+    const auto viewRect = GetViewRect();
+
+    // Draw nodes, the grid hands out everything in the cells the view touches
+    m_VisibleNodes.resize(0);
+    m_NodeGrid.Query(viewRect, [this, &viewRect](Node* node)
+    {
+        if (node->m_IsLive && viewRect.Overlaps(node->GetBounds()))
+            m_VisibleNodes.push_back(node);
+    });
+
+    std::sort(m_VisibleNodes.begin(), m_VisibleNodes.end(), [](Node* lhs, Node* rhs) { return IsDrawnBefore(lhs, rhs); });
+
+    for (auto node : m_VisibleNodes)
+        node->Draw(drawList);
 
     // Draw links
-    for (auto link : m_Links)
-        if (link->m_IsLive && link->IsVisible())
-            link->Draw(drawList);
+    m_VisibleLinks.resize(0);
+    m_LinkGrid.Query(viewRect, [this, &viewRect](Link* link)
+    {
+        if (!link->m_IsLive)
+            return;
+
+        // Curve bounds (with arrows), plus what the stroke adds on either side
+        auto bounds = link->GetBounds();
+        bounds.Expand(link->m_Thickness * 0.5f);
+        if (viewRect.Overlaps(bounds))
+            m_VisibleLinks.push_back(link);
+    });
+
+    std::sort(m_VisibleLinks.begin(), m_VisibleLinks.end(), [](Link* lhs, Link* rhs) { return IsDrawnBefore(lhs, rhs); });
+
+    for (auto link : m_VisibleLinks)
+        link->Draw(drawList);
+
+    m_CulledNodeCount = m_LiveNodeCount - (int)m_VisibleNodes.size();
+    m_CulledLinkCount = m_LiveLinkCount - (int)m_VisibleLinks.size();
 
     // Highlight selected objects
     {
@@ -1281,13 +1390,16 @@ void ed::EditorContext::End()
         });
     }
 
+    for (int i = 0; i < static_cast<int>(m_Nodes.size()); ++i)
+        m_Nodes[i]->m_GridEntry.m_Order = i;
+
 # if 1
     // Every node has few channels assigned. Grow channel list
     // to hold twice as much of channels and place them in
     // node drawing order.
     {
         // Copy group nodes
-        auto liveNodeCount = static_cast<int>(std::count_if(m_Nodes.begin(), m_Nodes.end(), [](Node* node) { return node->m_IsLive; }));
+        auto liveNodeCount = m_LiveNodeCount;
 
         // Reserve two additional channels for sorted list of channels
         auto nodeChannelCount = drawList->_Splitter._Count;
@@ -1469,14 +1581,15 @@ bool ed::EditorContext::DoLink(LinkId id, PinId startPinId, PinId endPinId, ImU3
       endPin->m_HasConnection = true;
 
     auto link           = GetLink(id);
-    link->m_StartPin      = startPin;
-    link->m_EndPin        = endPin;
+    link->SetPins(startPin, endPin);
     link->m_Color         = color;
     link->m_Thickness     = thickness;
-    link->m_IsLive        = true;
+    MarkLive(link);
 
     link->UpdateEndpoints();
 
+    UpdateSpatialIndex(link);
+
     return true;
 }
 
@@ -1494,6 +1607,7 @@ void ed::EditorContext::SetNodePosition(NodeId nodeId, const ImVec2& position)
         node->m_Bounds.Translate(position - node->m_Bounds.Min);
         node->m_Bounds.Floor();
         MakeDirty(NodeEditor::SaveReasonFlags::Position, node);
+        UpdateSpatialIndex(node);
     }
 }
 
@@ -1536,6 +1650,8 @@ void ed::EditorContext::RestoreNodeState(Node* node)
     node->m_GroupBounds.Min = settings->m_Location;
     node->m_GroupBounds.Max = node->m_GroupBounds.Min + settings->m_GroupSize;
     node->m_GroupBounds.Floor();
+
+    UpdateSpatialIndex(node);
 }
 
 void ed::EditorContext::ClearSelection()
@@ -1602,13 +1718,32 @@ bool ed::EditorContext::HasSelectionChanged()
     return m_LastSelectedObjects != m_SelectedObjects;
 }
 
+void ed::EditorContext::UpdateSpatialIndex(Node* node)
+{
+    m_NodeGrid.Update(node, node->GetBounds());
+}
+
+void ed::EditorContext::UpdateSpatialIndex(Link* link)
+{
+    // Grown by pick distance, so point queries find links they are near to.
+    auto bounds = link->GetBounds();
+    if (!ImRect_IsEmpty(bounds))
+        bounds.Expand(c_LinkSelectThickness);
+
+    m_LinkGrid.Update(link, bounds);
+}
+
 ed::Node* ed::EditorContext::FindNodeAt(const ImVec2& p)
 {
-    for (auto node : m_Nodes)
-        if (node->TestHit(p))
-            return node;
+    Node* result = nullptr;
 
-    return nullptr;
+    m_NodeGrid.Query(p, [&result, &p](Node* node)
+    {
+        if ((!result || IsDrawnBefore(node, result)) && node->TestHit(p))
+            result = node;
+    });
+
+    return result;
 }
 
 void ed::EditorContext::FindNodesInRect(const ImRect& r, vector<Node*>& result, bool append, bool includeIntersecting)
@@ -1619,9 +1754,15 @@ void ed::EditorContext::FindNodesInRect(const ImRect& r, vector<Node*>& result,
     if (ImRect_IsEmpty(r))
         return;
 
-    for (auto node : m_Nodes)
+    const auto first = result.size();
+
+    m_NodeGrid.Query(r, [&result, &r, includeIntersecting](Node* node)
+    {
         if (node->TestHit(r, includeIntersecting))
             result.push_back(node);
+    });
+
+    std::sort(result.begin() + first, result.end(), [](Node* lhs, Node* rhs) { return IsDrawnBefore(lhs, rhs); });
 }
 
 void ed::EditorContext::FindLinksInRect(const ImRect& r, vector<Link*>& result, bool append)
@@ -1632,9 +1773,15 @@ void ed::EditorContext::FindLinksInRect(const ImRect& r, vector<Link*>& result,
     if (ImRect_IsEmpty(r))
         return;
 
-    for (auto link : m_Links)
+    const auto first = result.size();
+
+    m_LinkGrid.Query(r, [&result, &r](Link* link)
+    {
         if (link->TestHit(r))
             result.push_back(link);
+    });
+
+    std::sort(result.begin() + first, result.end(), [](Link* lhs, Link* rhs) { return IsDrawnBefore(lhs, rhs); });
 }
 
 void ed::EditorContext::FindLinksForNode(NodeId nodeId, vector<Link*>& result, bool add)
@@ -1642,13 +1789,26 @@ void ed::EditorContext::FindLinksForNode(NodeId nodeId, vector<Link*>& result, b
     if (!add)
         result.clear();
 
-    for (auto link : m_Links)
+    auto node = FindNode(nodeId);
+    if (!node)
+        return;
+
+    // Live links are connected to live pins, which are all chained to the node
+    // they were submitted in this frame.
+    for (auto pin = node->m_LastPin; pin; pin = pin->m_PreviousPin)
     {
-        if (!link->m_IsLive)
+        if (!pin->m_IsLive || pin->m_Node != node)
             continue;
 
-        if (link->m_StartPin->m_Node->m_ID == nodeId || link->m_EndPin->m_Node->m_ID == nodeId)
-            result.push_back(link);
+        for (auto link : pin->m_Links)
+        {
+            if (!link->m_IsLive)
+                continue;
+
+            // Link between two pins of this node is reported by its start pin only.
+            if (link->m_StartPin == pin || link->m_StartPin->m_Node != node)
+                result.push_back(link);
+        }
     }
 }
 
@@ -1699,12 +1859,20 @@ bool ed::EditorContext::IsActive()
     return m_IsWindowActive;
 }
 
+// Pins and links are drawn and iterated in id order, lookups go through
+// the index, so keeping order only needs a single insert.
+template <typename C>
+static inline void InsertSorted(C& container, const typename C::value_type& item)
+{
+    container.insert(std::upper_bound(container.begin(), container.end(), item), item);
+}
+
 ed::Pin* ed::EditorContext::CreatePin(PinId id, PinKind kind)
 {
     IM_ASSERT(nullptr == FindObject(id));
     auto pin = new Pin(this, id, kind);
-    m_Pins.push_back({id, pin});
-    std::sort(m_Pins.begin(), m_Pins.end());
+    InsertSorted(m_Pins, {id, pin});
+    m_PinIndex.Insert(id, pin);
     return pin;
 }
 
@@ -1713,6 +1881,7 @@ ed::Node* ed::EditorContext::CreateNode(NodeId id)
     IM_ASSERT(nullptr == FindObject(id));
     auto node = new Node(this, id);
     m_Nodes.push_back({id, node});
+    m_NodeIndex.Insert(id, node);
     //std::sort(Nodes.begin(), Nodes.end());
 
     auto settings = m_Settings.FindNode(id);
@@ -1739,6 +1908,9 @@ ed::Node* ed::EditorContext::CreateNode(NodeId id)
 
     node->m_IsLive = false;
 
+    node->m_GridEntry.m_Order = static_cast<int>(m_Nodes.size()) - 1;
+    UpdateSpatialIndex(node);
+
     return node;
 }
 
@@ -1746,67 +1918,26 @@ ed::Link* ed::EditorContext::CreateLink(LinkId id)
 {
     IM_ASSERT(nullptr == FindObject(id));
     auto link = new Link(this, id);
-    m_Links.push_back({id, link});
-    std::sort(m_Links.begin(), m_Links.end());
+    link->m_IsLive = false;
+    InsertSorted(m_Links, {id, link});
+    m_LinkIndex.Insert(id, link);
 
     return link;
 }
 
-template <typename C, typename Id>
-static inline auto FindItemInLinear(C& container, Id id)
-{
-# if defined(_DEBUG)
-    auto start = container.data();
-    auto end   = container.data() + container.size();
-    for (auto it = start; it < end; ++it)
-        if ((*it).m_ID == id)
-            return it->m_Object;
-# else
-    for (auto item : container)
-        if (item.m_ID == id)
-            return item.m_Object;
-# endif
-
-   return static_cast<decltype(container[0].m_Object)>(nullptr);
-}
-
-template <typename C, typename Id>
-static inline auto FindItemIn(C& container, Id id)
-{
-//# if defined(_DEBUG)
-//    auto start = container.data();
-//    auto end   = container.data() + container.size();
-//    for (auto it = start; it < end; ++it)
-//        if ((*it)->ID == id)
-//            return *it;
-//# else
-//    for (auto item : container)
-//        if (item->ID == id)
-//            return item;
-//# endif
-    auto key = typename C::value_type{ id, nullptr };
-    auto first = container.cbegin();
-    auto last  = container.cend();
-    auto it    = std::lower_bound(first, last, key);
-    if (it != last && (key.m_ID == it->m_ID))
-        return it->m_Object;
-    else
-        return static_cast<decltype(it->m_Object)>(nullptr);
-}
-
 ed::Node* ed::EditorContext::FindNode(NodeId id)
 {
-    return FindItemInLinear(m_Nodes, id);
+    return m_NodeIndex.Find(id);
 }
 
 ed::Pin* ed::EditorContext::FindPin(PinId id)
 {
-    return FindItemIn(m_Pins, id);
+    return m_PinIndex.Find(id);
 }
 
 ed::Link* ed::EditorContext::FindLink(LinkId id)
 {
-    return FindItemIn(m_Links, id);
+    return m_LinkIndex.Find(id);
 }
 
 ed::Object* ed::EditorContext::FindObject(ObjectId id)
@@ -1900,7 +2031,16 @@ void ed::EditorContext::MakeDirty(SaveReasonFlags reason, Node* node)
 
 ed::Link* ed::EditorContext::FindLinkAt(const ImVec2& p)
 {
-    for (auto& link : m_Links)
+    // Projecting on curve is costly, test in drawing order and stop on first hit.
+    m_LinkCandidates.resize(0);
+    m_LinkGrid.Query(p, [this](Link* link)
+    {
+        m_LinkCandidates.push_back(link);
+    });
+
+    std::sort(m_LinkCandidates.begin(), m_LinkCandidates.end(), [](Link* lhs, Link* rhs) { return IsDrawnBefore(lhs, rhs); });
+
+    for (auto link : m_LinkCandidates)
         if (link->TestHit(p, c_LinkSelectThickness))
             return link;
 
@@ -2177,9 +2317,9 @@ void ed::EditorContext::ShowMetrics(const Control& control)
             return "<unknown>";
     };
 
-    auto liveNodeCount  = (int)std::count_if(m_Nodes.begin(),  m_Nodes.end(),  [](Node*  node)  { return  node->m_IsLive; });
+    auto liveNodeCount  = m_LiveNodeCount;
     auto livePinCount   = (int)std::count_if(m_Pins.begin(),   m_Pins.end(),   [](Pin*   pin)   { return   pin->m_IsLive; });
-    auto liveLinkCount  = (int)std::count_if(m_Links.begin(),  m_Links.end(),  [](Link*  link)  { return  link->m_IsLive; });
+    auto liveLinkCount  = m_LiveLinkCount;
 
     auto canvasRect     = m_Canvas.Rect();
     auto viewRect       = m_Canvas.ViewRect();
@@ -2196,6 +2336,8 @@ void ed::EditorContext::ShowMetrics(const Control& control)
     ImGui::Text("Live Nodes: %d", liveNodeCount);
     ImGui::Text("Live Pins: %d", livePinCount);
     ImGui::Text("Live Links: %d", liveLinkCount);
+    ImGui::Text("Culled Nodes: %d", m_CulledNodeCount);
+    ImGui::Text("Culled Links: %d", m_CulledLinkCount);
     ImGui::Text("Hot Object: %s (%p)", getHotObjectName(), control.HotObject ? control.HotObject->ID().AsPointer() : nullptr);
     if (auto node = control.HotObject ? control.HotObject->AsNode() : nullptr)
     {
@@ -3297,6 +3439,8 @@ bool ed::SizeAction::Process(const Control& control)
         m_SizedNode->m_GroupBounds.Min.y -= m_StartBounds.Min.y - m_StartGroupBounds.Min.y;
         m_SizedNode->m_GroupBounds.Max.x -= m_StartBounds.Max.x - m_StartGroupBounds.Max.x;
         m_SizedNode->m_GroupBounds.Max.y -= m_StartBounds.Max.y - m_StartGroupBounds.Max.y;
+
+        Editor->UpdateSpatialIndex(m_SizedNode);
     }
     else if (!control.ActiveNode)
     {
@@ -4656,7 +4800,8 @@ void ed::DeleteItemsAction::RemoveItem()
 ed::NodeBuilder::NodeBuilder(EditorContext* editor):
     Editor(editor),
     m_CurrentNode(nullptr),
-    m_CurrentPin(nullptr)
+    m_CurrentPin(nullptr),
+    m_LevelOfDetail(LevelOfDetail::Full)
 {
 }
 
@@ -4696,6 +4841,7 @@ void ed::NodeBuilder::Begin(NodeId nodeId)
                     node->m_Bounds.Translate(ImFloor(offset));
                     node->m_GroupBounds.Translate(ImFloor(offset));
                     Editor->MakeDirty(SaveReasonFlags::Position | SaveReasonFlags::User, node);
+                    Editor->UpdateSpatialIndex(node);
                 }
             }
             else
@@ -4716,7 +4862,7 @@ void ed::NodeBuilder::Begin(NodeId nodeId)
 
     const auto alpha = ImGui::GetStyle().Alpha;
 
-    m_CurrentNode->m_IsLive           = true;
+    Editor->MarkLive(m_CurrentNode);
     m_CurrentNode->m_LastPin          = nullptr;
     m_CurrentNode->m_Color            = Editor->GetColor(StyleColor_NodeBg, alpha);
     m_CurrentNode->m_BorderColor      = Editor->GetColor(StyleColor_NodeBorder, alpha);
@@ -4749,12 +4895,28 @@ void ed::NodeBuilder::Begin(NodeId nodeId)
         ImGui::SetCursorPos(ImGui::GetCursorPos() + ImVec2(editorStyle.NodePadding.x, editorStyle.NodePadding.y));
         ImGui::BeginGroup();
     }
+
+    // Content is still laid out, so node and pin sizes do not change with zoom.
+    // It is only made transparent, which draw list skips without generating vertices.
+    m_LevelOfDetail = Editor->GetLevelOfDetail();
+    if (m_LevelOfDetail == LevelOfDetail::Flat)
+        ImGui::PushStyleVar(ImGuiStyleVar_Alpha, 0.0f);
+    else if (m_LevelOfDetail == LevelOfDetail::NoText)
+    {
+        ImGui::PushStyleColor(ImGuiCol_Text, IM_COL32_BLACK_TRANS);
+        ImGui::PushStyleColor(ImGuiCol_TextDisabled, IM_COL32_BLACK_TRANS);
+    }
 }
 
 void ed::NodeBuilder::End()
 {
     IM_ASSERT(nullptr != m_CurrentNode);
 
+    if (m_LevelOfDetail == LevelOfDetail::Flat)
+        ImGui::PopStyleVar();
+    else if (m_LevelOfDetail == LevelOfDetail::NoText)
+        ImGui::PopStyleColor(2);
+
     if (auto drawList = ImGui::GetWindowDrawList())
     {
         IM_ASSERT(drawList->_Splitter._Count == 1); // Did you forgot to call drawList->ChannelsMerge()?
@@ -4797,6 +4959,8 @@ void ed::NodeBuilder::End()
     else
         m_CurrentNode->m_Type        = NodeType::Node;
 
+    Editor->UpdateSpatialIndex(m_CurrentNode);
+
     m_CurrentNode = nullptr;
 }
 
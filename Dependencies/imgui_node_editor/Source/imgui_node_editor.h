@@ -330,6 +330,12 @@ void EndShortcut();
 
 float GetCurrentZoom();
 
+// Objects drawn by the last End(), and live ones skipped for being outside the view.
+int GetVisibleNodeCount();
+int GetVisibleLinkCount();
+int GetCulledNodeCount();
+int GetCulledLinkCount();
+
 NodeId GetDoubleClickedNode();
 PinId GetDoubleClickedPin();
 LinkId GetDoubleClickedLink();
@@ -591,6 +591,26 @@ float ax::NodeEditor::GetCurrentZoom()
     return s_Editor->GetView().InvScale;
 }
 
+int ax::NodeEditor::GetVisibleNodeCount()
+{
+    return s_Editor->GetVisibleNodeCount();
+}
+
+int ax::NodeEditor::GetVisibleLinkCount()
+{
+    return s_Editor->GetVisibleLinkCount();
+}
+
+int ax::NodeEditor::GetCulledNodeCount()
+{
+    return s_Editor->GetCulledNodeCount();
+}
+
+int ax::NodeEditor::GetCulledLinkCount()
+{
+    return s_Editor->GetCulledLinkCount();
+}
+
 ax::NodeEditor::NodeId ax::NodeEditor::GetDoubleClickedNode()
 {
     return s_Editor->GetDoubleClickedNode();
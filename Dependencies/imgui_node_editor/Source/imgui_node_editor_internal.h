@@ -28,6 +28,9 @@
 
 # include <vector>
 # include <string>
+# include <cstdint>
+# include <unordered_map>
+# include <utility>
 
 
 //------------------------------------------------------------------------------
@@ -196,6 +199,268 @@ struct ObjectWrapper
     }
 };
 
+// Open addressing (linear probing) map from object id to object, so lookups
+// do not depend on how many objects editor holds. Empty slots have no object,
+// which leaves every id value usable as a key. Table is kept at most half full.
+// Editor never destroys objects, so entries are only ever added.
+template <typename T, typename Id = typename T::IdType>
+struct ObjectIndex
+{
+    using Slot = ObjectWrapper<T, Id>;
+
+    T* Find(Id id) const
+    {
+        if (m_Slots.empty())
+            return nullptr;
+
+        for (auto i = SlotFor(id); ; i = (i + 1) & (m_Slots.size() - 1))
+        {
+            auto& slot = m_Slots[i];
+            if (!slot.m_Object)
+                return nullptr;
+            if (slot.m_ID == id)
+                return slot.m_Object;
+        }
+    }
+
+    void Insert(Id id, T* object)
+    {
+        IM_ASSERT(object != nullptr);
+
+        if ((m_Count + 1) * 2 > m_Slots.size())
+            Rehash(m_Slots.empty() ? 64 : m_Slots.size() * 2);
+
+        auto i = SlotFor(id);
+        while (m_Slots[i].m_Object && m_Slots[i].m_ID != id)
+            i = (i + 1) & (m_Slots.size() - 1);
+
+        if (!m_Slots[i].m_Object)
+            ++m_Count;
+
+        m_Slots[i] = Slot{ id, object };
+    }
+
+    void Clear()
+    {
+        m_Slots.clear();
+        m_Count = 0;
+    }
+
+    size_t Size() const { return m_Count; }
+
+private:
+    size_t SlotFor(Id id) const
+    {
+        // Fibonacci hashing, ids are often small consecutive integers.
+        auto hash = static_cast<uint64_t>(id.Get()) * UINT64_C(0x9E3779B97F4A7C15);
+        return static_cast<size_t>(hash ^ (hash >> 32)) & (m_Slots.size() - 1);
+    }
+
+    void Rehash(size_t capacity)
+    {
+        vector<Slot> slots(capacity, Slot{ Id(), nullptr });
+        m_Slots.swap(slots);
+        m_Count = 0;
+
+        for (auto& slot : slots)
+            if (slot.m_Object)
+                Insert(slot.m_ID, slot.m_Object);
+    }
+
+    vector<Slot> m_Slots;
+    size_t       m_Count = 0;
+};
+
+// Where object currently sits in a SpatialGrid. Cells are inclusive.
+struct SpatialGridEntry
+{
+    int      m_MinX        = 0;
+    int      m_MinY        = 0;
+    int      m_MaxX        = -1;
+    int      m_MaxY        = -1;
+    bool     m_IsInGrid    = false;
+    bool     m_IsOversized = false;
+    uint32_t m_LastQuery   = 0;
+
+    // Position in editor drawing order, so queries can report objects the same
+    // way a walk over all of them would.
+    int      m_Order       = 0;
+};
+
+// Uniform grid over canvas space. Objects are put in every cell their bounds
+// touch and are moved only when set of cells changes, so most frames updating
+// is a few compares. Objects spanning too many cells (big groups, long links)
+// are kept on a separate list that every query visits.
+//
+// Queries report candidates only, callers still have to test them.
+template <typename T>
+struct SpatialGrid
+{
+    void Update(T* object, const ImRect& bounds)
+    {
+        auto& entry = object->m_GridEntry;
+
+        if (ImRect_IsEmpty(bounds))
+        {
+            Remove(object);
+            return;
+        }
+
+        const int minX = CellOf(bounds.Min.x);
+        const int minY = CellOf(bounds.Min.y);
+        const int maxX = CellOf(bounds.Max.x);
+        const int maxY = CellOf(bounds.Max.y);
+
+        if (entry.m_IsInGrid && entry.m_MinX == minX && entry.m_MinY == minY && entry.m_MaxX == maxX && entry.m_MaxY == maxY)
+            return;
+
+        Remove(object);
+
+        entry.m_MinX        = minX;
+        entry.m_MinY        = minY;
+        entry.m_MaxX        = maxX;
+        entry.m_MaxY        = maxY;
+        entry.m_IsInGrid    = true;
+        entry.m_IsOversized = static_cast<int64_t>(maxX - minX + 1) * (maxY - minY + 1) > c_MaxCellsPerObject;
+
+        if (entry.m_IsOversized)
+        {
+            m_Oversized.push_back(object);
+            return;
+        }
+
+        for (int y = minY; y <= maxY; ++y)
+            for (int x = minX; x <= maxX; ++x)
+                m_Cells[Key(x, y)].push_back(object);
+    }
+
+    void Remove(T* object)
+    {
+        auto& entry = object->m_GridEntry;
+        if (!entry.m_IsInGrid)
+            return;
+
+        entry.m_IsInGrid = false;
+
+        if (entry.m_IsOversized)
+        {
+            SwapRemove(m_Oversized, object);
+            return;
+        }
+
+        for (int y = entry.m_MinY; y <= entry.m_MaxY; ++y)
+        {
+            for (int x = entry.m_MinX; x <= entry.m_MaxX; ++x)
+            {
+                auto cellIt = m_Cells.find(Key(x, y));
+                if (cellIt == m_Cells.end())
+                    continue;
+
+                SwapRemove(cellIt->second, object);
+                if (cellIt->second.empty())
+                    m_Cells.erase(cellIt);
+            }
+        }
+    }
+
+    void Clear()
+    {
+        m_Cells.clear();
+        m_Oversized.clear();
+    }
+
+    // Calls visitor once for every object whose cells touch the rect.
+    template <typename F>
+    void Query(const ImRect& rect, F&& visitor)
+    {
+        const auto query = ++m_Query;
+        auto visit = [query, &visitor](T* object)
+        {
+            if (object->m_GridEntry.m_LastQuery == query)
+                return;
+            object->m_GridEntry.m_LastQuery = query;
+            visitor(object);
+        };
+
+        for (auto object : m_Oversized)
+            visit(object);
+
+        const int minX = CellOf(rect.Min.x);
+        const int minY = CellOf(rect.Min.y);
+        const int maxX = CellOf(rect.Max.x);
+        const int maxY = CellOf(rect.Max.y);
+
+        // Big rects (box selecting zoomed out) cover more cells than
+        // there are in use, walk those instead.
+        if (static_cast<int64_t>(maxX - minX + 1) * (maxY - minY + 1) > static_cast<int64_t>(m_Cells.size()))
+        {
+            for (auto& cell : m_Cells)
+            {
+                const int x = static_cast<int32_t>(cell.first >> 32);
+                const int y = static_cast<int32_t>(cell.first & 0xFFFFFFFF);
+                if (x < minX || x > maxX || y < minY || y > maxY)
+                    continue;
+
+                for (auto object : cell.second)
+                    visit(object);
+            }
+
+            return;
+        }
+
+        for (int y = minY; y <= maxY; ++y)
+        {
+            for (int x = minX; x <= maxX; ++x)
+            {
+                auto cellIt = m_Cells.find(Key(x, y));
+                if (cellIt == m_Cells.end())
+                    continue;
+
+                for (auto object : cellIt->second)
+                    visit(object);
+            }
+        }
+    }
+
+    template <typename F>
+    void Query(const ImVec2& point, F&& visitor)
+    {
+        Query(ImRect(point, point), std::forward<F>(visitor));
+    }
+
+private:
+    static constexpr float c_CellSize          = 256.0f; // canvas pixels
+    static constexpr int   c_MaxCellsPerObject = 64;
+    static constexpr float c_MaxCellCoordinate = 1 << 30;
+
+    static int CellOf(float value)
+    {
+        return static_cast<int>(ImClamp(ImFloor(value / c_CellSize), -c_MaxCellCoordinate, c_MaxCellCoordinate));
+    }
+
+    static uint64_t Key(int x, int y)
+    {
+        return (static_cast<uint64_t>(static_cast<uint32_t>(x)) << 32) | static_cast<uint32_t>(y);
+    }
+
+    static void SwapRemove(vector<T*>& objects, T* object)
+    {
+        for (auto& item : objects)
+        {
+            if (item == object)
+            {
+                item = objects.back();
+                objects.pop_back();
+                return;
+            }
+        }
+    }
+
+    std::unordered_map<uint64_t, vector<T*>> m_Cells;
+    vector<T*>                               m_Oversized;
+    uint32_t                                 m_Query = 0;
+};
+
 struct Object
 {
     enum DrawFlags
@@ -214,6 +479,8 @@ struct Object
 
     bool    m_IsLive;
 
+    SpatialGridEntry m_GridEntry;
+
     Object(EditorContext* editor)
         : Editor(editor)
         , m_IsLive(true)
@@ -298,6 +565,10 @@ struct Pin final: Object
     bool    m_HasConnection;
     bool    m_HadConnection;
 
+    // Links ending at this pin, kept up to date by Link::SetPins(). Dead links are
+    // not removed, check m_IsLive.
+    vector<Link*> m_Links;
+
     Pin(EditorContext* editor, PinId id, PinKind kind)
         : Object(editor)
         , m_ID(id)
@@ -340,6 +611,14 @@ struct Pin final: Object
     virtual Pin* AsPin() override final { return this; }
 };
 
+// How much of the canvas is drawn, picked from the zoom level in EditorContext::Begin().
+enum class LevelOfDetail
+{
+    Full,   // everything
+    NoText, // text is too small to read, it is not drawn
+    Flat    // node content is not drawn, nodes are plain rects
+};
+
 enum class NodeType
 {
     Node,
@@ -461,6 +740,7 @@ struct Link final: Object
     virtual void Draw(ImDrawList* drawList, DrawFlags flags = None) override final;
     void Draw(ImDrawList* drawList, ImU32 color, float extraThickness = 0.0f) const;
 
+    void SetPins(Pin* startPin, Pin* endPin);
     void UpdateEndpoints();
 
     ImCubicBezierPoints GetCurve() const;
@@ -1144,6 +1424,8 @@ struct NodeBuilder
     ImRect m_GroupBounds;
     bool   m_IsGroup;
 
+    LevelOfDetail m_LevelOfDetail;
+
     ImDrawListSplitter m_Splitter;
     ImDrawListSplitter m_PinSplitter;
 
@@ -1270,6 +1552,13 @@ struct EditorContext
     const ImGuiEx::CanvasView& GetView() const { return m_Canvas.View(); }
     const ImRect& GetViewRect() const { return m_Canvas.ViewRect(); }
     const ImRect& GetRect() const { return m_Canvas.Rect(); }
+    LevelOfDetail GetLevelOfDetail() const { return m_LevelOfDetail; }
+
+    // What the last End() drew, and how many live objects it left out as off view.
+    int GetVisibleNodeCount() const { return (int)m_VisibleNodes.size(); }
+    int GetVisibleLinkCount() const { return (int)m_VisibleLinks.size(); }
+    int GetCulledNodeCount() const { return m_CulledNodeCount; }
+    int GetCulledLinkCount() const { return m_CulledLinkCount; }
 
     void SetNodePosition(NodeId nodeId, const ImVec2& screenPosition);
     ImVec2 GetNodePosition(NodeId nodeId);
@@ -1290,6 +1579,27 @@ struct EditorContext
     bool HasSelectionChanged();
     uint64_t GetSelectionId() const { return m_SelectionId; }
 
+    // Call whenever node or link bounds may have changed, keeps hit testing
+    // and culling from having to walk every object.
+    void UpdateSpatialIndex(Node* node);
+    void UpdateSpatialIndex(Link* link);
+
+    // Objects go live through these, so live counts stay current without a pass
+    // over every object. Begin() makes everything dead again.
+    void MarkLive(Node* node)
+    {
+        if (!node->m_IsLive)
+            ++m_LiveNodeCount;
+        node->m_IsLive = true;
+    }
+
+    void MarkLive(Link* link)
+    {
+        if (!link->m_IsLive)
+            ++m_LiveLinkCount;
+        link->m_IsLive = true;
+    }
+
     Node* FindNodeAt(const ImVec2& p);
     void FindNodesInRect(const ImRect& r, vector<Node*>& result, bool append = false, bool includeIntersecting = true);
     void FindLinksInRect(const ImRect& r, vector<Link*>& result, bool append = false);
@@ -1415,6 +1725,20 @@ private:
     vector<ObjectWrapper<Pin>>  m_Pins;
     vector<ObjectWrapper<Link>> m_Links;
 
+    ObjectIndex<Node>   m_NodeIndex;
+    ObjectIndex<Pin>    m_PinIndex;
+    ObjectIndex<Link>   m_LinkIndex;
+
+    SpatialGrid<Node>   m_NodeGrid;
+    SpatialGrid<Link>   m_LinkGrid;
+    vector<Link*>       m_LinkCandidates;
+    vector<Node*>       m_VisibleNodes;
+    vector<Link*>       m_VisibleLinks;
+    int                 m_LiveNodeCount;
+    int                 m_LiveLinkCount;
+    int                 m_CulledNodeCount;
+    int                 m_CulledLinkCount;
+
     vector<Object*>     m_SelectedObjects;
 
     vector<Object*>     m_LastSelectedObjects;
@@ -1427,6 +1751,7 @@ private:
 
     ImGuiEx::Canvas     m_Canvas;
     bool                m_IsCanvasVisible;
+    LevelOfDetail       m_LevelOfDetail;
 
     NodeBuilder         m_NodeBuilder;
     HintBuilder         m_HintBuilder;
@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <thread>
 #include <chrono>
 
@@ -8,9 +9,20 @@
 #include "imgui_freetype.h"
 
 #include "SOIS/ApplicationContext.hpp"
+#include "SOIS/FontAtlasBuilder.hpp"
+#include "SOIS/FontAtlasCache.hpp"
+#include "SOIS/Hash.hpp"
+#include "SOIS/ThreadPool.hpp"
 
 namespace SOIS
 {
+  // How much of each frame the limiter spins through instead of sleeping.
+  static constexpr std::chrono::microseconds cFrameLimiterSpin{ 2000 };
+
+  // ImGui can take a frame or two to settle after input (auto sizing windows and the
+  // like), so we wait for a few unchanged frames in a row before blocking.
+  static constexpr int cUnchangedFramesBeforeBlocking = 3;
+
   void ApplicationInitialization()
   {
     // Setup SDL
@@ -30,12 +42,14 @@ namespace SOIS
     , mUserData{ aConfig.aUserData }
     , mFrame{ 0 }
     , mBlocking{ aConfig.aBlocking }
+    , mSkipUnchangedFrames{ aConfig.aSkipUnchangedFrames }
     , mRunning{ true }
 
   {
     switch (aConfig.aPreferredRenderer)
     {
     case PreferredRenderer::OpenGL3_3:    mRenderer = MakeOpenGL3Renderer(); break;
+    case PreferredRenderer::Software:     mRenderer = MakeSoftwareRenderer(); break;
 
 #if defined(_WIN32)
     case PreferredRenderer::DirectX11:  mRenderer = MakeDX11Renderer(); break;
@@ -82,7 +96,28 @@ namespace SOIS
       io.IniFilename = (const char*)aConfig.aIniFile;
     }
 
+    Profiler::Get().SetThreadName("Main");
+    ShowProfiler(aConfig.aShowProfiler);
+
+    if (aConfig.aMeasureInputLatency)
+    {
+      mInputLatency = std::make_unique<InputLatency>();
+      mShowInputLatency = true;
+
+      if (nullptr != aConfig.aInputLatencyReport)
+      {
+        mInputLatencyReport = aConfig.aInputLatencyReport;
+      }
+    }
+
     mRenderer->Initialize(mWindow);
+    SetFramePacing(aConfig.aFramePacing, aConfig.aTargetFps);
+    mRenderer->SetPartialRedraw(aConfig.aPartialRedraw);
+
+    if (aConfig.aThreadedRendering && mRenderer->EnableRenderThread())
+    {
+      mRenderThread = std::make_unique<RenderThread>(mRenderer.get());
+    }
 
     // Setup style
     ImGui::StyleColorsDark();
@@ -90,6 +125,13 @@ namespace SOIS
     mBegin = std::chrono::high_resolution_clock::now();
     mLastFrame = mBegin;
 
+    // How long to wait on input after skipping a frame, so idle frames aren't a busy loop.
+    SDL_DisplayMode displayMode;
+    if (0 == SDL_GetCurrentDisplayMode(SDL_GetWindowDisplayIndex(mWindow), &displayMode) && displayMode.refresh_rate > 0)
+    {
+      mRefreshPeriodMs = std::max(1, 1000 / displayMode.refresh_rate);
+    }
+
     // See ImGuiFreeType::RasterizationFlags
     //io.Fonts->AddFontFromFileTTF("Roboto_Mono/RobotoMono-Medium.ttf", 16.0f);
     //io.Fonts->AddFontDefault();
@@ -256,22 +298,60 @@ namespace SOIS
 
     //io.Fonts->AddFontFromFileTTF("Noto_Sans/NotoSans-Bold.ttf", 16.0f, nullptr, ranges);
     //io.Fonts->AddFontFromFileTTF("Noto_Sans/NotoSans-Regular.ttf", 16.0f, &config);
-    io.Fonts->AddFontFromFileTTF("Noto_Sans/NotoSansJP-Regular.otf", 16.0f, nullptr, io.Fonts->GetGlyphRangesJapanese());
-    io.Fonts->AddFontFromFileTTF("Noto_Sans/NotoSansKR-Regular.otf", 16.0f, &config, io.Fonts->GetGlyphRangesKorean());
-    io.Fonts->AddFontFromFileTTF("Noto_Sans/NotoSansSymbols-Regular.ttf", 16.0f, &config, ranges);
-    io.Fonts->AddFontFromFileTTF("Noto_Sans/NotoSansSymbols2-Regular.ttf", 16.0f, &config, ranges);
     //unsigned int flags = ImGuiFreeType::NoHinting;
     unsigned int flags = 0;
-    ImGuiFreeType::BuildFontAtlas(io.Fonts, flags);
+
+    if (aConfig.aLazyGlyphs)
+    {
+      mGlyphCache = std::make_unique<GlyphCache>(mRenderer.get(), flags);
+      mGlyphCache->AddFont("Noto_Sans/NotoSansJP-Regular.otf", 16.0f, nullptr, io.Fonts->GetGlyphRangesJapanese());
+      mGlyphCache->AddFont("Noto_Sans/NotoSansKR-Regular.otf", 16.0f, &config, io.Fonts->GetGlyphRangesKorean());
+      mGlyphCache->AddFont("Noto_Sans/NotoSansSymbols-Regular.ttf", 16.0f, &config, ranges);
+      mGlyphCache->AddFont("Noto_Sans/NotoSansSymbols2-Regular.ttf", 16.0f, &config, ranges);
+      mGlyphCache->Build();
+    }
+    else if (nullptr != aConfig.aFontCacheDirectory)
+    {
+      // Only spun up for the build, so it's gone before the frame loop starts.
+      std::optional<ThreadPool> fontPool;
+      if (aConfig.aParallelFontBuild)
+      {
+        fontPool.emplace();
+      }
+
+      FontAtlasCache fontCache(aConfig.aFontCacheDirectory);
+      fontCache.AddFont("Noto_Sans/NotoSansJP-Regular.otf", 16.0f, nullptr, io.Fonts->GetGlyphRangesJapanese());
+      fontCache.AddFont("Noto_Sans/NotoSansKR-Regular.otf", 16.0f, &config, io.Fonts->GetGlyphRangesKorean());
+      fontCache.AddFont("Noto_Sans/NotoSansSymbols-Regular.ttf", 16.0f, &config, ranges);
+      fontCache.AddFont("Noto_Sans/NotoSansSymbols2-Regular.ttf", 16.0f, &config, ranges);
+      fontCache.Build(flags, fontPool ? &*fontPool : nullptr);
+    }
+    else
+    {
+      io.Fonts->AddFontFromFileTTF("Noto_Sans/NotoSansJP-Regular.otf", 16.0f, nullptr, io.Fonts->GetGlyphRangesJapanese());
+      io.Fonts->AddFontFromFileTTF("Noto_Sans/NotoSansKR-Regular.otf", 16.0f, &config, io.Fonts->GetGlyphRangesKorean());
+      io.Fonts->AddFontFromFileTTF("Noto_Sans/NotoSansSymbols-Regular.ttf", 16.0f, &config, ranges);
+      io.Fonts->AddFontFromFileTTF("Noto_Sans/NotoSansSymbols2-Regular.ttf", 16.0f, &config, ranges);
+
+      if (aConfig.aParallelFontBuild)
+      {
+        ThreadPool fontPool;
+        BuildFontAtlasParallel(io.Fonts, flags, fontPool);
+      }
+      else
+      {
+        ImGuiFreeType::BuildFontAtlas(io.Fonts, flags);
+      }
+    }
 
 
     SDL_Rect screenRect;
     SDL_GetDisplayBounds(0, &screenRect);
 
     printf("screenRect: %d %d", screenRect.w, screenRect.h);
-    int w, h;
-    SDL_GetWindowSize(mWindow, &w, &h);
-    printf("WindowSize: %d %d", w, h);
+    SDL_GetWindowSize(mWindow, &mWindowWidth, &mWindowHeight);
+    mWindowID = SDL_GetWindowID(mWindow);
+    printf("WindowSize: %d %d", mWindowWidth, mWindowHeight);
 
     // We run a begin frame here once, because the update function (meant to 
     // be run as the condition to a while loop.) needs to run both the begin
@@ -283,7 +363,19 @@ namespace SOIS
 
   ApplicationContext::~ApplicationContext()
   {
+    if (nullptr != mInputLatency)
+    {
+      mInputLatency->Shutdown(*mRenderer);
+
+      if (false == mInputLatencyReport.empty() && false == mInputLatency->WriteReport(mInputLatencyReport))
+      {
+        printf("Couldn't write the input latency report to %s\n", (char const*)mInputLatencyReport.c_str());
+      }
+    }
+
     // Cleanup
+    mRenderThread.reset();
+    mGlyphCache.reset();
     mRenderer.reset();
 
     ImGui_ImplSDL2_Shutdown();
@@ -300,6 +392,31 @@ namespace SOIS
   }
 
 
+  void ApplicationContext::SetFramePacing(FramePacing aPacing, double aTargetFps)
+  {
+    mFramePacing = aPacing;
+    mTargetFrameTime = std::chrono::duration<double>((aTargetFps > 0.0) ? 1.0 / aTargetFps : 0.0);
+
+    switch (aPacing)
+    {
+    case FramePacing::Vsync: mRenderer->SetPresentMode(PresentMode::Vsync); break;
+    case FramePacing::AdaptiveVsync: mRenderer->SetPresentMode(PresentMode::AdaptiveVsync); break;
+    case FramePacing::Uncapped:
+    case FramePacing::Limited: mRenderer->SetPresentMode(PresentMode::Immediate); break;
+    }
+  }
+
+  void ApplicationContext::KeepActiveUntil(std::chrono::time_point<std::chrono::high_resolution_clock> aDeadline)
+  {
+    mActiveUntil = std::max(mActiveUntil, aDeadline);
+  }
+
+  void ApplicationContext::KeepActiveFor(double aSeconds)
+  {
+    using namespace std::chrono;
+    KeepActiveUntil(high_resolution_clock::now() + duration_cast<high_resolution_clock::duration>(duration<double>(aSeconds)));
+  }
+
   void ApplicationContext::EndApplication()
   {
     mRunning = false;
@@ -314,6 +431,8 @@ namespace SOIS
       return false;
     }
 
+    LimitFrameRate();
+
     using namespace std::chrono;
     duration<double> time_span = duration_cast<duration<double>>(high_resolution_clock::now() - mLastFrame);
     mLastFrame = high_resolution_clock::now();
@@ -324,6 +443,31 @@ namespace SOIS
     return true;
   }
 
+  void ApplicationContext::LimitFrameRate()
+  {
+    if (FramePacing::Limited != mFramePacing || 0.0 == mTargetFrameTime.count())
+    {
+      return;
+    }
+
+    using namespace std::chrono;
+    auto deadline = mLastFrame + duration_cast<high_resolution_clock::duration>(mTargetFrameTime);
+
+    // Sleeping can overshoot by a scheduler tick (SDL asks Windows for 1ms ones), so
+    // we wake up a little early and spin the rest of the way.
+    auto wake = deadline - cFrameLimiterSpin;
+    auto now = high_resolution_clock::now();
+    if (now < wake)
+    {
+      std::this_thread::sleep_for(wake - now);
+    }
+
+    while (high_resolution_clock::now() < deadline)
+    {
+      std::this_thread::yield();
+    }
+  }
+
   bool ApplicationContext::ShouldBeBlocking()
   {
     // If we're not requested to be blocking, obviously don't block on input.
@@ -339,6 +483,24 @@ namespace SOIS
       return false;
     }
 
+    if (std::chrono::high_resolution_clock::now() < mActiveUntil)
+    {
+      return false;
+    }
+
+    // With damage detection we know when the UI has settled, so there's no need to wait
+    // out the timer below.
+    if (mSkipUnchangedFrames)
+    {
+      // Blinking carets only change the draw data every so often, keep going while typing.
+      if (ImGui::GetIO().WantTextInput)
+      {
+        return false;
+      }
+
+      return mUnchangedFrames >= cUnchangedFramesBeforeBlocking;
+    }
+
     // If we got an event less than a second or so ago (set in the BeginFrame function)
     // we stay unblocked for a little bit to allow the UI or whatnot to keep updating.
     if (mTimerUntilBlockingAgain > 0.0f)
@@ -351,8 +513,210 @@ namespace SOIS
     return true;
   }
 
+  // Folds aNext into aPrevious if it only brings aPrevious up to date, so a 1000Hz mouse
+  // or a pen doesn't cost us (and ImGui, and the handler) a full event each.
+  static bool Coalesce(SDL_Event& aPrevious, SDL_Event const& aNext)
+  {
+    if (aPrevious.type != aNext.type)
+    {
+      return false;
+    }
+
+    switch (aNext.type)
+    {
+    case SDL_MOUSEMOTION:
+    {
+      // Button changes in between are a separate event, but a change of state here
+      // would mean we missed one, keep them apart to be safe.
+      if (aPrevious.motion.windowID != aNext.motion.windowID ||
+          aPrevious.motion.which != aNext.motion.which ||
+          aPrevious.motion.state != aNext.motion.state)
+      {
+        return false;
+      }
+
+      int xrel = aPrevious.motion.xrel + aNext.motion.xrel;
+      int yrel = aPrevious.motion.yrel + aNext.motion.yrel;
+      aPrevious.motion = aNext.motion;
+      aPrevious.motion.xrel = xrel;
+      aPrevious.motion.yrel = yrel;
+      return true;
+    }
+    case SDL_FINGERMOTION:
+    {
+      if (aPrevious.tfinger.touchId != aNext.tfinger.touchId ||
+          aPrevious.tfinger.fingerId != aNext.tfinger.fingerId)
+      {
+        return false;
+      }
+
+      float dx = aPrevious.tfinger.dx + aNext.tfinger.dx;
+      float dy = aPrevious.tfinger.dy + aNext.tfinger.dy;
+      aPrevious.tfinger = aNext.tfinger;
+      aPrevious.tfinger.dx = dx;
+      aPrevious.tfinger.dy = dy;
+      return true;
+    }
+    case SDL_MULTIGESTURE:
+    {
+      if (aPrevious.mgesture.touchId != aNext.mgesture.touchId)
+      {
+        return false;
+      }
+
+      float dTheta = aPrevious.mgesture.dTheta + aNext.mgesture.dTheta;
+      float dDist = aPrevious.mgesture.dDist + aNext.mgesture.dDist;
+      aPrevious.mgesture = aNext.mgesture;
+      aPrevious.mgesture.dTheta = dTheta;
+      aPrevious.mgesture.dDist = dDist;
+      return true;
+    }
+    case SDL_WINDOWEVENT:
+    {
+      // Only the last size or position in a drag matters.
+      bool latestWins = SDL_WINDOWEVENT_RESIZED == aNext.window.event ||
+                        SDL_WINDOWEVENT_SIZE_CHANGED == aNext.window.event ||
+                        SDL_WINDOWEVENT_MOVED == aNext.window.event;
+
+      if (false == latestWins ||
+          aPrevious.window.windowID != aNext.window.windowID ||
+          aPrevious.window.event != aNext.window.event)
+      {
+        return false;
+      }
+
+      aPrevious.window = aNext.window;
+      return true;
+    }
+    default:
+      return false;
+    }
+  }
+
+  size_t ApplicationContext::CoalesceEvents(size_t aCount)
+  {
+    size_t kept = 0;
+    for (size_t i = 0; i < aCount; ++i)
+    {
+      if (kept > 0 && Coalesce(mEvents[kept - 1], mEvents[i]))
+      {
+        continue;
+      }
+
+      if (kept != i)
+      {
+        mEvents[kept] = mEvents[i];
+      }
+
+      ++kept;
+    }
+
+    return kept;
+  }
+
+  void ApplicationContext::ProcessEvent(SDL_Event& aEvent)
+  {
+    // ImGui and our own bookkeeping below always see every event, consuming only stops
+    // other handlers.
+    ImGui_ImplSDL2_ProcessEvent(&aEvent);
+
+    bool consumed = mEventDispatcher.Dispatch(aEvent);
+    if (false == consumed && nullptr != mHandler)
+    {
+      mHandler(aEvent, mUserData);
+    }
+
+    glm::vec2 windowSize = { static_cast<float>(mWindowWidth), static_cast<float>(mWindowHeight) };
+
+    switch (aEvent.type)
+    {
+    case SDL_QUIT:
+    {
+      mRunning = false;
+      break;
+    }
+    case SDL_WINDOWEVENT:
+    {
+      auto windowEvent = aEvent.window;
+      if (windowEvent.windowID != mWindowID)
+      {
+        break;
+      }
+
+      if (windowEvent.event == SDL_WINDOWEVENT_CLOSE)
+      {
+        mRunning = false;
+      }
+      else if (SDL_WINDOWEVENT_RESIZED == windowEvent.event ||
+        SDL_WINDOWEVENT_SIZE_CHANGED == windowEvent.event)
+      {
+        mWindowWidth = windowEvent.data1;
+        mWindowHeight = windowEvent.data2;
+
+        mRenderer->ResizeRenderTarget(mWindowWidth, mWindowHeight);
+        mRedrawRequested = true;
+      }
+      else if (SDL_WINDOWEVENT_EXPOSED == windowEvent.event)
+      {
+        // The window system may have thrown away what we presented last.
+        mRedrawRequested = true;
+      }
+      break;
+    }
+    case SDL_MOUSEWHEEL:
+    {
+      mMouse.mScrollHappened = true;
+      mMouse.mMouseWheel = { aEvent.wheel.x , aEvent.wheel.y };
+      break;
+    }
+    case SDL_MULTIGESTURE:
+    {
+      mTouchData.mPinchPosition = glm::vec2{ aEvent.mgesture.x, aEvent.mgesture.y } * windowSize;
+      mTouchData.mPinchDelta += aEvent.mgesture.dDist;
+      mTouchData.mPinchEvent = true;
+      break;
+    }
+    case SDL_FINGERMOTION:
+    {
+      auto tempPosition = glm::vec2{ aEvent.tfinger.x, aEvent.tfinger.y } * windowSize;
+      mTouchData.mFingerDelta += tempPosition - mTouchData.mFingerPosition;
+      mTouchData.mFingerPosition = tempPosition;
+      break;
+    }
+    case SDL_FINGERDOWN:
+    {
+      mTouchData.mDown = true;
+      mTouchData.mFingerPosition = glm::vec2{ aEvent.tfinger.x, aEvent.tfinger.y } * windowSize;
+      break;
+    }
+    case SDL_FINGERUP:
+    {
+      mTouchData.mDown = false;
+      mTouchData.mFingerPosition = glm::vec2{ aEvent.tfinger.x, aEvent.tfinger.y } * windowSize;
+      break;
+    }
+    }
+  }
+
+  void ApplicationContext::ShowProfiler(bool aShow)
+  {
+    mShowProfiler = aShow;
+
+    if (aShow)
+    {
+      Profiler::Get().SetEnabled(true);
+    }
+  }
+
   void ApplicationContext::BeginFrame()
   {
+    Profiler::Get().NewFrame();
+
+    if (nullptr != mInputLatency)
+    {
+      mInputLatency->NewFrame(*mRenderer);
+    }
+
     mTouchData.mPinchEvent = false;
     mTouchData.mPinchDelta = 0;
     mTouchData.mFingerDelta = { 0.f, 0.f };
@@ -364,7 +728,7 @@ namespace SOIS
     // - When io.WantCaptureMouse is true, do not dispatch mouse input data to your main application.
     // - When io.WantCaptureKeyboard is true, do not dispatch keyboard input data to your main application.
     // Generally you may always pass all inputs to dear imgui, and hide them from your application based on those two flags.
-    mEvents.clear();
+    size_t count = 0;
 
     // If we're blocking on input, we wait for the next event.
     if (ShouldBeBlocking())
@@ -372,115 +736,163 @@ namespace SOIS
       //using namespace std::chrono_literals;
       //std::this_thread::sleep_for(10ms);
 
-      mEvents.clear();
-      mEvents.resize(1);
-      SDL_WaitEvent(mEvents.data());
+      count = SDL_WaitEvent(&mEvents[0]) ? 1 : 0;
 
       mTimerUntilBlockingAgain = 2.f;
+      mUnchangedFrames = 0;
     }
-
-    // Regardless if we're blocking, gather up the rest of the events this frame.
-    SDL_Event polledEvent;
-    while (SDL_PollEvent(&polledEvent))
+    else if (mSkipUnchangedFrames && mUnchangedFrames > 0)
     {
-      mEvents.emplace_back(polledEvent);
+      // Nothing changed last frame, so there's nothing to do until input shows up or
+      // about a refresh passes (for anything driven by time).
+      count = SDL_WaitEventTimeout(&mEvents[0], mRefreshPeriodMs) ? 1 : 0;
     }
 
-    for (auto& event : mEvents)
+    // Regardless if we're blocking, gather up the rest of the events this frame, a
+    // batch at a time.
     {
-      ImGui_ImplSDL2_ProcessEvent(&event);
-
-      if (nullptr != mHandler)
+      SOIS_PROFILE_SCOPE("Events");
+      SDL_PumpEvents();
+      while (true)
       {
-        mHandler(event, mUserData);
-      }
+        int peeked = SDL_PeepEvents(mEvents.data() + count, static_cast<int>(mEvents.size() - count), SDL_GETEVENT, SDL_FIRSTEVENT, SDL_LASTEVENT);
+        count += std::max(0, peeked);
 
-      switch (event.type)
-      {
-      case SDL_QUIT:
-      {
-        mRunning = false;
-        break;
-      }
-      case SDL_WINDOWEVENT:
-      {
-        auto windowEvent = event.window;
-        if (windowEvent.event == SDL_WINDOWEVENT_CLOSE && windowEvent.windowID == SDL_GetWindowID(mWindow))
+        if (nullptr != mInputLatency)
         {
-          mRunning = false;
+          int64_t polled = Profiler::Now();
+          for (size_t i = 0; i < count; ++i)
+          {
+            if (InputLatency::IsInputEvent(mEvents[i]))
+            {
+              mInputLatency->InputPolled(polled);
+              break;
+            }
+          }
         }
-        else if (SDL_WINDOWEVENT_RESIZED == windowEvent.event ||
-          SDL_WINDOWEVENT_SIZE_CHANGED == windowEvent.event)
+
+        // A full batch means there's probably more waiting.
+        bool full = mEvents.size() == count;
+
+        count = CoalesceEvents(count);
+        for (size_t i = 0; i < count; ++i)
         {
-          int width;
-          int height;
-          SDL_GetWindowSize(mWindow, &width, &height);
+          ProcessEvent(mEvents[i]);
+        }
 
-          mRenderer->ResizeRenderTarget(width, height);
+        count = 0;
+        if (false == full)
+        {
+          break;
         }
-        break;
       }
-      case SDL_MOUSEWHEEL:
-      {
-        mMouse.mScrollHappened = true;
-        mMouse.mMouseWheel = { event.wheel.x , event.wheel.y };
-        break;
-      }
-      case SDL_MULTIGESTURE:
-      {
-        int w, h;
-        SDL_GetWindowSize(mWindow, &w, &h);
-        mTouchData.mPinchPosition = glm::vec2{ event.mgesture.x * w, event.mgesture.y * h };
-        mTouchData.mPinchDelta = event.mgesture.dDist;
-        mTouchData.mPinchEvent = true;
-        break;
-      }
-      case SDL_FINGERMOTION:
+    }
+
+    {
+      SOIS_PROFILE_SCOPE("NewFrame");
+
+      // Start the Dear ImGui frame
+      mRenderer->NewFrame();
+
+      if (nullptr != mGlyphCache)
       {
-        int w, h;
-        SDL_GetWindowSize(mWindow, &w, &h);
-        auto tempPosition = glm::vec2{ event.tfinger.x * w, event.tfinger.y * h };
-        mTouchData.mFingerDelta = tempPosition - mTouchData.mFingerPosition;
-        mTouchData.mFingerPosition = tempPosition;
-        break;
+        mGlyphCache->NewFrame();
       }
-      case SDL_FINGERDOWN:
-      {
-        mTouchData.mDown = true;
 
-        int w, h;
-        SDL_GetWindowSize(mWindow, &w, &h);
-        mTouchData.mFingerPosition = glm::vec2{ event.tfinger.x * w, event.tfinger.y * h };
-        break;
-      }
-      case SDL_FINGERUP:
-      {
-        mTouchData.mDown = false;
+      ImGui_ImplSDL2_NewFrame(mWindow);
+      ImGui::NewFrame();
 
-        int w, h;
-        SDL_GetWindowSize(mWindow, &w, &h);
-        mTouchData.mFingerPosition = glm::vec2{ event.tfinger.x * w, event.tfinger.y * h };
-        break;
-      }
+      // When frames can be skipped the clear waits until we know this one is drawn, so
+      // a skipped frame leaves the last one in the render target (and its readbacks).
+      if (false == mSkipUnchangedFrames)
+      {
+        mRenderer->ClearRenderTarget(mClearColor);
       }
     }
 
-    // Start the Dear ImGui frame
-    mRenderer->NewFrame();
-    ImGui_ImplSDL2_NewFrame(mWindow);
-    ImGui::NewFrame();
+    if (nullptr != mInputLatency)
+    {
+      mInputLatency->StageReached(InputLatency::Stage::NewFrame);
+    }
 
-    mRenderer->ClearRenderTarget(mClearColor);
+    // Whatever the user does until EndFrame, their own zones nest under it.
+    mUiZone.emplace("UI");
   }
 
   void ApplicationContext::EndFrame()
   {
+    mUiZone.reset();
+
+    if (mShowProfiler)
+    {
+      Profiler::Get().DrawWindow(&mShowProfiler);
+    }
+
+    if (mShowInputLatency)
+    {
+      mInputLatency->DrawWindow(&mShowInputLatency);
+    }
+
     // Rendering Dear ImGui.
-    ImGui::Render();
-    mRenderer->RenderImguiData();
+    {
+      SOIS_PROFILE_SCOPE("ImGui::Render");
+      ImGui::Render();
+    }
+
+    if (nullptr != mInputLatency)
+    {
+      mInputLatency->StageReached(InputLatency::Stage::Render);
+    }
+
+    // New glyphs show up next frame, make sure there is one.
+    if (nullptr != mGlyphCache && mGlyphCache->ResolveMissingGlyphs(ImGui::GetDrawData()))
+    {
+      KeepActiveFor(0.1);
+    }
 
     ImGuiIO& io = ImGui::GetIO();
 
+    if (mSkipUnchangedFrames)
+    {
+      uint64_t hash = HashCombine(Renderer::HashDrawData(ImGui::GetDrawData()), mRenderer->GetTextureContentVersion());
+      bool unchanged = hash == mLastDrawHash &&
+                       false == mRedrawRequested &&
+                       std::chrono::high_resolution_clock::now() >= mActiveUntil &&
+                       0 == (io.ConfigFlags & ImGuiConfigFlags_ViewportsEnable); // We only hash the main viewport.
+
+      mLastDrawHash = hash;
+      mRedrawRequested = false;
+
+      if (unchanged)
+      {
+        // What we presented last is still on screen, leave it there.
+        SDL_assert(mRenderer->HoldsPresentedFrame());
+
+        if (nullptr != mInputLatency)
+        {
+          mInputLatency->FrameSkipped();
+        }
+
+        ++mUnchangedFrames;
+        ++mFrame;
+        return;
+      }
+
+      mUnchangedFrames = 0;
+      mRenderer->ClearRenderTarget(mClearColor);
+    }
+
+    if (nullptr != mRenderThread)
+    {
+      // Copies the draw data and returns, the render thread takes it from here.
+      SOIS_PROFILE_SCOPE("Submit");
+      mRenderThread->Submit(ImGui::GetDrawData());
+    }
+    else
+    {
+      mRenderer->RenderImguiData();
+    }
+
     // Update and Render additional Platform Windows
     // (Platform functions may change the current OpenGL context, so we save/restore it to make it easier to paste this code elsewhere.
     //  For this specific demo app we could also call glfwMakeContextCurrent(window) directly)
@@ -490,7 +902,16 @@ namespace SOIS
       ImGui::RenderPlatformWindowsDefault();
     }
 
-    mRenderer->Present();
+    if (nullptr == mRenderThread)
+    {
+      mRenderer->Present();
+    }
+
+    // With a render thread this is when the frame was handed off, not presented.
+    if (nullptr != mInputLatency)
+    {
+      mInputLatency->FramePresented(*mRenderer);
+    }
 
     ++mFrame;
   }
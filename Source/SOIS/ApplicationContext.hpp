@@ -1,7 +1,8 @@
 #pragma once
 
+#include <array>
 #include <chrono>
-#include <vector>
+#include <optional>
 
 #include "imgui.h"
 
@@ -9,7 +10,12 @@
 
 #include "glm/glm.hpp"
 
+#include "SOIS/EventDispatcher.hpp"
+#include "SOIS/GlyphCache.hpp"
+#include "SOIS/InputLatency.hpp"
+#include "SOIS/Profiler.hpp"
 #include "SOIS/Renderer.hpp"
+#include "SOIS/RenderThread.hpp"
 
 namespace SOIS
 {
@@ -21,7 +27,16 @@ namespace SOIS
   enum PreferredRenderer
   {
     OpenGL3_3,
-    DirectX11
+    DirectX11,
+    Software // CPU rasterizer, doesn't need a GPU or even a display.
+  };
+
+  enum class FramePacing
+  {
+    Vsync,         // Wait on the display, the default.
+    AdaptiveVsync, // Vsync, but late frames tear rather than wait for the next refresh.
+    Uncapped,      // No waiting at all, lowest latency but burns the most power.
+    Limited        // No vsync, capped to aTargetFps by sleeping (then spinning) between frames.
   };
 
   struct ApplicationContextConfig
@@ -32,6 +47,41 @@ namespace SOIS
     void* aUserData = nullptr;
     PreferredRenderer aPreferredRenderer;
     bool aBlocking = false;
+    FramePacing aFramePacing = FramePacing::Vsync;
+    double aTargetFps = 60.0;
+
+    // Skip rendering and presenting frames whose draw data matches the last one, and in
+    // blocking mode go back to waiting on input as soon as the UI settles. Leave this
+    // off if you draw anything yourself between frames, we can't see that.
+    bool aSkipUnchangedFrames = false;
+
+    // Only redraw the parts of the window that changed, see Renderer::SetPartialRedraw.
+    bool aPartialRedraw = false;
+
+    // Draw and present on a separate thread, so events and the next frame's UI overlap
+    // with the GPU work and vsync wait of the last. Falls back to rendering on the main
+    // thread if the renderer can't do it (only OpenGL can for now).
+    bool aThreadedRendering = false;
+
+    // Turns the Profiler on and shows its window from the first frame.
+    bool aShowProfiler = false;
+
+    // Measures input to present (and GPU, where the renderer can tell) latency, shows
+    // p50/p99 in a window, and writes the histograms to aInputLatencyReport on exit.
+    bool aMeasureInputLatency = false;
+    char8_t const* aInputLatencyReport = u8"SOIS_InputLatency.txt";
+
+    // Only bake Basic Latin at startup and rasterize everything else the first time it's
+    // drawn, see GlyphCache. Glyphs appear a frame after they're first needed.
+    bool aLazyGlyphs = false;
+
+    // Keep the baked font atlas here and load it instead of rebuilding while the fonts
+    // and their settings stay the same, see FontAtlasCache. Not used with aLazyGlyphs.
+    char8_t const* aFontCacheDirectory = nullptr;
+
+    // Rasterize the font atlas over every core instead of just the main thread, see
+    // BuildFontAtlasParallel. Worth it for CJK sized ranges. Not used with aLazyGlyphs.
+    bool aParallelFontBuild = false;
   };
 
   struct Touch
@@ -97,21 +147,64 @@ namespace SOIS
     // Call when you want the application to end.
     void EndApplication();
 
+    // The handler sees every event, after any subscribers that didn't consume it.
     void SetCallbackInfo(EventHandler aHandler, void* aUserData);
 
+    // Subscribe here to get just the events you care about.
+    EventDispatcher& GetEventDispatcher()
+    {
+      return mEventDispatcher;
+    }
+
+    // Renders every frame, without blocking, until the deadline. For animations and
+    // anything else that changes without input. Extends, never shortens, the deadline.
+    void KeepActiveUntil(std::chrono::time_point<std::chrono::high_resolution_clock> aDeadline);
+    void KeepActiveFor(double aSeconds);
+
+    // Renders the next frame even if it's unchanged.
+    void RequestRedraw()
+    {
+      mRedrawRequested = true;
+    }
+
+    // Can be changed at any time, aTargetFps only matters for FramePacing::Limited.
+    void SetFramePacing(FramePacing aPacing, double aTargetFps = 60.0);
+
     Renderer* GetRenderer()
     {
       return mRenderer.get();
     }
 
+    // The Profiler window, drawn at the end of every frame. Showing it turns profiling on.
+    void ShowProfiler(bool aShow);
+
   private:
     void BeginFrame();
     void EndFrame();
 
     bool ShouldBeBlocking();
 
-    std::vector<SDL_Event> mEvents;
+    // Waits out whatever's left of the target frame time, measured from mLastFrame.
+    void LimitFrameRate();
+
+    // Compacts the first aCount events in mEvents, folding redundant ones together.
+    size_t CoalesceEvents(size_t aCount);
+    void ProcessEvent(SDL_Event& aEvent);
+
+    // Events are pulled from SDL this many at a time.
+    static constexpr size_t cEventBatchSize = 128;
+
+    std::array<SDL_Event, cEventBatchSize> mEvents;
+
+    // Kept up to date by window events, so touch input doesn't have to ask SDL.
+    int mWindowWidth = 0;
+    int mWindowHeight = 0;
+    Uint32 mWindowID = 0;
+
+    EventDispatcher mEventDispatcher;
     std::unique_ptr<Renderer> mRenderer;
+    std::unique_ptr<GlyphCache> mGlyphCache;
+    std::unique_ptr<RenderThread> mRenderThread;
     EventHandler mHandler;
     void* mUserData;
 
@@ -119,10 +212,28 @@ namespace SOIS
     std::chrono::time_point<std::chrono::high_resolution_clock> mLastFrame;
     double mDt;
 
+    FramePacing mFramePacing = FramePacing::Vsync;
+    std::chrono::duration<double> mTargetFrameTime{ 0.0 };
+
     double mTimerUntilBlockingAgain = 0.0f;
 
+    std::chrono::time_point<std::chrono::high_resolution_clock> mActiveUntil;
+    uint64_t mLastDrawHash = 0;
+    int mUnchangedFrames = 0;
+    int mRefreshPeriodMs = 16;
+    bool mRedrawRequested = true;
+
+    std::optional<ProfileZone> mUiZone;
+    bool mShowProfiler = false;
+
+    // Only when measuring input latency.
+    std::unique_ptr<InputLatency> mInputLatency;
+    std::u8string mInputLatencyReport;
+    bool mShowInputLatency = false;
+
     size_t mFrame;
     bool mBlocking;
+    bool mSkipUnchangedFrames;
     bool mRunning;
   };
 }
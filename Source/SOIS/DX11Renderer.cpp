@@ -1,12 +1,16 @@
+#include <algorithm>
+#include <vector>
+
 #include <SDL_syswm.h>
 
 #include "imgui.h"
 #include "imgui_impl_sdl.h"
 #include "imgui_impl_dx11.h"
 
-#include <stb_image.h>
-
 #include "SOIS/DX11Renderer.hpp"
+#include "SOIS/Profiler.hpp"
+#include "SOIS/TextureCompression.hpp"
+#include "SOIS/TextureMips.hpp"
 
 namespace SOIS
 {
@@ -39,9 +43,8 @@ namespace SOIS
 #endif
 
     //createDeviceFlags |= D3D11_CREATE_DEVICE_DEBUG;
-    D3D_FEATURE_LEVEL featureLevel;
     const D3D_FEATURE_LEVEL featureLevelArray[2] = { D3D_FEATURE_LEVEL_11_0, D3D_FEATURE_LEVEL_10_0, };
-    if (D3D11CreateDeviceAndSwapChain(NULL, D3D_DRIVER_TYPE_HARDWARE, NULL, createDeviceFlags, featureLevelArray, 2, D3D11_SDK_VERSION, &sd, mSwapChain.put(), mD3DDevice.put(), &featureLevel, mD3DDeviceContext.put()) != S_OK)
+    if (D3D11CreateDeviceAndSwapChain(NULL, D3D_DRIVER_TYPE_HARDWARE, NULL, createDeviceFlags, featureLevelArray, 2, D3D11_SDK_VERSION, &sd, mSwapChain.put(), mD3DDevice.put(), &mFeatureLevel, mD3DDeviceContext.put()) != S_OK)
     {
       throw "Bad device and swapchain";
       return false;
@@ -107,6 +110,8 @@ namespace SOIS
 
   void DX11Renderer::NewFrame()
   {
+    ProcessAsyncTextureUploads();
+    UpdateTextureResidency();
     ImGui_ImplDX11_NewFrame();
   }
 
@@ -125,19 +130,108 @@ namespace SOIS
 
   void DX11Renderer::RenderImguiData()
   {
+    SOIS_PROFILE_SCOPE("RenderImguiData");
+    MergeDrawCommands(ImGui::GetDrawData());
+    BindMipSampler(ImGui::GetDrawData());
     ImGui_ImplDX11_RenderDrawData(ImGui::GetDrawData());
   }
 
+  void DX11Renderer::BindMipSampler(ImDrawData* aDrawData)
+  {
+    if (nullptr == aDrawData || 0 == aDrawData->CmdListsCount)
+    {
+      return;
+    }
+
+    if (nullptr == mMipSampler)
+    {
+      // Same as the backend's sampler, minus the MaxLOD of 0.
+      D3D11_SAMPLER_DESC desc;
+      ZeroMemory(&desc, sizeof(desc));
+      desc.Filter = D3D11_FILTER_MIN_MAG_MIP_LINEAR;
+      desc.AddressU = D3D11_TEXTURE_ADDRESS_WRAP;
+      desc.AddressV = D3D11_TEXTURE_ADDRESS_WRAP;
+      desc.AddressW = D3D11_TEXTURE_ADDRESS_WRAP;
+      desc.ComparisonFunc = D3D11_COMPARISON_ALWAYS;
+      desc.MinLOD = 0.f;
+      desc.MaxLOD = D3D11_FLOAT32_MAX;
+      mD3DDevice->CreateSamplerState(&desc, mMipSampler.put());
+    }
+
+    ImDrawCmd command;
+    command.UserCallbackData = this;
+    command.UserCallback = [](ImDrawList const*, ImDrawCmd const* aCommand)
+    {
+      auto renderer = static_cast<DX11Renderer*>(aCommand->UserCallbackData);
+      ID3D11SamplerState* sampler = renderer->mMipSampler.get();
+      renderer->mD3DDeviceContext->PSSetSamplers(0, 1, &sampler);
+    };
+
+    // The backend binds its own sampler while setting up render state, so this has to
+    // run after that, from the draw data. Samplers carry over from one draw list to the
+    // next, so we only need it up front and after anything that resets render state.
+    ImVector<ImDrawCmd>& first = aDrawData->CmdLists[0]->CmdBuffer;
+    first.insert(first.begin(), command);
+
+    for (int n = 0; n < aDrawData->CmdListsCount; ++n)
+    {
+      ImVector<ImDrawCmd>& commands = aDrawData->CmdLists[n]->CmdBuffer;
+      for (int i = 0; i < commands.Size; ++i)
+      {
+        if (ImDrawCallback_ResetRenderState == commands[i].UserCallback)
+        {
+          commands.insert(commands.begin() + i + 1, command);
+          ++i;
+        }
+      }
+    }
+  }
+
+  void DX11Renderer::SetPresentMode(PresentMode aMode)
+  {
+    // DXGI has no adaptive sync interval, so that one's just vsync.
+    mSyncInterval = (PresentMode::Immediate == aMode) ? 0 : 1;
+  }
+
   void DX11Renderer::Present()
   {
-    mSwapChain->Present(1, 0); // Present with vsync
+    SOIS_PROFILE_SCOPE("Present");
+    mSwapChain->Present(mSyncInterval, 0);
+  }
+
+  void* DX11Renderer::InsertFrameFence()
+  {
+    D3D11_QUERY_DESC desc = {};
+    desc.Query = D3D11_QUERY_EVENT;
+
+    ID3D11Query* query = nullptr;
+    if (FAILED(mD3DDevice->CreateQuery(&desc, &query)))
+    {
+      return nullptr;
+    }
+
+    mD3DDeviceContext->End(query);
+    return query;
+  }
+
+  bool DX11Renderer::IsFrameFenceSignalled(void* aFence)
+  {
+    BOOL done = FALSE;
+    HRESULT result = mD3DDeviceContext->GetData(static_cast<ID3D11Query*>(aFence), &done, sizeof(done), D3D11_ASYNC_GETDATA_DONOTFLUSH);
+    return S_OK == result && done;
+  }
+
+  void DX11Renderer::DestroyFrameFence(void* aFence)
+  {
+    static_cast<ID3D11Query*>(aFence)->Release();
   }
 
   class DX11Texture : public Texture
   {
   public:
-    DX11Texture(winrt::com_ptr<ID3D11ShaderResourceView> aShaderResourceView, int aWidth, int aHeight)
+    DX11Texture(winrt::com_ptr<ID3D11Texture2D> aTexture2D, winrt::com_ptr<ID3D11ShaderResourceView> aShaderResourceView, int aWidth, int aHeight)
       : Texture{ aWidth, aHeight }
+      , Texture2D{ aTexture2D }
       , ShaderResourceView{ aShaderResourceView }
     {
 
@@ -152,6 +246,7 @@ namespace SOIS
       return ShaderResourceView.get();
     }
 
+    winrt::com_ptr<ID3D11Texture2D> Texture2D;
     winrt::com_ptr<ID3D11ShaderResourceView> ShaderResourceView;
   };
 
@@ -161,8 +256,8 @@ namespace SOIS
     {
     case TextureLayout::RGBA_Unorm: return DXGI_FORMAT_R8G8B8A8_UNORM;
     case TextureLayout::RGBA_Srgb: return DXGI_FORMAT_R8G8B8A8_UNORM_SRGB;
-    case TextureLayout::Bc1_Rgba_Unorm: return DXGI_FORMAT_R8G8B8A8_UNORM;
-    case TextureLayout::Bc1_Rgba_Srgb: return DXGI_FORMAT_R8G8B8A8_UNORM_SRGB;
+    case TextureLayout::Bc1_Rgba_Unorm: return DXGI_FORMAT_BC1_UNORM;
+    case TextureLayout::Bc1_Rgba_Srgb: return DXGI_FORMAT_BC1_UNORM_SRGB;
     case TextureLayout::Bc3_Srgb: return DXGI_FORMAT_BC3_UNORM_SRGB;
     case TextureLayout::Bc3_Unorm: return DXGI_FORMAT_BC3_UNORM;
     case TextureLayout::Bc7_Unorm: return DXGI_FORMAT_BC7_UNORM;
@@ -171,99 +266,161 @@ namespace SOIS
     }
   }
 
-  std::unique_ptr<Texture> DX11Renderer::LoadTextureFromData(unsigned char* data, TextureLayout format, int w, int h, int pitch)
+  bool DX11Renderer::SupportsLayout(TextureLayout aLayout, int aWidth, int aHeight)
+  {
+    if (!IsBlockCompressed(aLayout))
+    {
+      return TextureLayout::InvalidLayout != aLayout;
+    }
+
+    // D3D11 wants the top level of a block compressed texture to be whole blocks.
+    if ((aWidth % 4) || (aHeight % 4))
+    {
+      return false;
+    }
+
+    // BC1 through BC3 are available on every feature level we create, BC7 needs 11_0.
+    if (TextureLayout::Bc7_Unorm == aLayout || TextureLayout::Bc7_Srgb == aLayout)
+    {
+      return mFeatureLevel >= D3D_FEATURE_LEVEL_11_0;
+    }
+
+    return true;
+  }
+
+  std::unique_ptr<Texture> DX11Renderer::LoadTextureFromData(unsigned char* data, TextureLayout format, int w, int h, int pitch, int aMipLevels)
   {
+    int levels = (cGenerateMips == aMipLevels) ? GetMipLevelCount(w, h) : std::max(1, aMipLevels);
+
+    if (!SupportsLayout(format, w, h))
+    {
+      if (!IsBlockCompressed(format))
+      {
+        return nullptr;
+      }
+
+      // Expand it on the CPU instead, we lose the memory savings but still get a texture.
+      bool srgb = TextureLayout::Bc1_Rgba_Srgb == format || TextureLayout::Bc3_Srgb == format || TextureLayout::Bc7_Srgb == format;
+      TextureLayout fallback = srgb ? TextureLayout::RGBA_Srgb : TextureLayout::RGBA_Unorm;
+
+      if (cGenerateMips == aMipLevels)
+      {
+        auto pixels = DecompressTexture(data, w, h, format);
+        return LoadTextureFromData(pixels.data(), fallback, w, h, w * 4, cGenerateMips);
+      }
+
+      std::vector<unsigned char> pixels;
+      for (int level = 0; level < levels; ++level)
+      {
+        auto levelPixels = DecompressTexture(data + GetMipOffset(format, w, h, level), GetMipSize(w, level), GetMipSize(h, level), format);
+        pixels.insert(pixels.end(), levelPixels.begin(), levelPixels.end());
+      }
+
+      return LoadTextureFromData(pixels.data(), fallback, w, h, w * 4, levels);
+    }
+
+    // Compressed formats can't be render targets, so their chains are built on the CPU.
+    std::vector<unsigned char> chain;
+    if (cGenerateMips == aMipLevels && IsBlockCompressed(format))
+    {
+      auto pixels = DecompressTexture(data, w, h, format);
+      chain = GenerateMipChain(pixels.data(), w, h, w * 4, format);
+      data = chain.data();
+      pitch = GetRowPitch(format, w);
+      aMipLevels = levels;
+    }
+
+    bool const generateOnGpu = cGenerateMips == aMipLevels;
+
+    // Uncompressed chains are always made GPU generatable, even when the levels came from
+    // the CPU, so UpdateTexture can keep them in step with level 0.
+    bool const canGenerateMips = levels > 1 && !IsBlockCompressed(format);
+
     // Create texture
     D3D11_TEXTURE2D_DESC desc;
     ZeroMemory(&desc, sizeof(desc));
     desc.Width = w;
     desc.Height = h;
-    desc.MipLevels = 1;
+    desc.MipLevels = levels;
     desc.ArraySize = 1;
     desc.Format = FromSOIS(format);
     desc.SampleDesc.Count = 1;
     desc.Usage = D3D11_USAGE_DEFAULT;
-    desc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+    desc.BindFlags = D3D11_BIND_SHADER_RESOURCE | (canGenerateMips ? D3D11_BIND_RENDER_TARGET : 0);
     desc.CPUAccessFlags = 0;
+    desc.MiscFlags = canGenerateMips ? D3D11_RESOURCE_MISC_GENERATE_MIPS : 0;
+
+    std::vector<D3D11_SUBRESOURCE_DATA> subResources(levels);
+    for (int level = 0; level < levels; ++level)
+    {
+      subResources[level].pSysMem = data + GetMipOffset(format, w, h, level);
+      subResources[level].SysMemPitch = (0 == level) ? pitch : GetRowPitch(format, GetMipSize(w, level));
+      subResources[level].SysMemSlicePitch = 0;
+    }
 
-    ID3D11Texture2D* pTexture = NULL;
-    D3D11_SUBRESOURCE_DATA subResource;
-    subResource.pSysMem = data;
-    subResource.SysMemPitch = pitch;
-    subResource.SysMemSlicePitch = 0;
-    mD3DDevice->CreateTexture2D(&desc, &subResource, &pTexture);
+    // Textures we can generate mips for can't take initial data, the levels we have are
+    // filled below.
+    winrt::com_ptr<ID3D11Texture2D> pTexture;
+    mD3DDevice->CreateTexture2D(&desc, canGenerateMips ? nullptr : subResources.data(), pTexture.put());
+
+    if (canGenerateMips)
+    {
+      for (int level = 0; level < (generateOnGpu ? 1 : levels); ++level)
+      {
+        mD3DDeviceContext->UpdateSubresource(pTexture.get(), level, nullptr, subResources[level].pSysMem, subResources[level].SysMemPitch, 0);
+      }
+    }
 
     // Create texture view
     winrt::com_ptr<ID3D11ShaderResourceView> shaderResourceView;
     D3D11_SHADER_RESOURCE_VIEW_DESC srvDesc;
     ZeroMemory(&srvDesc, sizeof(srvDesc));
-    srvDesc.Format = (DXGI_FORMAT)format;
+    srvDesc.Format = desc.Format;
     srvDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2D;
     srvDesc.Texture2D.MipLevels = desc.MipLevels;
     srvDesc.Texture2D.MostDetailedMip = 0;
-    mD3DDevice->CreateShaderResourceView(pTexture, &srvDesc, shaderResourceView.put());
-    pTexture->Release();
+    mD3DDevice->CreateShaderResourceView(pTexture.get(), &srvDesc, shaderResourceView.put());
 
-    auto texture = std::make_unique<DX11Texture>(shaderResourceView, w, h);
+    if (generateOnGpu && canGenerateMips)
+    {
+      mD3DDeviceContext->GenerateMips(shaderResourceView.get());
+    }
+
+    auto texture = std::make_unique<DX11Texture>(pTexture, shaderResourceView, w, h);
+    texture->MipLevels = levels;
+    texture->Owner = this;
+    texture->Layout = format;
 
     return std::unique_ptr<Texture>(texture.release());
   }
 
-  std::unique_ptr<Texture> DX11Renderer::LoadTextureFromFile(std::u8string const& aFile)
+  void DX11Renderer::UpdateTexture(Texture* aTexture, TextureRegion aRegion, unsigned char const* aData, int aPitch)
   {
-    // Load from disk into a raw RGBA buffer
-    std::vector<char> imageData;
-    SDL_RWops* io = SDL_RWFromFile((char const*)aFile.c_str(), "rb");
-    if (io != nullptr)
+    if (this != aTexture->Owner)
     {
-      /* Seek to 0 bytes from the end of the file */
-      Sint64 length = SDL_RWseek(io, 0, RW_SEEK_END);
-      SDL_RWseek(io, 0, RW_SEEK_SET);
-      imageData.resize(length);
-      SDL_RWread(io, imageData.data(), length, 1);
-      SDL_RWclose(io);
+      SDL_assert(false && "UpdateTexture was given a texture this renderer didn't load.");
+      return;
     }
 
-    int image_width = 0;
-    int image_height = 0;
-    unsigned char* image_data = stbi_load_from_memory((unsigned char*)imageData.data(), imageData.size(), &image_width, &image_height, NULL, 4);
-    if (image_data == NULL)
-      return nullptr;
+    TextureContentsChanged(aTexture);
+    auto texture = static_cast<DX11Texture*>(aTexture);
 
-    // Create texture
-    D3D11_TEXTURE2D_DESC desc;
-    ZeroMemory(&desc, sizeof(desc));
-    desc.Width = image_width;
-    desc.Height = image_height;
-    desc.MipLevels = 1;
-    desc.ArraySize = 1;
-    desc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
-    desc.SampleDesc.Count = 1;
-    desc.Usage = D3D11_USAGE_DEFAULT;
-    desc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
-    desc.CPUAccessFlags = 0;
+    D3D11_BOX box;
+    box.left = aRegion.X;
+    box.top = aRegion.Y;
+    box.front = 0;
+    box.right = aRegion.X + aRegion.Width;
+    box.bottom = aRegion.Y + aRegion.Height;
+    box.back = 1;
 
-    ID3D11Texture2D* pTexture = NULL;
-    D3D11_SUBRESOURCE_DATA subResource;
-    subResource.pSysMem = image_data;
-    subResource.SysMemPitch = desc.Width * 4;
-    subResource.SysMemSlicePitch = 0;
-    mD3DDevice->CreateTexture2D(&desc, &subResource, &pTexture);
+    mD3DDeviceContext->UpdateSubresource(texture->Texture2D.get(), 0, &box, aData, aPitch, 0);
 
-    // Create texture view
-    winrt::com_ptr<ID3D11ShaderResourceView> shaderResourceView;
-    D3D11_SHADER_RESOURCE_VIEW_DESC srvDesc;
-    ZeroMemory(&srvDesc, sizeof(srvDesc));
-    srvDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
-    srvDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2D;
-    srvDesc.Texture2D.MipLevels = desc.MipLevels;
-    srvDesc.Texture2D.MostDetailedMip = 0;
-    mD3DDevice->CreateShaderResourceView(pTexture, &srvDesc, shaderResourceView.put());
-    pTexture->Release();
-
-    stbi_image_free(image_data);
-    auto texture = std::make_unique<DX11Texture>(shaderResourceView, image_width, image_height);
-
-    return std::unique_ptr<Texture>(texture.release());
+    // Keep the smaller levels in step with the new contents, if we're the ones making them.
+    D3D11_TEXTURE2D_DESC desc;
+    texture->Texture2D->GetDesc(&desc);
+    if (desc.MiscFlags & D3D11_RESOURCE_MISC_GENERATE_MIPS)
+    {
+      mD3DDeviceContext->GenerateMips(texture->ShaderResourceView.get());
+    }
   }
 }
@@ -19,6 +19,7 @@ namespace SOIS
     ~DX11Renderer() override;
 
     void Initialize(SDL_Window* aWindow) override;
+    void SetPresentMode(PresentMode aMode) override;
 
     void NewFrame() override;
     void ResizeRenderTarget(unsigned int aWidth, unsigned int aHeight) override;
@@ -27,6 +28,10 @@ namespace SOIS
     void RenderImguiData() override;
     void Present() override;
 
+    void* InsertFrameFence() override;
+    bool IsFrameFenceSignalled(void* aFence) override;
+    void DestroyFrameFence(void* aFence) override;
+
 
     // Ostensibly private
     bool CreateDeviceD3D(HWND hWnd);
@@ -34,13 +39,25 @@ namespace SOIS
     void CleanupDeviceD3D();
     void CleanupRenderTarget();
 
-    std::unique_ptr<Texture> LoadTextureFromData(unsigned char* data, TextureLayout format, int w, int h, int pitch) override;
-    std::unique_ptr<Texture> LoadTextureFromFile(std::u8string const& aFile) override;
+    // Whether aLayout can be created directly at this size, compressed layouts that
+    // can't are decompressed on load.
+    bool SupportsLayout(TextureLayout aLayout, int aWidth, int aHeight);
+
+    // The ImGui backend's sampler is clamped to the top mip, this puts a callback at the
+    // start of the first draw list (and after any ImDrawCallback_ResetRenderState, which
+    // puts theirs back) that binds one that isn't.
+    void BindMipSampler(ImDrawData* aDrawData);
+
+    std::unique_ptr<Texture> LoadTextureFromData(unsigned char* data, TextureLayout format, int w, int h, int pitch, int aMipLevels = 1) override;
+    void UpdateTexture(Texture* aTexture, TextureRegion aRegion, unsigned char const* aData, int aPitch) override;
 
     winrt::com_ptr<ID3D11Device> mD3DDevice = nullptr;
     winrt::com_ptr<ID3D11DeviceContext> mD3DDeviceContext = nullptr;
     winrt::com_ptr<IDXGISwapChain> mSwapChain = nullptr;
     ID3D11RenderTargetView* mMainRenderTargetView = nullptr;
     SDL_Window* mWindow = nullptr;
+    D3D_FEATURE_LEVEL mFeatureLevel = D3D_FEATURE_LEVEL_10_0;
+    winrt::com_ptr<ID3D11SamplerState> mMipSampler = nullptr;
+    UINT mSyncInterval = 1;
   };
 }
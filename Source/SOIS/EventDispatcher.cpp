@@ -0,0 +1,190 @@
+#include <algorithm>
+
+#include "SOIS/EventDispatcher.hpp"
+
+namespace SOIS
+{
+  EventDispatcher::~EventDispatcher()
+  {
+  }
+
+  EventDispatcher::SubscriptionList* EventDispatcher::FindList(Uint32 aType)
+  {
+    Page* page = mPages[(aType >> 8) & 0xFF].get();
+    if (nullptr == page)
+    {
+      return nullptr;
+    }
+
+    return &(*page)[aType & 0xFF];
+  }
+
+  EventDispatcher::SubscriptionList& EventDispatcher::GetList(Uint32 aType)
+  {
+    std::unique_ptr<Page>& page = mPages[(aType >> 8) & 0xFF];
+    if (nullptr == page)
+    {
+      page = std::make_unique<Page>();
+    }
+
+    return (*page)[aType & 0xFF];
+  }
+
+  void EventDispatcher::Insert(SubscriptionList& aList, Subscription&& aSubscription)
+  {
+    // After everything with the same or a higher priority, so ties keep their order.
+    auto position = std::find_if(aList.begin(), aList.end(), [&](Subscription const& aOther)
+    {
+      return aOther.mPriority < aSubscription.mPriority;
+    });
+
+    aList.insert(position, std::move(aSubscription));
+  }
+
+  bool EventDispatcher::Remove(SubscriptionList& aList, SubscriptionId aId)
+  {
+    auto position = std::find_if(aList.begin(), aList.end(), [aId](Subscription const& aSubscription)
+    {
+      return aSubscription.mId == aId;
+    });
+
+    if (aList.end() == position)
+    {
+      return false;
+    }
+
+    aList.erase(position);
+    return true;
+  }
+
+  SubscriptionId EventDispatcher::Subscribe(Uint32 aType, EventCallback aCallback, int aPriority)
+  {
+    Subscription subscription{ std::move(aCallback), mNextId++, aPriority };
+    SubscriptionId id = subscription.mId;
+
+    if (0 != mDispatchDepth)
+    {
+      mPending.emplace_back(PendingSubscription{ std::move(subscription), aType, false });
+      return id;
+    }
+
+    Insert(GetList(aType), std::move(subscription));
+    return id;
+  }
+
+  SubscriptionId EventDispatcher::SubscribeAll(EventCallback aCallback, int aPriority)
+  {
+    Subscription subscription{ std::move(aCallback), mNextId++, aPriority };
+    SubscriptionId id = subscription.mId;
+
+    if (0 != mDispatchDepth)
+    {
+      mPending.emplace_back(PendingSubscription{ std::move(subscription), 0, true });
+      return id;
+    }
+
+    Insert(mAll, std::move(subscription));
+    return id;
+  }
+
+  void EventDispatcher::Unsubscribe(SubscriptionId aId)
+  {
+    // The handler we're removing could be the one running right now.
+    if (0 != mDispatchDepth)
+    {
+      mPendingRemovals.emplace_back(aId);
+      return;
+    }
+
+    if (Remove(mAll, aId))
+    {
+      return;
+    }
+
+    // Rare enough that searching everything beats keeping an index of where ids live.
+    for (auto& page : mPages)
+    {
+      if (nullptr == page)
+      {
+        continue;
+      }
+
+      for (SubscriptionList& list : *page)
+      {
+        if (Remove(list, aId))
+        {
+          return;
+        }
+      }
+    }
+  }
+
+  bool EventDispatcher::IsPendingRemoval(SubscriptionId aId) const
+  {
+    return mPendingRemovals.end() != std::find(mPendingRemovals.begin(), mPendingRemovals.end(), aId);
+  }
+
+  void EventDispatcher::FlushPending()
+  {
+    // Pending subscriptions may be the ones being removed, so add them first.
+    for (PendingSubscription& pending : mPending)
+    {
+      Insert(pending.mAll ? mAll : GetList(pending.mType), std::move(pending.mSubscription));
+    }
+
+    mPending.clear();
+
+    // Unsubscribe would just queue these up again while they're still pending.
+    std::vector<SubscriptionId> removals;
+    removals.swap(mPendingRemovals);
+    for (SubscriptionId id : removals)
+    {
+      Unsubscribe(id);
+    }
+  }
+
+  bool EventDispatcher::Dispatch(SDL_Event& aEvent)
+  {
+    SubscriptionList* typed = FindList(aEvent.type);
+    size_t typedCount = (nullptr != typed) ? typed->size() : 0;
+    size_t allCount = mAll.size();
+
+    if (0 == typedCount && 0 == allCount)
+    {
+      return false;
+    }
+
+    ++mDispatchDepth;
+
+    // Both lists are sorted by priority, so walk them together like a merge.
+    bool consumed = false;
+    size_t t = 0;
+    size_t a = 0;
+    while (false == consumed && (t < typedCount || a < allCount))
+    {
+      Subscription* next;
+      if (a >= allCount || (t < typedCount && (*typed)[t].mPriority >= mAll[a].mPriority))
+      {
+        next = &(*typed)[t++];
+      }
+      else
+      {
+        next = &mAll[a++];
+      }
+
+      if (false == mPendingRemovals.empty() && IsPendingRemoval(next->mId))
+      {
+        continue;
+      }
+
+      consumed = next->mCallback(aEvent);
+    }
+
+    if (0 == --mDispatchDepth)
+    {
+      FlushPending();
+    }
+
+    return consumed;
+  }
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include <SDL.h>
+
+namespace SOIS
+{
+  // Return true to consume the event, handlers with a lower priority won't see it.
+  using EventCallback = std::function<bool(SDL_Event&)>;
+
+  using SubscriptionId = uint64_t;
+
+  // Routes SDL events to handlers subscribed to their type. Lookups go through a flat
+  // table indexed by event type, so handlers only ever see the events they asked for,
+  // no matter how many other subsystems are listening. Handlers with a higher priority
+  // run first, equal priorities run in the order they subscribed (typed ones before
+  // those subscribed to everything).
+  //
+  // Subscribing and unsubscribing from inside a handler is fine, new handlers start
+  // with the next event.
+  class EventDispatcher
+  {
+  public:
+    EventDispatcher() = default;
+    ~EventDispatcher();
+
+    EventDispatcher(EventDispatcher const&) = delete;
+    EventDispatcher& operator=(EventDispatcher const&) = delete;
+
+    // aType is an SDL_EventType, like SDL_KEYDOWN or one from SDL_RegisterEvents.
+    SubscriptionId Subscribe(Uint32 aType, EventCallback aCallback, int aPriority = 0);
+
+    // Every event, regardless of type. Priorities interleave with typed subscriptions.
+    SubscriptionId SubscribeAll(EventCallback aCallback, int aPriority = 0);
+
+    void Unsubscribe(SubscriptionId aId);
+
+    // Returns true if a handler consumed the event.
+    bool Dispatch(SDL_Event& aEvent);
+
+  private:
+    struct Subscription
+    {
+      EventCallback mCallback;
+      SubscriptionId mId;
+      int mPriority;
+    };
+
+    using SubscriptionList = std::vector<Subscription>;
+
+    // SDL event types are a category in the high byte and an event in the low one, so
+    // the table is split in pages by category and only the pages in use get allocated.
+    using Page = std::array<SubscriptionList, 256>;
+
+    SubscriptionList* FindList(Uint32 aType);
+    SubscriptionList& GetList(Uint32 aType);
+    static void Insert(SubscriptionList& aList, Subscription&& aSubscription);
+    static bool Remove(SubscriptionList& aList, SubscriptionId aId);
+    bool IsPendingRemoval(SubscriptionId aId) const;
+    void FlushPending();
+
+    std::array<std::unique_ptr<Page>, 256> mPages;
+    SubscriptionList mAll;
+
+    // Changes made while dispatching, applied once we're done.
+    struct PendingSubscription
+    {
+      Subscription mSubscription;
+      Uint32 mType;
+      bool mAll;
+    };
+
+    std::vector<PendingSubscription> mPending;
+    std::vector<SubscriptionId> mPendingRemovals;
+
+    SubscriptionId mNextId = 1;
+    int mDispatchDepth = 0;
+  };
+}
@@ -0,0 +1,242 @@
+#include <atomic>
+#include <filesystem>
+#include <functional>
+#include <system_error>
+#include <thread>
+#include <utility>
+
+#if defined(_WIN32)
+  #define NOMINMAX
+  #define WIN32_LEAN_AND_MEAN
+  #include <windows.h>
+#else
+  #include <fcntl.h>
+  #include <sys/mman.h>
+  #include <sys/stat.h>
+  #include <unistd.h>
+#endif
+
+#include <SDL.h>
+
+#include "SOIS/File.hpp"
+
+namespace SOIS
+{
+  ////////////////////
+  // MappedFile
+  // Maps all of aFile read only, returns nullptr if anything along the way fails.
+  static void* MapFile(std::u8string const& aFile, size_t& aSize)
+  {
+#if defined(_WIN32)
+    int length = MultiByteToWideChar(CP_UTF8, 0, (char const*)aFile.c_str(), -1, nullptr, 0);
+    std::wstring path(length, L'\0');
+    MultiByteToWideChar(CP_UTF8, 0, (char const*)aFile.c_str(), -1, path.data(), length);
+
+    HANDLE file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (INVALID_HANDLE_VALUE == file)
+    {
+      return nullptr;
+    }
+
+    LARGE_INTEGER size;
+    void* view = nullptr;
+    if (GetFileSizeEx(file, &size) && size.QuadPart > 0)
+    {
+      // The view keeps the mapping alive, so neither handle needs to outlive this.
+      HANDLE mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+      if (nullptr != mapping)
+      {
+        view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+        CloseHandle(mapping);
+      }
+
+      aSize = static_cast<size_t>(size.QuadPart);
+    }
+
+    CloseHandle(file);
+    return view;
+#else
+    int file = open((char const*)aFile.c_str(), O_RDONLY | O_CLOEXEC);
+    if (-1 == file)
+    {
+      return nullptr;
+    }
+
+    struct stat status;
+    void* view = nullptr;
+    if (0 == fstat(file, &status) && status.st_size > 0)
+    {
+      view = mmap(nullptr, static_cast<size_t>(status.st_size), PROT_READ, MAP_PRIVATE, file, 0);
+      if (MAP_FAILED == view)
+      {
+        view = nullptr;
+      }
+      else
+      {
+        // Decoders walk the file front to back, let the kernel read ahead.
+        madvise(view, static_cast<size_t>(status.st_size), MADV_SEQUENTIAL);
+        aSize = static_cast<size_t>(status.st_size);
+      }
+    }
+
+    // The mapping holds its own reference to the file.
+    close(file);
+    return view;
+#endif
+  }
+
+  static void UnmapFile(void* aView, size_t aSize)
+  {
+#if defined(_WIN32)
+    (void)aSize;
+    UnmapViewOfFile(aView);
+#else
+    munmap(aView, aSize);
+#endif
+  }
+
+  MappedFile::~MappedFile()
+  {
+    Close();
+  }
+
+  MappedFile::MappedFile(MappedFile&& aOther) noexcept
+  {
+    *this = std::move(aOther);
+  }
+
+  MappedFile& MappedFile::operator=(MappedFile&& aOther) noexcept
+  {
+    if (this != &aOther)
+    {
+      Close();
+
+      // Moving the vector keeps its storage, so mData stays valid in the fallback case too.
+      mData = std::exchange(aOther.mData, nullptr);
+      mSize = std::exchange(aOther.mSize, 0);
+      mMapping = std::exchange(aOther.mMapping, nullptr);
+      mBuffer = std::move(aOther.mBuffer);
+    }
+
+    return *this;
+  }
+
+  void MappedFile::Close()
+  {
+    if (nullptr != mMapping)
+    {
+      UnmapFile(mMapping, mSize);
+      mMapping = nullptr;
+    }
+
+    mBuffer.clear();
+    mData = nullptr;
+    mSize = 0;
+  }
+
+  std::optional<MappedFile> MappedFile::Open(std::u8string const& aFile)
+  {
+    MappedFile file;
+
+    size_t size = 0;
+    if (void* view = MapFile(aFile, size))
+    {
+      file.mMapping = view;
+      file.mData = static_cast<unsigned char const*>(view);
+      file.mSize = size;
+      return file;
+    }
+
+    // Empty files, pipes, exotic filesystems, or platforms without mapping.
+    auto data = ReadFile(aFile);
+    if (!data)
+    {
+      return std::nullopt;
+    }
+
+    file.mBuffer = std::move(*data);
+    file.mData = file.mBuffer.data();
+    file.mSize = file.mBuffer.size();
+    return file;
+  }
+
+  ////////////////////
+  // Plain reads and writes
+  std::optional<std::vector<unsigned char>> ReadFile(std::u8string const& aFile)
+  {
+    SDL_RWops* io = SDL_RWFromFile((char const*)aFile.c_str(), "rb");
+    if (io == nullptr)
+    {
+      return std::nullopt;
+    }
+
+    std::vector<unsigned char> data;
+
+    Sint64 length = SDL_RWsize(io);
+    if (length < 0)
+    {
+      SDL_RWclose(io);
+      return std::nullopt;
+    }
+
+    data.resize(static_cast<size_t>(length));
+    bool read = (0 == length) || (1 == SDL_RWread(io, data.data(), data.size(), 1));
+    SDL_RWclose(io);
+
+    if (!read)
+    {
+      return std::nullopt;
+    }
+
+    return data;
+  }
+
+  bool WriteFileAtomic(std::u8string const& aFile, void const* aHeader, size_t aHeaderSize, void const* aData, size_t aSize)
+  {
+    // Unique per process, thread and call, so nothing else sharing the directory (another
+    // instance using the same cache, say) writes to our temporary. Where fopen supports
+    // exclusive ("x") opens a collision fails instead, and we move on to the next name.
+    static std::atomic<uint64_t> sTemporaryCount = 0;
+
+#if defined(_WIN32)
+    unsigned long processId = GetCurrentProcessId();
+#else
+    unsigned long processId = static_cast<unsigned long>(getpid());
+#endif
+
+    std::u8string temporary;
+    SDL_RWops* io = nullptr;
+    for (int attempt = 0; attempt < 4 && nullptr == io; ++attempt)
+    {
+      std::string suffix = ".tmp" + std::to_string(processId) + "-" +
+                           std::to_string(std::hash<std::thread::id>{}(std::this_thread::get_id())) + "-" +
+                           std::to_string(sTemporaryCount++);
+
+      temporary = aFile;
+      temporary.append(suffix.begin(), suffix.end());
+      io = SDL_RWFromFile((char const*)temporary.c_str(), "wbx");
+    }
+
+    if (io == nullptr)
+    {
+      return false;
+    }
+
+    bool written = (0 == aHeaderSize || 1 == SDL_RWwrite(io, aHeader, aHeaderSize, 1)) &&
+                   (0 == aSize || 1 == SDL_RWwrite(io, aData, aSize, 1));
+    written = (0 == SDL_RWclose(io)) && written;
+
+    std::error_code error;
+    if (written)
+    {
+      std::filesystem::rename(std::filesystem::path(temporary), std::filesystem::path(aFile), error);
+      if (!error)
+      {
+        return true;
+      }
+    }
+
+    std::filesystem::remove(std::filesystem::path(temporary), error);
+    return false;
+  }
+}
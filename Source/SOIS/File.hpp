@@ -0,0 +1,59 @@
+#pragma once
+
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace SOIS
+{
+  // Read only view of a whole file. It's memory mapped where we can, so decoders read
+  // straight from the page cache without us holding a copy. Otherwise, or if mapping
+  // fails, it falls back to reading the file into a buffer we own.
+  class MappedFile
+  {
+  public:
+    MappedFile() = default;
+    ~MappedFile();
+
+    MappedFile(MappedFile&& aOther) noexcept;
+    MappedFile& operator=(MappedFile&& aOther) noexcept;
+
+    MappedFile(MappedFile const&) = delete;
+    MappedFile& operator=(MappedFile const&) = delete;
+
+    // nullopt if the file can't be opened or read.
+    static std::optional<MappedFile> Open(std::u8string const& aFile);
+
+    unsigned char const* GetData() const
+    {
+      return mData;
+    }
+
+    size_t GetSize() const
+    {
+      return mSize;
+    }
+
+    bool IsMapped() const
+    {
+      return nullptr != mMapping;
+    }
+
+  private:
+    void Close();
+
+    unsigned char const* mData = nullptr;
+    size_t mSize = 0;
+
+    // Start of the mapped view, nullptr when we fell back to mBuffer.
+    void* mMapping = nullptr;
+    std::vector<unsigned char> mBuffer;
+  };
+
+  // Whole file reads and writes through SDL_RWops, safe to call from any thread.
+  std::optional<std::vector<unsigned char>> ReadFile(std::u8string const& aFile);
+
+  // Writes to a temporary next to aFile and renames it over, so readers never see a
+  // partially written file. Returns false on failure.
+  bool WriteFileAtomic(std::u8string const& aFile, void const* aHeader, size_t aHeaderSize, void const* aData, size_t aSize);
+}
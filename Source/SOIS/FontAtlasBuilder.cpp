@@ -0,0 +1,532 @@
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+#include <ft2build.h>
+#include FT_FREETYPE_H
+#include FT_SYNTHESIS_H
+
+#include <stb_rect_pack.h>
+
+#include "imgui.h"
+#include "imgui_internal.h"
+#include "imgui_freetype.h"
+
+#include "SOIS/FontAtlasBuilder.hpp"
+#include "SOIS/Profiler.hpp"
+#include "SOIS/ThreadPool.hpp"
+
+namespace SOIS
+{
+  // Same limit ImGui's builders pack against.
+  static constexpr int cMaxTextureHeight = 1024 * 32;
+
+  // Fewer than this and a chunk isn't worth a FreeType library and face of its own.
+  static constexpr size_t cMinGlyphsPerChunk = 256;
+
+  // Chunks per thread, so one slow chunk (a font of large or complex glyphs) doesn't
+  // leave the rest of the pool idle at the end.
+  static constexpr size_t cChunksPerThread = 4;
+
+  static int FreeTypeCeil(FT_Pos aValue)
+  {
+    return static_cast<int>((aValue + 63) >> 6);
+  }
+
+  struct BuildGlyph
+  {
+    uint32_t mCodepoint;
+    int mWidth = 0;
+    int mHeight = 0;
+    int mOffsetX = 0;
+    int mOffsetY = 0;
+    float mAdvanceX = 0.f;
+
+    // Into the owning chunk's pixels.
+    size_t mPixelOffset = 0;
+    bool mLoaded = false;
+  };
+
+  struct BuildSource
+  {
+    ImFontConfig* mConfig = nullptr;
+    int mDstIndex = -1;
+    ImWchar const* mRanges = nullptr;
+    int mHighest = 0;
+
+    unsigned int mFlags = 0;
+    FT_Int32 mLoadFlags = 0;
+    FT_Render_Mode mRenderMode = FT_RENDER_MODE_NORMAL;
+    std::array<unsigned char, 256> mMultiply;
+    bool mMultiplyEnabled = false;
+
+    bool mFaceLoaded = false;
+    float mAscent = 0.f;
+    float mDescent = 0.f;
+
+    // Every codepoint in the ranges the font has, ascending.
+    std::vector<uint32_t> mAvailable;
+
+    // What's left of those once earlier fonts merged into the same one have had theirs.
+    std::vector<BuildGlyph> mGlyphs;
+    std::vector<stbrp_rect> mRects;
+  };
+
+  struct BuildChunk
+  {
+    size_t mSource;
+    size_t mBegin;
+    size_t mEnd;
+    std::vector<unsigned char> mPixels;
+  };
+
+  // FreeType libraries aren't safe to share between threads, so every job opens its own
+  // over the font data the atlas already holds.
+  class BuildFace
+  {
+  public:
+    BuildFace(BuildSource const& aSource)
+    {
+      FT_Library library;
+      if (0 != FT_Init_FreeType(&library))
+      {
+        return;
+      }
+
+      mLibrary = library;
+
+      ImFontConfig const& config = *aSource.mConfig;
+      FT_Face face;
+      if (0 != FT_New_Memory_Face(mLibrary, static_cast<FT_Byte const*>(config.FontData), static_cast<FT_Long>(config.FontDataSize), config.FontNo, &face))
+      {
+        return;
+      }
+
+      mFace = face;
+      FT_Select_Charmap(mFace, FT_ENCODING_UNICODE);
+
+      FT_Size_RequestRec request;
+      request.type = FT_SIZE_REQUEST_TYPE_REAL_DIM;
+      request.width = 0;
+      request.height = static_cast<uint32_t>(config.SizePixels) * 64;
+      request.horiResolution = 0;
+      request.vertResolution = 0;
+      FT_Request_Size(mFace, &request);
+    }
+
+    ~BuildFace()
+    {
+      if (nullptr != mFace)
+      {
+        FT_Done_Face(mFace);
+      }
+
+      if (nullptr != mLibrary)
+      {
+        FT_Done_FreeType(mLibrary);
+      }
+    }
+
+    BuildFace(BuildFace const&) = delete;
+    BuildFace& operator=(BuildFace const&) = delete;
+
+    FT_Face Get() const
+    {
+      return mFace;
+    }
+
+  private:
+    FT_Library mLibrary = nullptr;
+    FT_Face mFace = nullptr;
+  };
+
+  static void SetupFlags(BuildSource& aSource, unsigned int aFreeTypeFlags)
+  {
+    aSource.mFlags = aFreeTypeFlags | aSource.mConfig->RasterizerFlags;
+    aSource.mLoadFlags = FT_LOAD_NO_BITMAP;
+    if (aSource.mFlags & ImGuiFreeType::NoHinting)
+    {
+      aSource.mLoadFlags |= FT_LOAD_NO_HINTING;
+    }
+    if (aSource.mFlags & ImGuiFreeType::NoAutoHint)
+    {
+      aSource.mLoadFlags |= FT_LOAD_NO_AUTOHINT;
+    }
+    if (aSource.mFlags & ImGuiFreeType::ForceAutoHint)
+    {
+      aSource.mLoadFlags |= FT_LOAD_FORCE_AUTOHINT;
+    }
+
+    if (aSource.mFlags & ImGuiFreeType::LightHinting)
+    {
+      aSource.mLoadFlags |= FT_LOAD_TARGET_LIGHT;
+    }
+    else if (aSource.mFlags & ImGuiFreeType::MonoHinting)
+    {
+      aSource.mLoadFlags |= FT_LOAD_TARGET_MONO;
+    }
+    else
+    {
+      aSource.mLoadFlags |= FT_LOAD_TARGET_NORMAL;
+    }
+
+    aSource.mRenderMode = (aSource.mFlags & ImGuiFreeType::Monochrome) ? FT_RENDER_MODE_MONO : FT_RENDER_MODE_NORMAL;
+
+    aSource.mMultiplyEnabled = (1.0f != aSource.mConfig->RasterizerMultiply);
+    if (aSource.mMultiplyEnabled)
+    {
+      ImFontAtlasBuildMultiplyCalcLookupTable(aSource.mMultiply.data(), aSource.mConfig->RasterizerMultiply);
+    }
+  }
+
+  // Opens the face once to get its metrics and find which codepoints in its ranges it has.
+  static void FindAvailableGlyphs(BuildSource& aSource)
+  {
+    BuildFace face(aSource);
+    if (nullptr == face.Get())
+    {
+      return;
+    }
+
+    FT_Size_Metrics const& metrics = face.Get()->size->metrics;
+    aSource.mAscent = static_cast<float>(FreeTypeCeil(metrics.ascender));
+    aSource.mDescent = static_cast<float>(FreeTypeCeil(metrics.descender));
+
+    // Ranges can overlap, the set keeps each codepoint once and in order.
+    std::vector<bool> available(static_cast<size_t>(aSource.mHighest) + 1, false);
+    for (ImWchar const* range = aSource.mRanges; 0 != range[0] && 0 != range[1]; range += 2)
+    {
+      for (uint32_t codepoint = range[0]; codepoint <= range[1]; ++codepoint)
+      {
+        if (false == available[codepoint] && 0 != FT_Get_Char_Index(face.Get(), codepoint))
+        {
+          available[codepoint] = true;
+        }
+      }
+    }
+
+    for (size_t codepoint = 0; codepoint < available.size(); ++codepoint)
+    {
+      if (available[codepoint])
+      {
+        aSource.mAvailable.emplace_back(static_cast<uint32_t>(codepoint));
+      }
+    }
+
+    aSource.mFaceLoaded = true;
+  }
+
+  static void RasterizeChunk(BuildSource& aSource, BuildChunk& aChunk)
+  {
+    BuildFace face(aSource);
+    if (nullptr == face.Get())
+    {
+      return;
+    }
+
+    for (size_t i = aChunk.mBegin; i < aChunk.mEnd; ++i)
+    {
+      BuildGlyph& glyph = aSource.mGlyphs[i];
+
+      FT_UInt glyphIndex = FT_Get_Char_Index(face.Get(), glyph.mCodepoint);
+      if (0 == glyphIndex || 0 != FT_Load_Glyph(face.Get(), glyphIndex, aSource.mLoadFlags))
+      {
+        continue;
+      }
+
+      FT_GlyphSlot slot = face.Get()->glyph;
+      if (aSource.mFlags & ImGuiFreeType::Bold)
+      {
+        FT_GlyphSlot_Embolden(slot);
+      }
+
+      if (aSource.mFlags & ImGuiFreeType::Oblique)
+      {
+        FT_GlyphSlot_Oblique(slot);
+      }
+
+      if (0 != FT_Render_Glyph(slot, aSource.mRenderMode))
+      {
+        continue;
+      }
+
+      FT_Bitmap const& bitmap = slot->bitmap;
+      glyph.mWidth = static_cast<int>(bitmap.width);
+      glyph.mHeight = static_cast<int>(bitmap.rows);
+      glyph.mOffsetX = slot->bitmap_left;
+      glyph.mOffsetY = -slot->bitmap_top;
+      glyph.mAdvanceX = static_cast<float>(FreeTypeCeil(slot->advance.x));
+      glyph.mPixelOffset = aChunk.mPixels.size();
+      glyph.mLoaded = true;
+
+      aChunk.mPixels.resize(aChunk.mPixels.size() + static_cast<size_t>(glyph.mWidth) * glyph.mHeight);
+      unsigned char* pixels = aChunk.mPixels.data() + glyph.mPixelOffset;
+
+      for (int row = 0; row < glyph.mHeight; ++row)
+      {
+        unsigned char const* source = bitmap.buffer + row * bitmap.pitch;
+        unsigned char* destination = pixels + static_cast<size_t>(row) * glyph.mWidth;
+
+        if (FT_PIXEL_MODE_MONO == bitmap.pixel_mode)
+        {
+          unsigned char off = aSource.mMultiplyEnabled ? aSource.mMultiply[0] : 0;
+          unsigned char on = aSource.mMultiplyEnabled ? aSource.mMultiply[255] : 255;
+          for (int column = 0; column < glyph.mWidth; ++column)
+          {
+            destination[column] = (source[column >> 3] & (0x80 >> (column & 7))) ? on : off;
+          }
+        }
+        else if (aSource.mMultiplyEnabled)
+        {
+          for (int column = 0; column < glyph.mWidth; ++column)
+          {
+            destination[column] = aSource.mMultiply[source[column]];
+          }
+        }
+        else
+        {
+          memcpy(destination, source, static_cast<size_t>(glyph.mWidth));
+        }
+      }
+    }
+  }
+
+  bool BuildFontAtlasParallel(ImFontAtlas* aAtlas, unsigned int aFreeTypeFlags, ThreadPool& aPool)
+  {
+    SOIS_PROFILE_SCOPE("BuildFontAtlasParallel");
+
+    IM_ASSERT(aAtlas->ConfigData.Size > 0);
+
+    ImFontAtlasBuildInit(aAtlas);
+
+    aAtlas->TexID = (ImTextureID)nullptr;
+    aAtlas->TexWidth = 0;
+    aAtlas->TexHeight = 0;
+    aAtlas->TexUvScale = ImVec2(0.f, 0.f);
+    aAtlas->TexUvWhitePixel = ImVec2(0.f, 0.f);
+    aAtlas->ClearTexData();
+
+    std::vector<BuildSource> sources(static_cast<size_t>(aAtlas->ConfigData.Size));
+    std::vector<int> dstHighest(static_cast<size_t>(aAtlas->Fonts.Size), 0);
+
+    for (size_t i = 0; i < sources.size(); ++i)
+    {
+      BuildSource& source = sources[i];
+      source.mConfig = &aAtlas->ConfigData[static_cast<int>(i)];
+
+      for (int font = 0; font < aAtlas->Fonts.Size; ++font)
+      {
+        if (source.mConfig->DstFont == aAtlas->Fonts[font])
+        {
+          source.mDstIndex = font;
+          break;
+        }
+      }
+
+      if (source.mDstIndex < 0)
+      {
+        return false;
+      }
+
+      source.mRanges = (nullptr != source.mConfig->GlyphRanges) ? source.mConfig->GlyphRanges : aAtlas->GetGlyphRangesDefault();
+      for (ImWchar const* range = source.mRanges; 0 != range[0] && 0 != range[1]; range += 2)
+      {
+        source.mHighest = std::max(source.mHighest, static_cast<int>(range[1]));
+      }
+
+      dstHighest[source.mDstIndex] = std::max(dstHighest[source.mDstIndex], source.mHighest);
+      SetupFlags(source, aFreeTypeFlags);
+    }
+
+    // 1. Probing the ranges doesn't depend on the other fonts, only merging does.
+    aPool.ParallelFor(sources.size(), [&sources](size_t aIndex)
+    {
+      FindAvailableGlyphs(sources[aIndex]);
+    });
+
+    // 2. Earlier fonts win codepoints merged into the same font, like ImGui.
+    std::vector<std::vector<bool>> dstGlyphs(dstHighest.size());
+    size_t totalGlyphs = 0;
+    for (BuildSource& source : sources)
+    {
+      if (false == source.mFaceLoaded)
+      {
+        return false;
+      }
+
+      std::vector<bool>& taken = dstGlyphs[source.mDstIndex];
+      taken.resize(static_cast<size_t>(dstHighest[source.mDstIndex]) + 1, false);
+
+      for (uint32_t codepoint : source.mAvailable)
+      {
+        if (false == taken[codepoint])
+        {
+          taken[codepoint] = true;
+          source.mGlyphs.emplace_back().mCodepoint = codepoint;
+        }
+      }
+
+      totalGlyphs += source.mGlyphs.size();
+      source.mAvailable = {};
+    }
+
+    // 3. Rasterize, each chunk into its own buffer.
+    size_t chunkSize = std::max(cMinGlyphsPerChunk, totalGlyphs / (aPool.GetThreadCount() * cChunksPerThread) + 1);
+    std::vector<BuildChunk> chunks;
+    for (size_t i = 0; i < sources.size(); ++i)
+    {
+      for (size_t begin = 0; begin < sources[i].mGlyphs.size(); begin += chunkSize)
+      {
+        chunks.push_back({ i, begin, std::min(begin + chunkSize, sources[i].mGlyphs.size()) });
+      }
+    }
+
+    aPool.ParallelFor(chunks.size(), [&sources, &chunks](size_t aIndex)
+    {
+      RasterizeChunk(sources[chunks[aIndex].mSource], chunks[aIndex]);
+    });
+
+    // 4. Pack everything, custom rects first, the same way ImGui does.
+    int const padding = aAtlas->TexGlyphPadding;
+    int totalSurface = 0;
+    for (BuildSource& source : sources)
+    {
+      source.mRects.resize(source.mGlyphs.size());
+      memset(source.mRects.data(), 0, sizeof(stbrp_rect) * source.mRects.size());
+
+      for (size_t i = 0; i < source.mGlyphs.size(); ++i)
+      {
+        BuildGlyph const& glyph = source.mGlyphs[i];
+        if (glyph.mLoaded)
+        {
+          source.mRects[i].w = static_cast<stbrp_coord>(glyph.mWidth + padding);
+          source.mRects[i].h = static_cast<stbrp_coord>(glyph.mHeight + padding);
+          totalSurface += source.mRects[i].w * source.mRects[i].h;
+        }
+      }
+    }
+
+    int const surfaceSqrt = static_cast<int>(std::sqrt(static_cast<float>(totalSurface))) + 1;
+    if (aAtlas->TexDesiredWidth > 0)
+    {
+      aAtlas->TexWidth = aAtlas->TexDesiredWidth;
+    }
+    else
+    {
+      aAtlas->TexWidth = (surfaceSqrt >= 4096 * 0.7f) ? 4096 : (surfaceSqrt >= 2048 * 0.7f) ? 2048 : (surfaceSqrt >= 1024 * 0.7f) ? 1024 : 512;
+    }
+
+    std::vector<stbrp_node> nodes(static_cast<size_t>(aAtlas->TexWidth - padding));
+    stbrp_context packer;
+    stbrp_init_target(&packer, aAtlas->TexWidth, cMaxTextureHeight, nodes.data(), static_cast<int>(nodes.size()));
+
+    std::vector<stbrp_rect> customRects(static_cast<size_t>(aAtlas->CustomRects.Size));
+    memset(customRects.data(), 0, sizeof(stbrp_rect) * customRects.size());
+    for (size_t i = 0; i < customRects.size(); ++i)
+    {
+      customRects[i].w = static_cast<stbrp_coord>(aAtlas->CustomRects[static_cast<int>(i)].Width);
+      customRects[i].h = static_cast<stbrp_coord>(aAtlas->CustomRects[static_cast<int>(i)].Height);
+    }
+
+    if (false == customRects.empty())
+    {
+      stbrp_pack_rects(&packer, customRects.data(), static_cast<int>(customRects.size()));
+    }
+
+    for (size_t i = 0; i < customRects.size(); ++i)
+    {
+      if (customRects[i].was_packed)
+      {
+        aAtlas->CustomRects[static_cast<int>(i)].X = static_cast<unsigned short>(customRects[i].x);
+        aAtlas->CustomRects[static_cast<int>(i)].Y = static_cast<unsigned short>(customRects[i].y);
+        aAtlas->TexHeight = std::max(aAtlas->TexHeight, customRects[i].y + customRects[i].h);
+      }
+    }
+
+    for (BuildSource& source : sources)
+    {
+      if (source.mRects.empty())
+      {
+        continue;
+      }
+
+      stbrp_pack_rects(&packer, source.mRects.data(), static_cast<int>(source.mRects.size()));
+
+      for (stbrp_rect const& rect : source.mRects)
+      {
+        if (rect.was_packed)
+        {
+          aAtlas->TexHeight = std::max(aAtlas->TexHeight, rect.y + rect.h);
+        }
+      }
+    }
+
+    aAtlas->TexHeight = (aAtlas->Flags & ImFontAtlasFlags_NoPowerOfTwoHeight) ? (aAtlas->TexHeight + 1) : ImUpperPowerOfTwo(aAtlas->TexHeight);
+    aAtlas->TexUvScale = ImVec2(1.f / aAtlas->TexWidth, 1.f / aAtlas->TexHeight);
+
+    size_t const texturePitch = static_cast<size_t>(aAtlas->TexWidth);
+    aAtlas->TexPixelsAlpha8 = static_cast<unsigned char*>(IM_ALLOC(texturePitch * aAtlas->TexHeight));
+    memset(aAtlas->TexPixelsAlpha8, 0, texturePitch * aAtlas->TexHeight);
+
+    // 5. Blit, the rects never overlap so chunks can go in parallel again.
+    unsigned char* texture = aAtlas->TexPixelsAlpha8;
+    aPool.ParallelFor(chunks.size(), [&sources, &chunks, texture, texturePitch, padding](size_t aIndex)
+    {
+      BuildChunk const& chunk = chunks[aIndex];
+      BuildSource const& source = sources[chunk.mSource];
+
+      for (size_t i = chunk.mBegin; i < chunk.mEnd; ++i)
+      {
+        BuildGlyph const& glyph = source.mGlyphs[i];
+        stbrp_rect const& rect = source.mRects[i];
+        if (false == glyph.mLoaded || false == static_cast<bool>(rect.was_packed))
+        {
+          continue;
+        }
+
+        unsigned char const* from = chunk.mPixels.data() + glyph.mPixelOffset;
+        unsigned char* to = texture + (rect.y + padding) * texturePitch + rect.x + padding;
+        for (int row = 0; row < glyph.mHeight; ++row)
+        {
+          memcpy(to + row * texturePitch, from + static_cast<size_t>(row) * glyph.mWidth, static_cast<size_t>(glyph.mWidth));
+        }
+      }
+    });
+
+    // 6. Registering glyphs touches the fonts, so that stays in order on this thread.
+    for (BuildSource& source : sources)
+    {
+      ImFontConfig& config = *source.mConfig;
+      ImFont* font = config.DstFont;
+      ImFontAtlasBuildSetupFont(aAtlas, font, &config, source.mAscent, source.mDescent);
+
+      float const offsetX = config.GlyphOffset.x;
+      float const offsetY = config.GlyphOffset.y + IM_ROUND(font->Ascent);
+
+      for (size_t i = 0; i < source.mGlyphs.size(); ++i)
+      {
+        BuildGlyph const& glyph = source.mGlyphs[i];
+        stbrp_rect const& rect = source.mRects[i];
+        if ((0 == rect.w && 0 == rect.h) || false == static_cast<bool>(rect.was_packed))
+        {
+          continue;
+        }
+
+        int const tx = rect.x + padding;
+        int const ty = rect.y + padding;
+        float const x0 = glyph.mOffsetX + offsetX;
+        float const y0 = glyph.mOffsetY + offsetY;
+
+        font->AddGlyph(&config, static_cast<ImWchar>(glyph.mCodepoint),
+          x0, y0, x0 + glyph.mWidth, y0 + glyph.mHeight,
+          tx * aAtlas->TexUvScale.x, ty * aAtlas->TexUvScale.y, (tx + glyph.mWidth) * aAtlas->TexUvScale.x, (ty + glyph.mHeight) * aAtlas->TexUvScale.y,
+          glyph.mAdvanceX);
+      }
+    }
+
+    ImFontAtlasBuildFinish(aAtlas);
+    return true;
+  }
+}
@@ -0,0 +1,19 @@
+#pragma once
+
+#include "imgui.h"
+
+namespace SOIS
+{
+  class ThreadPool;
+
+  // A drop in for ImGuiFreeType::BuildFontAtlas that spreads the work over aPool. Which
+  // codepoints each font provides is worked out per font in parallel, then each font's
+  // glyphs are split into chunks that are rasterized in parallel, each with its own
+  // FreeType library. Packing happens once on the calling thread, and the bitmaps are
+  // blitted into the atlas in parallel again. Glyph placement, metrics and merge order
+  // match ImGui's builder.
+  //
+  // aFreeTypeFlags are ImGuiFreeType::RasterizerFlags. Returns false if a font couldn't
+  // be loaded.
+  bool BuildFontAtlasParallel(ImFontAtlas* aAtlas, unsigned int aFreeTypeFlags, ThreadPool& aPool);
+}
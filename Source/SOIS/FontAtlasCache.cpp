@@ -0,0 +1,567 @@
+#include <cinttypes>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <system_error>
+
+#include "imgui.h"
+#include "imgui_freetype.h"
+
+#include "SOIS/File.hpp"
+#include "SOIS/FontAtlasBuilder.hpp"
+#include "SOIS/FontAtlasCache.hpp"
+#include "SOIS/Hash.hpp"
+#include "SOIS/Profiler.hpp"
+
+namespace SOIS
+{
+  static constexpr uint32_t cMagic = 0x46494F53; // "SOIF"
+
+  // Bump whenever the layout of an entry, or the way we build the atlas, changes. Old
+  // entries then just miss.
+  static constexpr uint32_t cVersion = 1;
+
+  // Tables start right after the header, pixels start on the first cache line after them.
+  static constexpr uint64_t cTablesOffset = 64;
+  static constexpr uint64_t cPixelsAlignment = 64;
+
+  struct EntryHeader
+  {
+    uint32_t mMagic;
+    uint32_t mVersion;
+    uint64_t mKey;
+    uint64_t mTablesSize;
+    uint64_t mPixelsOffset;
+    uint64_t mPixelsSize;
+  };
+
+  static_assert(sizeof(EntryHeader) <= cTablesOffset);
+
+  // Everything below is written field by field rather than copying ImGui's structs, they
+  // hold pointers and bitfields.
+  struct AtlasRecord
+  {
+    int32_t mTexWidth;
+    int32_t mTexHeight;
+    float mTexUvScale[2];
+    float mTexUvWhitePixel[2];
+    int32_t mLineCount;
+    int32_t mCustomRectCount;
+    int32_t mPackIdMouseCursors;
+    int32_t mPackIdLines;
+    int32_t mFontCount;
+    int32_t mConfigCount;
+  };
+
+  struct CustomRectRecord
+  {
+    uint16_t mWidth;
+    uint16_t mHeight;
+    uint16_t mX;
+    uint16_t mY;
+    uint32_t mGlyphId;
+    float mGlyphAdvanceX;
+    float mGlyphOffset[2];
+    int32_t mFont;
+  };
+
+  struct FontRecord
+  {
+    float mFontSize;
+    float mAscent;
+    float mDescent;
+    int32_t mFallbackChar;
+    int32_t mEllipsisChar;
+    int32_t mConfigDataStart;
+    int32_t mConfigDataCount;
+    int32_t mMetricsTotalSurface;
+    int32_t mGlyphCount;
+  };
+
+  struct GlyphRecord
+  {
+    uint32_t mCodepoint;
+    uint32_t mVisible;
+    float mAdvanceX;
+    float mX0, mY0, mX1, mY1;
+    float mU0, mV0, mU1, mV1;
+  };
+
+  class TableWriter
+  {
+  public:
+    template <typename T>
+    void Write(T const& aValue)
+    {
+      auto bytes = reinterpret_cast<unsigned char const*>(&aValue);
+      mData.insert(mData.end(), bytes, bytes + sizeof(T));
+    }
+
+    std::vector<unsigned char> mData;
+  };
+
+  class TableReader
+  {
+  public:
+    TableReader(unsigned char const* aData, size_t aSize)
+      : mData{ aData }
+      , mSize{ aSize }
+    {
+    }
+
+    template <typename T>
+    bool Read(T& aValue)
+    {
+      if (mSize - mOffset < sizeof(T))
+      {
+        return false;
+      }
+
+      memcpy(&aValue, mData + mOffset, sizeof(T));
+      mOffset += sizeof(T);
+      return true;
+    }
+
+    // Hands back where aCount Ts start and steps over them, they're read later.
+    template <typename T>
+    unsigned char const* Skip(int32_t aCount)
+    {
+      if (aCount < 0 || (mSize - mOffset) / sizeof(T) < static_cast<size_t>(aCount))
+      {
+        return nullptr;
+      }
+
+      unsigned char const* start = mData + mOffset;
+      mOffset += sizeof(T) * static_cast<size_t>(aCount);
+      return start;
+    }
+
+  private:
+    unsigned char const* mData;
+    size_t mSize;
+    size_t mOffset = 0;
+  };
+
+  static uint64_t HashFloat(uint64_t aHash, float aValue)
+  {
+    uint32_t bits;
+    memcpy(&bits, &aValue, sizeof(bits));
+    return HashCombine(aHash, bits);
+  }
+
+  FontAtlasCache::FontAtlasCache(std::u8string const& aDirectory)
+    : mDirectory{ aDirectory }
+  {
+    std::error_code error;
+    std::filesystem::create_directories(std::filesystem::path(mDirectory), error);
+  }
+
+  void FontAtlasCache::AddFont(char const* aFile, float aSize, ImFontConfig const* aConfig, ImWchar const* aRanges)
+  {
+    Source source;
+    source.mFile = aFile;
+    source.mConfig = (nullptr != aConfig) ? *aConfig : ImFontConfig{};
+    source.mConfig.SizePixels = aSize;
+    source.mRanges = (nullptr != aRanges) ? aRanges : ImGui::GetIO().Fonts->GetGlyphRangesDefault();
+    mSources.emplace_back(std::move(source));
+  }
+
+  bool FontAtlasCache::MakeKey(unsigned int aFreeTypeFlags, uint64_t& aKey) const
+  {
+    ImFontAtlas* atlas = ImGui::GetIO().Fonts;
+
+    // ImGui's version too, its builder decides where everything goes.
+    uint64_t key = HashCombine(cVersion, IMGUI_VERSION_NUM);
+    key = HashCombine(key, sizeof(ImWchar));
+    key = HashCombine(key, aFreeTypeFlags);
+    key = HashCombine(key, static_cast<uint64_t>(atlas->Flags));
+    key = HashCombine(key, static_cast<uint64_t>(atlas->TexDesiredWidth));
+    key = HashCombine(key, static_cast<uint64_t>(atlas->TexGlyphPadding));
+
+    for (Source const& source : mSources)
+    {
+      auto file = MappedFile::Open(std::u8string(source.mFile.begin(), source.mFile.end()));
+      if (!file)
+      {
+        return false;
+      }
+
+      key = HashCombine(key, Hash64(file->GetData(), file->GetSize()));
+
+      for (ImWchar const* range = source.mRanges; 0 != range[0]; range += 2)
+      {
+        key = HashCombine(key, range[0]);
+        key = HashCombine(key, range[1]);
+      }
+
+      ImFontConfig const& config = source.mConfig;
+      key = HashCombine(key, static_cast<uint64_t>(config.FontNo));
+      key = HashFloat(key, config.SizePixels);
+      key = HashCombine(key, static_cast<uint64_t>(config.OversampleH));
+      key = HashCombine(key, static_cast<uint64_t>(config.OversampleV));
+      key = HashCombine(key, config.PixelSnapH ? 1 : 0);
+      key = HashFloat(key, config.GlyphExtraSpacing.x);
+      key = HashFloat(key, config.GlyphExtraSpacing.y);
+      key = HashFloat(key, config.GlyphOffset.x);
+      key = HashFloat(key, config.GlyphOffset.y);
+      key = HashFloat(key, config.GlyphMinAdvanceX);
+      key = HashFloat(key, config.GlyphMaxAdvanceX);
+      key = HashCombine(key, config.MergeMode ? 1 : 0);
+      key = HashCombine(key, config.RasterizerFlags);
+      key = HashFloat(key, config.RasterizerMultiply);
+      key = HashCombine(key, static_cast<uint64_t>(config.EllipsisChar));
+    }
+
+    aKey = key;
+    return true;
+  }
+
+  std::u8string FontAtlasCache::GetEntryPath(uint64_t aKey) const
+  {
+    char name[32];
+    snprintf(name, sizeof(name), "%016" PRIx64 ".soisfont", aKey);
+    return (std::filesystem::path(mDirectory) / name).u8string();
+  }
+
+  bool FontAtlasCache::Build(unsigned int aFreeTypeFlags, ThreadPool* aPool)
+  {
+    SOIS_PROFILE_SCOPE("FontAtlasCache::Build");
+
+    mLoadedFromCache = false;
+
+    uint64_t key = 0;
+    bool keyed = MakeKey(aFreeTypeFlags, key);
+    if (keyed && Load(key))
+    {
+      mLoadedFromCache = true;
+      return true;
+    }
+
+    ImFontAtlas* atlas = ImGui::GetIO().Fonts;
+    for (Source& source : mSources)
+    {
+      atlas->AddFontFromFileTTF(source.mFile.c_str(), source.mConfig.SizePixels, &source.mConfig, source.mRanges);
+    }
+
+    bool built = (nullptr != aPool) ? BuildFontAtlasParallel(atlas, aFreeTypeFlags, *aPool) : ImGuiFreeType::BuildFontAtlas(atlas, aFreeTypeFlags);
+    if (false == built)
+    {
+      return false;
+    }
+
+    if (keyed)
+    {
+      Store(key);
+    }
+
+    return true;
+  }
+
+  bool FontAtlasCache::Load(uint64_t aKey)
+  {
+    auto file = MappedFile::Open(GetEntryPath(aKey));
+    if (!file || file->GetSize() < cTablesOffset)
+    {
+      return false;
+    }
+
+    EntryHeader header;
+    memcpy(&header, file->GetData(), sizeof(header));
+
+    if (cMagic != header.mMagic ||
+        cVersion != header.mVersion ||
+        aKey != header.mKey ||
+        header.mTablesSize > file->GetSize() - cTablesOffset ||
+        header.mPixelsOffset < cTablesOffset + header.mTablesSize ||
+        header.mPixelsOffset > file->GetSize() ||
+        header.mPixelsSize > file->GetSize() - header.mPixelsOffset)
+    {
+      return false;
+    }
+
+    // Read and check all of it before we touch the atlas, a bad entry just misses.
+    TableReader reader(file->GetData() + cTablesOffset, header.mTablesSize);
+
+    AtlasRecord atlasRecord;
+    if (false == reader.Read(atlasRecord) ||
+        atlasRecord.mTexWidth <= 0 ||
+        atlasRecord.mTexHeight <= 0 ||
+        static_cast<uint64_t>(atlasRecord.mTexWidth) * atlasRecord.mTexHeight != header.mPixelsSize ||
+        atlasRecord.mLineCount < 0 ||
+        atlasRecord.mLineCount > IM_DRAWLIST_TEX_LINES_WIDTH_MAX + 1 ||
+        atlasRecord.mFontCount <= 0 ||
+        atlasRecord.mConfigCount != static_cast<int32_t>(mSources.size()))
+    {
+      return false;
+    }
+
+    auto lines = reader.Skip<ImVec4>(atlasRecord.mLineCount);
+    auto customRects = reader.Skip<CustomRectRecord>(atlasRecord.mCustomRectCount);
+    auto configFonts = reader.Skip<int32_t>(atlasRecord.mConfigCount);
+    if (nullptr == lines || nullptr == customRects || nullptr == configFonts)
+    {
+      return false;
+    }
+
+    std::vector<FontRecord> fontRecords(static_cast<size_t>(atlasRecord.mFontCount));
+    std::vector<unsigned char const*> glyphs(fontRecords.size());
+    for (size_t i = 0; i < fontRecords.size(); ++i)
+    {
+      FontRecord& font = fontRecords[i];
+      if (false == reader.Read(font) ||
+          font.mConfigDataStart < 0 ||
+          font.mConfigDataCount <= 0 ||
+          font.mConfigDataStart + font.mConfigDataCount > atlasRecord.mConfigCount)
+      {
+        return false;
+      }
+
+      glyphs[i] = reader.Skip<GlyphRecord>(font.mGlyphCount);
+      if (nullptr == glyphs[i])
+      {
+        return false;
+      }
+
+      // The lookup tables are sized by the biggest codepoint.
+      for (int32_t g = 0; g < font.mGlyphCount; ++g)
+      {
+        uint32_t codepoint;
+        memcpy(&codepoint, glyphs[i] + sizeof(GlyphRecord) * g + offsetof(GlyphRecord, mCodepoint), sizeof(codepoint));
+        if (codepoint > IM_UNICODE_CODEPOINT_MAX)
+        {
+          return false;
+        }
+      }
+    }
+
+    for (int32_t i = 0; i < atlasRecord.mConfigCount; ++i)
+    {
+      int32_t font;
+      memcpy(&font, configFonts + sizeof(int32_t) * i, sizeof(font));
+      if (font < 0 || font >= atlasRecord.mFontCount)
+      {
+        return false;
+      }
+    }
+
+    // Looks good, rebuild what ImGui's builder would have left behind.
+    ImFontAtlas* atlas = ImGui::GetIO().Fonts;
+
+    for (size_t i = 0; i < fontRecords.size(); ++i)
+    {
+      atlas->Fonts.push_back(IM_NEW(ImFont));
+    }
+
+    // The fonts point into ConfigData, so only take addresses once it's all pushed. There's
+    // no font data behind these, we never read the files.
+    for (int32_t i = 0; i < atlasRecord.mConfigCount; ++i)
+    {
+      int32_t font;
+      memcpy(&font, configFonts + sizeof(int32_t) * i, sizeof(font));
+
+      ImFontConfig config = mSources[i].mConfig;
+      config.FontData = nullptr;
+      config.FontDataSize = 0;
+      config.FontDataOwnedByAtlas = false;
+      config.GlyphRanges = mSources[i].mRanges;
+      config.DstFont = atlas->Fonts[font];
+      if ('\0' == config.Name[0])
+      {
+        snprintf(config.Name, sizeof(config.Name), "%s, %.0fpx", std::filesystem::path(mSources[i].mFile).filename().string().c_str(), config.SizePixels);
+      }
+
+      atlas->ConfigData.push_back(config);
+    }
+
+    for (size_t i = 0; i < fontRecords.size(); ++i)
+    {
+      FontRecord const& record = fontRecords[i];
+      ImFont* font = atlas->Fonts[static_cast<int>(i)];
+
+      font->ContainerAtlas = atlas;
+      font->ConfigData = &atlas->ConfigData[record.mConfigDataStart];
+      font->ConfigDataCount = static_cast<short>(record.mConfigDataCount);
+      font->FontSize = record.mFontSize;
+      font->Ascent = record.mAscent;
+      font->Descent = record.mDescent;
+      font->MetricsTotalSurface = record.mMetricsTotalSurface;
+
+      font->Glyphs.resize(record.mGlyphCount);
+      for (int32_t g = 0; g < record.mGlyphCount; ++g)
+      {
+        GlyphRecord glyphRecord;
+        memcpy(&glyphRecord, glyphs[i] + sizeof(GlyphRecord) * g, sizeof(glyphRecord));
+
+        ImFontGlyph& glyph = font->Glyphs[g];
+        memset(&glyph, 0, sizeof(glyph));
+        glyph.Codepoint = glyphRecord.mCodepoint;
+        glyph.Visible = (0 != glyphRecord.mVisible) ? 1 : 0;
+        glyph.AdvanceX = glyphRecord.mAdvanceX;
+        glyph.X0 = glyphRecord.mX0;
+        glyph.Y0 = glyphRecord.mY0;
+        glyph.X1 = glyphRecord.mX1;
+        glyph.Y1 = glyphRecord.mY1;
+        glyph.U0 = glyphRecord.mU0;
+        glyph.V0 = glyphRecord.mV0;
+        glyph.U1 = glyphRecord.mU1;
+        glyph.V1 = glyphRecord.mV1;
+      }
+
+      font->FallbackChar = static_cast<ImWchar>(record.mFallbackChar);
+      font->EllipsisChar = static_cast<ImWchar>(record.mEllipsisChar);
+      font->BuildLookupTable();
+
+      // In case the lookup table build picked its own.
+      font->FallbackChar = static_cast<ImWchar>(record.mFallbackChar);
+      font->EllipsisChar = static_cast<ImWchar>(record.mEllipsisChar);
+    }
+
+    for (int32_t i = 0; i < atlasRecord.mCustomRectCount; ++i)
+    {
+      CustomRectRecord record;
+      memcpy(&record, customRects + sizeof(CustomRectRecord) * i, sizeof(record));
+
+      ImFontAtlasCustomRect rect;
+      rect.Width = record.mWidth;
+      rect.Height = record.mHeight;
+      rect.X = record.mX;
+      rect.Y = record.mY;
+      rect.GlyphID = record.mGlyphId;
+      rect.GlyphAdvanceX = record.mGlyphAdvanceX;
+      rect.GlyphOffset = ImVec2(record.mGlyphOffset[0], record.mGlyphOffset[1]);
+      rect.Font = (record.mFont >= 0 && record.mFont < atlas->Fonts.Size) ? atlas->Fonts[record.mFont] : nullptr;
+      atlas->CustomRects.push_back(rect);
+    }
+
+    memcpy(atlas->TexUvLines, lines, sizeof(ImVec4) * atlasRecord.mLineCount);
+    atlas->PackIdMouseCursors = atlasRecord.mPackIdMouseCursors;
+    atlas->PackIdLines = atlasRecord.mPackIdLines;
+    atlas->TexWidth = atlasRecord.mTexWidth;
+    atlas->TexHeight = atlasRecord.mTexHeight;
+    atlas->TexUvScale = ImVec2(atlasRecord.mTexUvScale[0], atlasRecord.mTexUvScale[1]);
+    atlas->TexUvWhitePixel = ImVec2(atlasRecord.mTexUvWhitePixel[0], atlasRecord.mTexUvWhitePixel[1]);
+
+    // The one copy we make, the atlas owns and frees its pixels.
+    atlas->TexPixelsAlpha8 = static_cast<unsigned char*>(IM_ALLOC(header.mPixelsSize));
+    memcpy(atlas->TexPixelsAlpha8, file->GetData() + header.mPixelsOffset, header.mPixelsSize);
+    return true;
+  }
+
+  void FontAtlasCache::Store(uint64_t aKey) const
+  {
+    ImFontAtlas* atlas = ImGui::GetIO().Fonts;
+    if (nullptr == atlas->TexPixelsAlpha8 || atlas->ConfigData.Size != static_cast<int>(mSources.size()))
+    {
+      return;
+    }
+
+    auto getFontIndex = [atlas](ImFont const* aFont)
+    {
+      for (int i = 0; i < atlas->Fonts.Size; ++i)
+      {
+        if (aFont == atlas->Fonts[i])
+        {
+          return static_cast<int32_t>(i);
+        }
+      }
+
+      return static_cast<int32_t>(-1);
+    };
+
+    TableWriter tables;
+
+    AtlasRecord atlasRecord;
+    atlasRecord.mTexWidth = atlas->TexWidth;
+    atlasRecord.mTexHeight = atlas->TexHeight;
+    atlasRecord.mTexUvScale[0] = atlas->TexUvScale.x;
+    atlasRecord.mTexUvScale[1] = atlas->TexUvScale.y;
+    atlasRecord.mTexUvWhitePixel[0] = atlas->TexUvWhitePixel.x;
+    atlasRecord.mTexUvWhitePixel[1] = atlas->TexUvWhitePixel.y;
+    atlasRecord.mLineCount = IM_DRAWLIST_TEX_LINES_WIDTH_MAX + 1;
+    atlasRecord.mCustomRectCount = atlas->CustomRects.Size;
+    atlasRecord.mPackIdMouseCursors = atlas->PackIdMouseCursors;
+    atlasRecord.mPackIdLines = atlas->PackIdLines;
+    atlasRecord.mFontCount = atlas->Fonts.Size;
+    atlasRecord.mConfigCount = atlas->ConfigData.Size;
+    tables.Write(atlasRecord);
+
+    for (int i = 0; i < atlasRecord.mLineCount; ++i)
+    {
+      tables.Write(atlas->TexUvLines[i]);
+    }
+
+    for (ImFontAtlasCustomRect const& rect : atlas->CustomRects)
+    {
+      CustomRectRecord record;
+      record.mWidth = rect.Width;
+      record.mHeight = rect.Height;
+      record.mX = rect.X;
+      record.mY = rect.Y;
+      record.mGlyphId = rect.GlyphID;
+      record.mGlyphAdvanceX = rect.GlyphAdvanceX;
+      record.mGlyphOffset[0] = rect.GlyphOffset.x;
+      record.mGlyphOffset[1] = rect.GlyphOffset.y;
+      record.mFont = getFontIndex(rect.Font);
+      tables.Write(record);
+    }
+
+    for (ImFontConfig const& config : atlas->ConfigData)
+    {
+      int32_t font = getFontIndex(config.DstFont);
+      if (font < 0)
+      {
+        return;
+      }
+
+      tables.Write(font);
+    }
+
+    for (ImFont const* font : atlas->Fonts)
+    {
+      FontRecord record;
+      record.mFontSize = font->FontSize;
+      record.mAscent = font->Ascent;
+      record.mDescent = font->Descent;
+      record.mFallbackChar = font->FallbackChar;
+      record.mEllipsisChar = font->EllipsisChar;
+      record.mConfigDataStart = static_cast<int32_t>(font->ConfigData - atlas->ConfigData.Data);
+      record.mConfigDataCount = font->ConfigDataCount;
+      record.mMetricsTotalSurface = font->MetricsTotalSurface;
+      record.mGlyphCount = font->Glyphs.Size;
+      tables.Write(record);
+
+      for (ImFontGlyph const& glyph : font->Glyphs)
+      {
+        GlyphRecord glyphRecord;
+        glyphRecord.mCodepoint = glyph.Codepoint;
+        glyphRecord.mVisible = glyph.Visible;
+        glyphRecord.mAdvanceX = glyph.AdvanceX;
+        glyphRecord.mX0 = glyph.X0;
+        glyphRecord.mY0 = glyph.Y0;
+        glyphRecord.mX1 = glyph.X1;
+        glyphRecord.mY1 = glyph.Y1;
+        glyphRecord.mU0 = glyph.U0;
+        glyphRecord.mV0 = glyph.V0;
+        glyphRecord.mU1 = glyph.U1;
+        glyphRecord.mV1 = glyph.V1;
+        tables.Write(glyphRecord);
+      }
+    }
+
+    EntryHeader header;
+    header.mMagic = cMagic;
+    header.mVersion = cVersion;
+    header.mKey = aKey;
+    header.mTablesSize = tables.mData.size();
+    header.mPixelsOffset = (cTablesOffset + header.mTablesSize + cPixelsAlignment - 1) / cPixelsAlignment * cPixelsAlignment;
+    header.mPixelsSize = static_cast<uint64_t>(atlas->TexWidth) * atlas->TexHeight;
+
+    // Header, tables and padding go out as one block, and the pixels straight from the atlas.
+    std::vector<unsigned char> prefix(header.mPixelsOffset, 0);
+    memcpy(prefix.data(), &header, sizeof(header));
+    memcpy(prefix.data() + cTablesOffset, tables.mData.data(), tables.mData.size());
+
+    WriteFileAtomic(GetEntryPath(aKey), prefix.data(), prefix.size(), atlas->TexPixelsAlpha8, header.mPixelsSize);
+  }
+}
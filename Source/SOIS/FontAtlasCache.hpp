@@ -0,0 +1,57 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "imgui.h"
+
+namespace SOIS
+{
+  class ThreadPool;
+
+  // Builds ImGui's font atlas, or restores it from disk when the same fonts were built
+  // before. Entries are keyed by a hash of each font file's bytes, and the sizes, ranges,
+  // config and FreeType flags used, so any change just misses and rebuilds. An entry
+  // holds the baked alpha texture and every font's glyph table. It's mapped on load,
+  // and the only real work is one copy of the texture.
+  //
+  // Atlases restored from the cache have no font data attached, so they can't be
+  // rebuilt. Clear and add the fonts again if you need to.
+  class FontAtlasCache
+  {
+  public:
+    FontAtlasCache(std::u8string const& aDirectory);
+
+    // Like ImFontAtlas::AddFontFromFileTTF. aRanges has to outlive the Build call.
+    void AddFont(char const* aFile, float aSize, ImFontConfig const* aConfig = nullptr, ImWchar const* aRanges = nullptr);
+
+    // aFreeTypeFlags are ImGuiFreeType::RasterizerFlags. On a miss the atlas is built
+    // over aPool with BuildFontAtlasParallel if there is one. Returns false if the fonts
+    // couldn't be built.
+    bool Build(unsigned int aFreeTypeFlags = 0, ThreadPool* aPool = nullptr);
+
+    bool WasLoadedFromCache() const
+    {
+      return mLoadedFromCache;
+    }
+
+  private:
+    struct Source
+    {
+      std::string mFile;
+      ImFontConfig mConfig;
+      ImWchar const* mRanges;
+    };
+
+    // False if a font file couldn't be read, there's nothing to key on then.
+    bool MakeKey(unsigned int aFreeTypeFlags, uint64_t& aKey) const;
+    std::u8string GetEntryPath(uint64_t aKey) const;
+    bool Load(uint64_t aKey);
+    void Store(uint64_t aKey) const;
+
+    std::u8string mDirectory;
+    std::vector<Source> mSources;
+    bool mLoadedFromCache = false;
+  };
+}
@@ -0,0 +1,657 @@
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstring>
+#include <string>
+#include <unordered_set>
+
+#include <ft2build.h>
+#include FT_FREETYPE_H
+#include FT_SYNTHESIS_H
+
+#include <stb_rect_pack.h>
+
+#include "imgui.h"
+#include "imgui_freetype.h"
+
+#include "SOIS/File.hpp"
+#include "SOIS/GlyphCache.hpp"
+#include "SOIS/Profiler.hpp"
+#include "SOIS/Renderer.hpp"
+
+namespace SOIS
+{
+  // Placeholder UVs start here, real ones are always within [0, 1]. U holds the
+  // codepoint and V the source, both exact in a float.
+  static constexpr float cPlaceholderUv = 1024.f;
+
+  // Between glyphs, so filtering never picks up a neighbour.
+  static constexpr int cGlyphPadding = 1;
+
+  // Room for lazily rasterized glyphs in the first texture, before we need to grow.
+  static constexpr int cInitialFreeHeight = 256;
+
+  // Codepoints ImGui bakes eagerly, the rest come in lazily.
+  static constexpr ImWchar cBasicLatinFirst = 0x20;
+  static constexpr ImWchar cBasicLatinLast = 0x7E;
+
+  static int FreeTypeCeil(FT_Pos aValue)
+  {
+    return static_cast<int>((aValue + 63) >> 6);
+  }
+
+  struct GlyphCache::Source
+  {
+    ~Source()
+    {
+      if (nullptr != mFace)
+      {
+        FT_Done_Face(mFace);
+      }
+    }
+
+    std::string mFile;
+    ImFontConfig mConfig;
+    ImWchar const* mRanges = nullptr;
+
+    // What ImGui bakes, zero terminated pairs like any other ranges.
+    std::vector<ImWchar> mBaseRanges;
+
+    ImFont* mFont = nullptr;
+    MappedFile mData;
+    FT_Face mFace = nullptr;
+    FT_Int32 mLoadFlags = 0;
+    FT_Render_Mode mRenderMode = FT_RENDER_MODE_NORMAL;
+    unsigned int mFlags = 0;
+    std::array<unsigned char, 256> mMultiply;
+  };
+
+  // A horizontal slice of the atlas with its own packer. Every time the atlas grows
+  // the new space becomes another band, so glyphs already placed never move.
+  struct GlyphCache::Band
+  {
+    Band(int aWidth, int aY, int aHeight)
+      : mNodes(aWidth)
+      , mY{ aY }
+    {
+      stbrp_init_target(&mPacker, aWidth, aHeight, mNodes.data(), static_cast<int>(mNodes.size()));
+    }
+
+    stbrp_context mPacker;
+    std::vector<stbrp_node> mNodes;
+    int mY;
+  };
+
+  GlyphCache::GlyphCache(Renderer* aRenderer, unsigned int aFreeTypeFlags, int aWidth, int aMaxHeight)
+    : mRenderer{ aRenderer }
+    , mFreeTypeFlags{ aFreeTypeFlags }
+    , mWidth{ aWidth }
+    , mMaxHeight{ aMaxHeight }
+  {
+    FT_Library library;
+    if (0 == FT_Init_FreeType(&library))
+    {
+      mLibrary = library;
+    }
+  }
+
+  GlyphCache::~GlyphCache()
+  {
+    // Faces first, they belong to the library.
+    mSources.clear();
+
+    if (nullptr != mLibrary)
+    {
+      FT_Done_FreeType(mLibrary);
+    }
+  }
+
+  ImFont* GlyphCache::AddFont(char const* aFile, float aSize, ImFontConfig const* aConfig, ImWchar const* aRanges)
+  {
+    ImFontAtlas* atlas = ImGui::GetIO().Fonts;
+
+    auto source = std::make_unique<Source>();
+    source->mFile = aFile;
+    source->mConfig = (nullptr != aConfig) ? *aConfig : ImFontConfig{};
+    source->mConfig.SizePixels = aSize;
+    source->mRanges = (nullptr != aRanges) ? aRanges : atlas->GetGlyphRangesDefault();
+
+    for (ImWchar const* range = source->mRanges; 0 != range[0]; range += 2)
+    {
+      ImWchar first = std::max(range[0], cBasicLatinFirst);
+      ImWchar last = std::min(range[1], cBasicLatinLast);
+      if (first <= last)
+      {
+        source->mBaseRanges.insert(source->mBaseRanges.end(), { first, last });
+      }
+    }
+
+    // A new font needs something baked for ImGui to build it, merged ones can be
+    // entirely lazy.
+    if (source->mBaseRanges.empty() && false == source->mConfig.MergeMode)
+    {
+      source->mBaseRanges.insert(source->mBaseRanges.end(), { cBasicLatinFirst, cBasicLatinFirst });
+    }
+
+    if (false == source->mBaseRanges.empty())
+    {
+      source->mBaseRanges.emplace_back(0);
+      source->mFont = atlas->AddFontFromFileTTF(aFile, aSize, &source->mConfig, source->mBaseRanges.data());
+    }
+    else if (false == atlas->Fonts.empty())
+    {
+      source->mFont = atlas->Fonts.back();
+    }
+
+    if (nullptr == source->mFont)
+    {
+      return nullptr;
+    }
+
+    ImFont* font = source->mFont;
+    mSources.emplace_back(std::move(source));
+    return font;
+  }
+
+  bool GlyphCache::Build()
+  {
+    SOIS_PROFILE_SCOPE("GlyphCache::Build");
+
+    ImFontAtlas* atlas = ImGui::GetIO().Fonts;
+    if (false == ImGuiFreeType::BuildFontAtlas(atlas, mFreeTypeFlags))
+    {
+      return false;
+    }
+
+    if (nullptr == mLibrary)
+    {
+      return true;
+    }
+
+    // Merged fonts only get codepoints the fonts before them didn't have, like ImGui.
+    std::vector<std::unordered_set<uint32_t>> added(static_cast<size_t>(atlas->Fonts.Size));
+    std::vector<bool> touched(static_cast<size_t>(atlas->Fonts.Size), false);
+
+    for (size_t i = 0; i < mSources.size(); ++i)
+    {
+      Source& source = *mSources[i];
+
+      auto data = MappedFile::Open(std::u8string(source.mFile.begin(), source.mFile.end()));
+      if (!data)
+      {
+        continue;
+      }
+
+      source.mData = std::move(*data);
+
+      FT_Face face;
+      if (0 != FT_New_Memory_Face(mLibrary, source.mData.GetData(), static_cast<FT_Long>(source.mData.GetSize()), source.mConfig.FontNo, &face))
+      {
+        continue;
+      }
+
+      source.mFace = face;
+      FT_Select_Charmap(face, FT_ENCODING_UNICODE);
+
+      // Same sizing and flags as ImGui's FreeType builder, so lazy glyphs match the
+      // baked ones.
+      FT_Size_RequestRec request;
+      request.type = FT_SIZE_REQUEST_TYPE_REAL_DIM;
+      request.width = 0;
+      request.height = static_cast<uint32_t>(source.mConfig.SizePixels) * 64;
+      request.horiResolution = 0;
+      request.vertResolution = 0;
+      FT_Request_Size(face, &request);
+
+      source.mFlags = mFreeTypeFlags | source.mConfig.RasterizerFlags;
+      source.mLoadFlags = FT_LOAD_NO_BITMAP;
+      if (source.mFlags & ImGuiFreeType::NoHinting)
+      {
+        source.mLoadFlags |= FT_LOAD_NO_HINTING;
+      }
+      if (source.mFlags & ImGuiFreeType::NoAutoHint)
+      {
+        source.mLoadFlags |= FT_LOAD_NO_AUTOHINT;
+      }
+      if (source.mFlags & ImGuiFreeType::ForceAutoHint)
+      {
+        source.mLoadFlags |= FT_LOAD_FORCE_AUTOHINT;
+      }
+
+      if (source.mFlags & ImGuiFreeType::LightHinting)
+      {
+        source.mLoadFlags |= FT_LOAD_TARGET_LIGHT;
+      }
+      else if (source.mFlags & ImGuiFreeType::MonoHinting)
+      {
+        source.mLoadFlags |= FT_LOAD_TARGET_MONO;
+      }
+      else
+      {
+        source.mLoadFlags |= FT_LOAD_TARGET_NORMAL;
+      }
+
+      source.mRenderMode = (source.mFlags & ImGuiFreeType::Monochrome) ? FT_RENDER_MODE_MONO : FT_RENDER_MODE_NORMAL;
+
+      for (size_t value = 0; value < source.mMultiply.size(); ++value)
+      {
+        source.mMultiply[value] = static_cast<unsigned char>(std::min(255.f, value * source.mConfig.RasterizerMultiply));
+      }
+
+      // Walking the font's character map is much cheaper than probing every codepoint
+      // in ranges as big as the ones for CJK.
+      std::vector<uint32_t> codepoints;
+      FT_UInt glyphIndex;
+      for (FT_ULong code = FT_Get_First_Char(face, &glyphIndex); 0 != glyphIndex; code = FT_Get_Next_Char(face, code, &glyphIndex))
+      {
+        if (code <= IM_UNICODE_CODEPOINT_MAX)
+        {
+          codepoints.emplace_back(static_cast<uint32_t>(code));
+        }
+      }
+
+      std::sort(codepoints.begin(), codepoints.end());
+
+      size_t fontIndex = std::find(atlas->Fonts.begin(), atlas->Fonts.end(), source.mFont) - atlas->Fonts.begin();
+      ImFont* font = source.mFont;
+
+      // Not worth rasterizing just for an advance, it's only used until the real glyph
+      // arrives. An em is right for CJK and close enough for most symbols.
+      float advance = static_cast<float>(face->size->metrics.x_ppem);
+
+      for (ImWchar const* range = source.mRanges; 0 != range[0]; range += 2)
+      {
+        auto it = std::lower_bound(codepoints.begin(), codepoints.end(), static_cast<uint32_t>(range[0]));
+        for (; codepoints.end() != it && *it <= range[1]; ++it)
+        {
+          uint32_t codepoint = *it;
+          if (nullptr != font->FindGlyphNoFallback(static_cast<ImWchar>(codepoint)) || false == added[fontIndex].insert(codepoint).second)
+          {
+            continue;
+          }
+
+          float u = cPlaceholderUv + codepoint;
+          float v = cPlaceholderUv + i;
+          font->AddGlyph(&source.mConfig, static_cast<ImWchar>(codepoint), 0.f, 0.f, 1.f, 1.f, u, v, u, v, advance);
+          touched[fontIndex] = true;
+        }
+      }
+    }
+
+    for (size_t i = 0; i < static_cast<size_t>(atlas->Fonts.Size); ++i)
+    {
+      if (touched[i])
+      {
+        atlas->Fonts[i]->BuildLookupTable();
+      }
+    }
+
+    return true;
+  }
+
+  void GlyphCache::NewFrame()
+  {
+    ImFontAtlas* atlas = ImGui::GetIO().Fonts;
+
+    for (auto& retired : mRetiredTextures)
+    {
+      --retired.second;
+    }
+
+    mRetiredTextures.erase(std::remove_if(mRetiredTextures.begin(), mRetiredTextures.end(), [](auto& aRetired)
+    {
+      return aRetired.second <= 0;
+    }), mRetiredTextures.end());
+
+    if (nullptr != mTexture)
+    {
+      // Backends recreating their device objects point the atlas back at their copy.
+      if (atlas->TexID != mTexture->GetTextureId())
+      {
+        atlas->SetTexID(mTexture->GetTextureId());
+      }
+
+      return;
+    }
+
+    // The backend made its own texture from the baked atlas in Renderer::NewFrame, we
+    // take over from here with one that has room to grow.
+    unsigned char* pixels;
+    int width;
+    int height;
+    atlas->GetTexDataAsRGBA32(&pixels, &width, &height);
+
+    int newWidth = std::max(width, mWidth);
+    int newHeight = 64;
+    while (newHeight < (height + cInitialFreeHeight) && newHeight < mMaxHeight)
+    {
+      newHeight *= 2;
+    }
+
+    newHeight = std::max(newHeight, height);
+
+    // The atlas owns and frees these, and keeping the RGBA copy around keeps it looking
+    // built to ImGui.
+    size_t pitch = static_cast<size_t>(newWidth) * 4;
+    unsigned char* resized = static_cast<unsigned char*>(IM_ALLOC(pitch * newHeight));
+    memset(resized, 0, pitch * newHeight);
+    for (int y = 0; y < height; ++y)
+    {
+      memcpy(resized + y * pitch, pixels + static_cast<size_t>(y) * width * 4, static_cast<size_t>(width) * 4);
+    }
+
+    IM_FREE(atlas->TexPixelsRGBA32);
+    IM_FREE(atlas->TexPixelsAlpha8);
+    atlas->TexPixelsRGBA32 = reinterpret_cast<unsigned int*>(resized);
+    atlas->TexPixelsAlpha8 = nullptr;
+
+    RescaleUvs(static_cast<float>(width) / newWidth, static_cast<float>(height) / newHeight);
+    atlas->TexWidth = newWidth;
+    atlas->TexHeight = newHeight;
+    atlas->TexUvScale = ImVec2(1.f / newWidth, 1.f / newHeight);
+
+    if (height + cGlyphPadding < newHeight)
+    {
+      mBands.emplace_back(std::make_unique<Band>(newWidth, height + cGlyphPadding, newHeight - height - cGlyphPadding));
+    }
+
+    UploadTexture();
+  }
+
+  void GlyphCache::RescaleUvs(float aScaleU, float aScaleV)
+  {
+    ImFontAtlas* atlas = ImGui::GetIO().Fonts;
+
+    for (ImFont* font : atlas->Fonts)
+    {
+      for (ImFontGlyph& glyph : font->Glyphs)
+      {
+        if (glyph.U0 >= cPlaceholderUv)
+        {
+          continue;
+        }
+
+        glyph.U0 *= aScaleU;
+        glyph.U1 *= aScaleU;
+        glyph.V0 *= aScaleV;
+        glyph.V1 *= aScaleV;
+      }
+    }
+
+    atlas->TexUvWhitePixel.x *= aScaleU;
+    atlas->TexUvWhitePixel.y *= aScaleV;
+
+    for (ImVec4& line : atlas->TexUvLines)
+    {
+      line.x *= aScaleU;
+      line.y *= aScaleV;
+      line.z *= aScaleU;
+      line.w *= aScaleV;
+    }
+  }
+
+  void GlyphCache::UploadTexture()
+  {
+    ImFontAtlas* atlas = ImGui::GetIO().Fonts;
+
+    // Draw data from this frame (and maybe the render thread's last one) still
+    // references the old texture, with UVs for its size.
+    if (nullptr != mTexture)
+    {
+      mRetiredTextures.emplace_back(std::move(mTexture), 2);
+    }
+
+    mTexture = mRenderer->LoadTextureFromData(reinterpret_cast<unsigned char*>(atlas->TexPixelsRGBA32), TextureLayout::RGBA_Unorm, atlas->TexWidth, atlas->TexHeight, atlas->TexWidth * 4);
+    if (nullptr != mTexture)
+    {
+      atlas->SetTexID(mTexture->GetTextureId());
+    }
+
+    mTextureResized = false;
+    mDirtyX1 = mDirtyX0;
+  }
+
+  bool GlyphCache::Grow()
+  {
+    ImFontAtlas* atlas = ImGui::GetIO().Fonts;
+    int oldHeight = atlas->TexHeight;
+    if (oldHeight >= mMaxHeight)
+    {
+      return false;
+    }
+
+    int newHeight = std::min(oldHeight * 2, mMaxHeight);
+    size_t pitch = static_cast<size_t>(atlas->TexWidth) * 4;
+    unsigned char* resized = static_cast<unsigned char*>(IM_ALLOC(pitch * newHeight));
+    memcpy(resized, atlas->TexPixelsRGBA32, pitch * oldHeight);
+    memset(resized + pitch * oldHeight, 0, pitch * (newHeight - oldHeight));
+
+    IM_FREE(atlas->TexPixelsRGBA32);
+    atlas->TexPixelsRGBA32 = reinterpret_cast<unsigned int*>(resized);
+
+    RescaleUvs(1.f, static_cast<float>(oldHeight) / newHeight);
+    atlas->TexHeight = newHeight;
+    atlas->TexUvScale = ImVec2(1.f / atlas->TexWidth, 1.f / newHeight);
+
+    mBands.emplace_back(std::make_unique<Band>(atlas->TexWidth, oldHeight, newHeight - oldHeight));
+    mTextureResized = true;
+    return true;
+  }
+
+  bool GlyphCache::Allocate(int aWidth, int aHeight, int& aX, int& aY)
+  {
+    stbrp_rect rect{};
+    rect.w = static_cast<stbrp_coord>(aWidth + cGlyphPadding);
+    rect.h = static_cast<stbrp_coord>(aHeight + cGlyphPadding);
+
+    do
+    {
+      for (auto& band : mBands)
+      {
+        if (stbrp_pack_rects(&band->mPacker, &rect, 1))
+        {
+          aX = rect.x;
+          aY = band->mY + rect.y;
+          return true;
+        }
+      }
+    } while (Grow());
+
+    return false;
+  }
+
+  bool GlyphCache::Rasterize(Source& aSource, uint32_t aCodepoint)
+  {
+    ImFont* font = aSource.mFont;
+    ImFontAtlas* atlas = ImGui::GetIO().Fonts;
+
+    ImFontGlyph const* placeholder = font->FindGlyphNoFallback(static_cast<ImWchar>(aCodepoint));
+    if (nullptr == placeholder || placeholder->U0 < cPlaceholderUv)
+    {
+      return false;
+    }
+
+    int index = static_cast<int>(placeholder - font->Glyphs.Data);
+
+    // Whatever goes wrong, don't leave the placeholder drawing (and coming back to us)
+    // every frame.
+    auto hide = [&]()
+    {
+      font->Glyphs[index].Visible = 0;
+      return false;
+    };
+
+    FT_Face face = aSource.mFace;
+    FT_UInt glyphIndex = FT_Get_Char_Index(face, aCodepoint);
+    if (0 == glyphIndex || 0 != FT_Load_Glyph(face, glyphIndex, aSource.mLoadFlags))
+    {
+      return hide();
+    }
+
+    FT_GlyphSlot slot = face->glyph;
+    if (aSource.mFlags & ImGuiFreeType::Bold)
+    {
+      FT_GlyphSlot_Embolden(slot);
+    }
+
+    if (aSource.mFlags & ImGuiFreeType::Oblique)
+    {
+      FT_GlyphSlot_Oblique(slot);
+    }
+
+    if (0 != FT_Render_Glyph(slot, aSource.mRenderMode))
+    {
+      return hide();
+    }
+
+    FT_Bitmap const& bitmap = slot->bitmap;
+    int width = static_cast<int>(bitmap.width);
+    int height = static_cast<int>(bitmap.rows);
+    int x = 0;
+    int y = 0;
+
+    if (width > 0 && height > 0)
+    {
+      if (false == Allocate(width, height, x, y))
+      {
+        return hide();
+      }
+
+      unsigned int* pixels = atlas->TexPixelsRGBA32;
+      for (int row = 0; row < height; ++row)
+      {
+        unsigned char const* source = bitmap.buffer + row * bitmap.pitch;
+        unsigned int* destination = pixels + static_cast<size_t>(y + row) * atlas->TexWidth + x;
+
+        for (int column = 0; column < width; ++column)
+        {
+          unsigned char alpha;
+          if (FT_PIXEL_MODE_MONO == bitmap.pixel_mode)
+          {
+            alpha = (source[column >> 3] & (0x80 >> (column & 7))) ? 255 : 0;
+          }
+          else
+          {
+            alpha = source[column];
+          }
+
+          destination[column] = IM_COL32(255, 255, 255, aSource.mMultiply[alpha]);
+        }
+      }
+
+      if (mDirtyX1 <= mDirtyX0)
+      {
+        mDirtyX0 = x;
+        mDirtyY0 = y;
+        mDirtyX1 = x + width;
+        mDirtyY1 = y + height;
+      }
+      else
+      {
+        mDirtyX0 = std::min(mDirtyX0, x);
+        mDirtyY0 = std::min(mDirtyY0, y);
+        mDirtyX1 = std::max(mDirtyX1, x + width);
+        mDirtyY1 = std::max(mDirtyY1, y + height);
+      }
+    }
+
+    // Positioned the way ImGui's FreeType builder does it.
+    float x0 = slot->bitmap_left + aSource.mConfig.GlyphOffset.x;
+    float y0 = -slot->bitmap_top + aSource.mConfig.GlyphOffset.y + std::floor(font->Ascent + 0.5f);
+    float advance = static_cast<float>(FreeTypeCeil(slot->advance.x));
+
+    // Have ImGui apply the config (snapping, spacing, min advance) with AddGlyph, then
+    // put the result where the placeholder was so the lookup tables stay valid. The
+    // push can move Glyphs, and FallbackGlyph points into it.
+    ptrdiff_t fallback = (nullptr != font->FallbackGlyph) ? (font->FallbackGlyph - font->Glyphs.Data) : -1;
+
+    font->AddGlyph(&aSource.mConfig, static_cast<ImWchar>(aCodepoint),
+      x0, y0, x0 + width, y0 + height,
+      x * atlas->TexUvScale.x, y * atlas->TexUvScale.y, (x + width) * atlas->TexUvScale.x, (y + height) * atlas->TexUvScale.y,
+      advance);
+
+    font->Glyphs[index] = font->Glyphs.back();
+    font->Glyphs.pop_back();
+
+    if (fallback >= 0)
+    {
+      font->FallbackGlyph = &font->Glyphs[static_cast<int>(fallback)];
+    }
+
+    if (static_cast<int>(aCodepoint) < font->IndexAdvanceX.Size)
+    {
+      font->IndexAdvanceX[aCodepoint] = font->Glyphs[index].AdvanceX;
+    }
+
+    ++mRasterizedGlyphs;
+    return true;
+  }
+
+  bool GlyphCache::ResolveMissingGlyphs(ImDrawData* aDrawData)
+  {
+    if (nullptr == mTexture || nullptr == aDrawData || false == aDrawData->Valid)
+    {
+      return false;
+    }
+
+    // Each placeholder is a quad with the same UV on all four corners.
+    std::vector<uint64_t> missing;
+    for (int n = 0; n < aDrawData->CmdListsCount; ++n)
+    {
+      ImDrawList* list = aDrawData->CmdLists[n];
+      for (ImDrawVert& vertex : list->VtxBuffer)
+      {
+        if (vertex.uv.x >= cPlaceholderUv)
+        {
+          uint64_t source = static_cast<uint64_t>(vertex.uv.y - cPlaceholderUv);
+          uint64_t codepoint = static_cast<uint64_t>(vertex.uv.x - cPlaceholderUv);
+          missing.emplace_back((source << 32) | codepoint);
+
+          // Nothing to show until the glyph exists.
+          vertex.col = 0;
+        }
+      }
+    }
+
+    if (missing.empty())
+    {
+      return false;
+    }
+
+    SOIS_PROFILE_SCOPE("GlyphCache::ResolveMissingGlyphs");
+
+    std::sort(missing.begin(), missing.end());
+    missing.erase(std::unique(missing.begin(), missing.end()), missing.end());
+
+    bool added = false;
+    for (uint64_t glyph : missing)
+    {
+      size_t source = static_cast<size_t>(glyph >> 32);
+      if (source < mSources.size() && nullptr != mSources[source]->mFace)
+      {
+        added = Rasterize(*mSources[source], static_cast<uint32_t>(glyph & 0xFFFFFFFF)) || added;
+      }
+    }
+
+    ImFontAtlas* atlas = ImGui::GetIO().Fonts;
+    if (mTextureResized)
+    {
+      UploadTexture();
+    }
+    else if (mDirtyX1 > mDirtyX0)
+    {
+      TextureRegion region;
+      region.X = mDirtyX0;
+      region.Y = mDirtyY0;
+      region.Width = mDirtyX1 - mDirtyX0;
+      region.Height = mDirtyY1 - mDirtyY0;
+
+      unsigned char* pixels = reinterpret_cast<unsigned char*>(atlas->TexPixelsRGBA32);
+      size_t pitch = static_cast<size_t>(atlas->TexWidth) * 4;
+      mRenderer->UpdateTexture(mTexture.get(), region, pixels + mDirtyY0 * pitch + mDirtyX0 * 4, static_cast<int>(pitch));
+      mDirtyX1 = mDirtyX0;
+    }
+
+    return added;
+  }
+}
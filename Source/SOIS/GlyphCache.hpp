@@ -0,0 +1,91 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "imgui.h"
+
+struct FT_LibraryRec_;
+
+namespace SOIS
+{
+  class Renderer;
+  class Texture;
+
+  // Font atlas that rasterizes glyphs the first time they're drawn, instead of baking
+  // every glyph in every range up front. Only Basic Latin goes through ImGui's normal
+  // FreeType build, everything else the fonts have in their ranges gets a placeholder
+  // glyph whose UVs name the glyph instead of pointing into the atlas. Once a frame,
+  // ResolveMissingGlyphs looks for those in the draw data, hides them, rasterizes the
+  // real glyphs with FreeType, packs them into free space with stb_rect_pack, and
+  // uploads just the area that changed. They show up the frame after they're first
+  // drawn.
+  //
+  // The atlas texture starts just big enough for what's baked plus some room, and
+  // doubles in height as glyphs come in, up to aMaxHeight. Glyphs that don't fit after
+  // that are left blank.
+  class GlyphCache
+  {
+  public:
+    // aFreeTypeFlags are ImGuiFreeType::RasterizerFlags, like for BuildFontAtlas.
+    GlyphCache(Renderer* aRenderer, unsigned int aFreeTypeFlags = 0, int aWidth = 1024, int aMaxHeight = 4096);
+    ~GlyphCache();
+
+    GlyphCache(GlyphCache const&) = delete;
+    GlyphCache& operator=(GlyphCache const&) = delete;
+
+    // Like ImFontAtlas::AddFontFromFileTTF, into ImGui's atlas. aRanges has to outlive
+    // the cache (ImGui's GetGlyphRanges* and static arrays do). Call before Build.
+    ImFont* AddFont(char const* aFile, float aSize, ImFontConfig const* aConfig = nullptr, ImWchar const* aRanges = nullptr);
+
+    // Bakes the eager part of the atlas and adds the placeholders. Returns false if
+    // ImGui's build failed.
+    bool Build();
+
+    // After Renderer::NewFrame, the first one moves the atlas into a texture we own.
+    void NewFrame();
+
+    // After ImGui::Render, before the draw data is rendered. Returns true if glyphs
+    // were added, they'll appear next frame so one should be drawn.
+    bool ResolveMissingGlyphs(ImDrawData* aDrawData);
+
+    size_t GetRasterizedGlyphCount() const
+    {
+      return mRasterizedGlyphs;
+    }
+
+    struct Source;
+    struct Band;
+
+  private:
+    bool Rasterize(Source& aSource, uint32_t aCodepoint);
+    bool Allocate(int aWidth, int aHeight, int& aX, int& aY);
+    bool Grow();
+    void RescaleUvs(float aScaleU, float aScaleV);
+    void UploadTexture();
+
+    Renderer* mRenderer;
+    FT_LibraryRec_* mLibrary = nullptr;
+    unsigned int mFreeTypeFlags;
+    int mWidth;
+    int mMaxHeight;
+
+    std::vector<std::unique_ptr<Source>> mSources;
+    std::vector<std::unique_ptr<Band>> mBands;
+
+    std::unique_ptr<Texture> mTexture;
+
+    // Frames that used a texture we've since replaced may still be in flight.
+    std::vector<std::pair<std::unique_ptr<Texture>, int>> mRetiredTextures;
+
+    // Area of the atlas written since the last upload, empty when mDirtyX1 <= mDirtyX0.
+    int mDirtyX0 = 0;
+    int mDirtyY0 = 0;
+    int mDirtyX1 = 0;
+    int mDirtyY1 = 0;
+    bool mTextureResized = false;
+
+    size_t mRasterizedGlyphs = 0;
+  };
+}
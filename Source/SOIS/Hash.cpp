@@ -0,0 +1,105 @@
+#include <cstring>
+
+#include "SOIS/Hash.hpp"
+
+namespace SOIS
+{
+  static constexpr uint64_t cPrime1 = 0x9E3779B185EBCA87ull;
+  static constexpr uint64_t cPrime2 = 0xC2B2AE3D27D4EB4Full;
+  static constexpr uint64_t cPrime3 = 0x165667B19E3779F9ull;
+  static constexpr uint64_t cPrime4 = 0x85EBCA77C2B2AE63ull;
+  static constexpr uint64_t cPrime5 = 0x27D4EB2F165667C5ull;
+
+  static inline uint64_t RotateLeft(uint64_t aValue, int aBits)
+  {
+    return (aValue << aBits) | (aValue >> (64 - aBits));
+  }
+
+  // Unaligned little endian reads, memcpy compiles down to a single load.
+  static inline uint64_t Read64(unsigned char const* aData)
+  {
+    uint64_t value;
+    memcpy(&value, aData, sizeof(value));
+    return value;
+  }
+
+  static inline uint32_t Read32(unsigned char const* aData)
+  {
+    uint32_t value;
+    memcpy(&value, aData, sizeof(value));
+    return value;
+  }
+
+  static inline uint64_t Round(uint64_t aAccumulator, uint64_t aInput)
+  {
+    aAccumulator += aInput * cPrime2;
+    aAccumulator = RotateLeft(aAccumulator, 31);
+    return aAccumulator * cPrime1;
+  }
+
+  static inline uint64_t MergeRound(uint64_t aAccumulator, uint64_t aValue)
+  {
+    aAccumulator ^= Round(0, aValue);
+    return aAccumulator * cPrime1 + cPrime4;
+  }
+
+  uint64_t Hash64(void const* aData, size_t aSize, uint64_t aSeed)
+  {
+    auto data = static_cast<unsigned char const*>(aData);
+    auto end = data + aSize;
+    uint64_t hash;
+
+    if (aSize >= 32)
+    {
+      // Four independent lanes so the multiplies can overlap.
+      uint64_t lanes[4] = { aSeed + cPrime1 + cPrime2, aSeed + cPrime2, aSeed, aSeed - cPrime1 };
+
+      for (; data + 32 <= end; data += 32)
+      {
+        lanes[0] = Round(lanes[0], Read64(data));
+        lanes[1] = Round(lanes[1], Read64(data + 8));
+        lanes[2] = Round(lanes[2], Read64(data + 16));
+        lanes[3] = Round(lanes[3], Read64(data + 24));
+      }
+
+      hash = RotateLeft(lanes[0], 1) + RotateLeft(lanes[1], 7) + RotateLeft(lanes[2], 12) + RotateLeft(lanes[3], 18);
+      for (uint64_t lane : lanes)
+      {
+        hash = MergeRound(hash, lane);
+      }
+    }
+    else
+    {
+      hash = aSeed + cPrime5;
+    }
+
+    hash += static_cast<uint64_t>(aSize);
+
+    for (; data + 8 <= end; data += 8)
+    {
+      hash ^= Round(0, Read64(data));
+      hash = RotateLeft(hash, 27) * cPrime1 + cPrime4;
+    }
+
+    if (data + 4 <= end)
+    {
+      hash ^= static_cast<uint64_t>(Read32(data)) * cPrime1;
+      hash = RotateLeft(hash, 23) * cPrime2 + cPrime3;
+      data += 4;
+    }
+
+    for (; data < end; ++data)
+    {
+      hash ^= (*data) * cPrime5;
+      hash = RotateLeft(hash, 11) * cPrime1;
+    }
+
+    hash ^= hash >> 33;
+    hash *= cPrime2;
+    hash ^= hash >> 29;
+    hash *= cPrime3;
+    hash ^= hash >> 32;
+
+    return hash;
+  }
+}
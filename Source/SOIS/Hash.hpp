@@ -0,0 +1,17 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace SOIS
+{
+  // 64 bit non-cryptographic hash (XXH64), fast enough to run over whole files. Good
+  // for cache keys and change detection, not for anything security related.
+  uint64_t Hash64(void const* aData, size_t aSize, uint64_t aSeed = 0);
+
+  // Folds aValue into aHash, for building keys out of several fields.
+  inline uint64_t HashCombine(uint64_t aHash, uint64_t aValue)
+  {
+    return aHash ^ (aValue + 0x9E3779B97F4A7C15ull + (aHash << 6) + (aHash >> 2));
+  }
+}
@@ -0,0 +1,34 @@
+#include <stb_image.h>
+
+#include "SOIS/File.hpp"
+#include "SOIS/Image.hpp"
+
+namespace SOIS
+{
+  std::optional<Image> DecodeImageFromMemory(unsigned char const* aData, size_t aSize)
+  {
+    Image image;
+    unsigned char* pixels = stbi_load_from_memory(aData, static_cast<int>(aSize), &image.Width, &image.Height, nullptr, 4);
+    if (nullptr == pixels)
+    {
+      return std::nullopt;
+    }
+
+    // Keep stb's buffer rather than copying it, which would briefly hold the image twice.
+    image.Pixels = PixelBuffer{ pixels, static_cast<size_t>(image.Width) * static_cast<size_t>(image.Height) * 4, stbi_image_free };
+
+    return image;
+  }
+
+  std::optional<Image> DecodeImageFile(std::u8string const& aFile)
+  {
+    // Decode straight out of the mapping, we never hold a copy of the compressed file.
+    auto file = MappedFile::Open(aFile);
+    if (!file)
+    {
+      return std::nullopt;
+    }
+
+    return DecodeImageFromMemory(file->GetData(), file->GetSize());
+  }
+}
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "SOIS/Renderer.hpp"
+
+namespace SOIS
+{
+  // An Image's bytes. Usually a vector, but a decoder can hand over the buffer it
+  // allocated along with the function that frees it, so what it returns isn't copied.
+  class PixelBuffer
+  {
+  public:
+    PixelBuffer() = default;
+
+    PixelBuffer(std::vector<unsigned char>&& aPixels)
+      : mVector{ std::move(aPixels) }
+    {
+    }
+
+    // Takes ownership of aData, which is released with aFree.
+    PixelBuffer(unsigned char* aData, size_t aSize, void (*aFree)(void*))
+      : mAdopted{ aData, aFree }
+      , mAdoptedSize{ aSize }
+    {
+    }
+
+    unsigned char* data()
+    {
+      return mAdopted ? mAdopted.get() : mVector.data();
+    }
+
+    unsigned char const* data() const
+    {
+      return mAdopted ? mAdopted.get() : mVector.data();
+    }
+
+    size_t size() const
+    {
+      return mAdopted ? mAdoptedSize : mVector.size();
+    }
+
+    void resize(size_t aSize)
+    {
+      if (mAdopted)
+      {
+        mVector.assign(mAdopted.get(), mAdopted.get() + std::min(aSize, mAdoptedSize));
+        mAdopted.reset();
+      }
+
+      mVector.resize(aSize);
+    }
+
+    template <typename Iterator>
+    void assign(Iterator aBegin, Iterator aEnd)
+    {
+      mAdopted.reset();
+      mVector.assign(aBegin, aEnd);
+    }
+
+  private:
+    std::vector<unsigned char> mVector;
+    std::unique_ptr<unsigned char, void (*)(void*)> mAdopted{ nullptr, nullptr };
+    size_t mAdoptedSize = 0;
+  };
+
+  // CPU side pixels, decoded and ready to be handed to Renderer::LoadTextureFromData.
+  struct Image
+  {
+    int Width = 0;
+    int Height = 0;
+    TextureLayout Layout = TextureLayout::RGBA_Unorm;
+
+    // Levels held in Pixels, or cGenerateMips if the renderer should build them on upload.
+    int MipLevels = 1;
+    PixelBuffer Pixels;
+
+    int Pitch() const
+    {
+      return GetRowPitch(Layout, Width);
+    }
+  };
+
+  // Decodes any format stb_image understands into RGBA8. These don't touch the
+  // renderer, so they're safe to call from any thread.
+  std::optional<Image> DecodeImageFromMemory(unsigned char const* aData, size_t aSize);
+  std::optional<Image> DecodeImageFile(std::u8string const& aFile);
+}
@@ -0,0 +1,259 @@
+#include <algorithm>
+#include <cfloat>
+#include <cinttypes>
+#include <cstdio>
+
+#include "imgui.h"
+
+#include "SOIS/File.hpp"
+#include "SOIS/InputLatency.hpp"
+#include "SOIS/Profiler.hpp"
+#include "SOIS/Renderer.hpp"
+
+namespace SOIS
+{
+  // A GPU this many frames behind is already being throttled by the swap chain, more
+  // fences wouldn't tell us anything.
+  static constexpr size_t cMaxPendingFences = 8;
+
+  static char const* cStageNames[] = { "NewFrame", "Render", "Present", "GPU" };
+
+  InputLatency::~InputLatency()
+  {
+  }
+
+  bool InputLatency::IsInputEvent(SDL_Event const& aEvent)
+  {
+    switch (aEvent.type)
+    {
+    case SDL_KEYDOWN:
+    case SDL_KEYUP:
+    case SDL_TEXTINPUT:
+    case SDL_MOUSEMOTION:
+    case SDL_MOUSEBUTTONDOWN:
+    case SDL_MOUSEBUTTONUP:
+    case SDL_MOUSEWHEEL:
+    case SDL_FINGERDOWN:
+    case SDL_FINGERUP:
+    case SDL_FINGERMOTION:
+    case SDL_MULTIGESTURE:
+    case SDL_CONTROLLERAXISMOTION:
+    case SDL_CONTROLLERBUTTONDOWN:
+    case SDL_CONTROLLERBUTTONUP:
+      return true;
+    default:
+      return false;
+    }
+  }
+
+  void InputLatency::Histogram::Add(int64_t aLatency)
+  {
+    aLatency = std::max<int64_t>(0, aLatency);
+    size_t bucket = std::min<size_t>(cBucketCount - 1, static_cast<size_t>(aLatency / cBucketWidth));
+    ++mBuckets[bucket];
+    ++mCount;
+    mTotal += aLatency;
+    mMax = std::max(mMax, aLatency);
+  }
+
+  int64_t InputLatency::Histogram::GetPercentile(double aPercentile) const
+  {
+    if (0 == mCount)
+    {
+      return 0;
+    }
+
+    uint64_t target = static_cast<uint64_t>(aPercentile / 100.0 * (mCount - 1)) + 1;
+    uint64_t seen = 0;
+    for (size_t i = 0; i < cBucketCount; ++i)
+    {
+      seen += mBuckets[i];
+      if (seen >= target)
+      {
+        // The overflow bucket has no upper edge, the max is the best we've got.
+        if ((cBucketCount - 1) == i)
+        {
+          return mMax;
+        }
+
+        // Middle of the bucket.
+        return std::min<int64_t>(mMax, i * cBucketWidth + cBucketWidth / 2);
+      }
+    }
+
+    return mMax;
+  }
+
+  void InputLatency::NewFrame(Renderer& aRenderer)
+  {
+    // Fences signal in order, so stop at the first one that hasn't.
+    while (false == mPendingFences.empty())
+    {
+      PendingFence& pending = mPendingFences.front();
+      if (false == aRenderer.IsFrameFenceSignalled(pending.mFence))
+      {
+        break;
+      }
+
+      // We only find out once a frame, so this is an upper bound.
+      mHistograms[static_cast<size_t>(Stage::Gpu)].Add(Profiler::Now() - pending.mInput);
+      aRenderer.DestroyFrameFence(pending.mFence);
+      mPendingFences.pop_front();
+    }
+  }
+
+  void InputLatency::InputPolled(int64_t aTime)
+  {
+    if (0 == mFrameInput || aTime < mFrameInput)
+    {
+      mFrameInput = aTime;
+    }
+  }
+
+  void InputLatency::StageReached(Stage aStage)
+  {
+    if (0 != mFrameInput)
+    {
+      mHistograms[static_cast<size_t>(aStage)].Add(Profiler::Now() - mFrameInput);
+    }
+  }
+
+  void InputLatency::FramePresented(Renderer& aRenderer)
+  {
+    if (0 == mFrameInput)
+    {
+      return;
+    }
+
+    StageReached(Stage::Present);
+
+    if (mPendingFences.size() < cMaxPendingFences)
+    {
+      if (void* fence = aRenderer.InsertFrameFence())
+      {
+        mPendingFences.emplace_back(PendingFence{ fence, mFrameInput });
+      }
+    }
+
+    mFrameInput = 0;
+  }
+
+  void InputLatency::FrameSkipped()
+  {
+    mFrameInput = 0;
+  }
+
+  void InputLatency::Shutdown(Renderer& aRenderer)
+  {
+    for (PendingFence& pending : mPendingFences)
+    {
+      aRenderer.DestroyFrameFence(pending.mFence);
+    }
+
+    mPendingFences.clear();
+  }
+
+  int64_t InputLatency::GetPercentile(Stage aStage, double aPercentile) const
+  {
+    return mHistograms[static_cast<size_t>(aStage)].GetPercentile(aPercentile);
+  }
+
+  void InputLatency::DrawWindow(bool* aOpen)
+  {
+    if (false == ImGui::Begin("Input Latency", aOpen))
+    {
+      ImGui::End();
+      return;
+    }
+
+    if (ImGui::BeginTable("Stages", 5))
+    {
+      ImGui::TableSetupColumn("Input to");
+      ImGui::TableSetupColumn("Samples");
+      ImGui::TableSetupColumn("p50 (ms)");
+      ImGui::TableSetupColumn("p99 (ms)");
+      ImGui::TableSetupColumn("Max (ms)");
+      ImGui::TableHeadersRow();
+
+      for (size_t i = 0; i < mHistograms.size(); ++i)
+      {
+        Histogram const& histogram = mHistograms[i];
+        ImGui::TableNextRow();
+        ImGui::TableNextColumn();
+        ImGui::TextUnformatted(cStageNames[i]);
+        ImGui::TableNextColumn();
+        ImGui::Text("%" PRIu64, histogram.mCount);
+        ImGui::TableNextColumn();
+        ImGui::Text("%.1f", histogram.GetPercentile(50.0) / 1000000.0);
+        ImGui::TableNextColumn();
+        ImGui::Text("%.1f", histogram.GetPercentile(99.0) / 1000000.0);
+        ImGui::TableNextColumn();
+        ImGui::Text("%.1f", histogram.mMax / 1000000.0);
+      }
+
+      ImGui::EndTable();
+    }
+
+    ImGui::Combo("Histogram", &mPlotStage, cStageNames, IM_ARRAYSIZE(cStageNames));
+
+    // Rebin to fit just past the p99, otherwise the tail squashes everything else.
+    Histogram const& histogram = mHistograms[mPlotStage];
+    size_t last = std::min(cBucketCount, static_cast<size_t>(histogram.GetPercentile(99.0) / cBucketWidth) + 2);
+    size_t perBin = (last + mPlot.size() - 1) / mPlot.size();
+
+    mPlot.fill(0.f);
+    for (size_t i = 0; i < last; ++i)
+    {
+      mPlot[i / perBin] += static_cast<float>(histogram.mBuckets[i]);
+    }
+
+    char overlay[64];
+    snprintf(overlay, sizeof(overlay), "0 - %.1f ms", (last * cBucketWidth) / 1000000.0);
+    ImGui::PlotHistogram("##Latency", mPlot.data(), static_cast<int>((last + perBin - 1) / perBin), 0, overlay, 0.f, FLT_MAX, ImVec2(ImGui::GetContentRegionAvail().x, 80.f));
+
+    ImGui::End();
+  }
+
+  bool InputLatency::WriteReport(std::u8string const& aFile) const
+  {
+    std::string report = "Input latency, from polling the event to each stage.\n\n";
+    char line[256];
+
+    snprintf(line, sizeof(line), "%-10s %10s %10s %10s %10s %10s\n", "Stage", "Samples", "Mean ms", "p50 ms", "p99 ms", "Max ms");
+    report += line;
+
+    for (size_t i = 0; i < mHistograms.size(); ++i)
+    {
+      Histogram const& histogram = mHistograms[i];
+      double mean = (0 == histogram.mCount) ? 0.0 : static_cast<double>(histogram.mTotal) / histogram.mCount;
+      snprintf(line, sizeof(line), "%-10s %10" PRIu64 " %10.2f %10.2f %10.2f %10.2f\n",
+        cStageNames[i],
+        histogram.mCount,
+        mean / 1000000.0,
+        histogram.GetPercentile(50.0) / 1000000.0,
+        histogram.GetPercentile(99.0) / 1000000.0,
+        histogram.mMax / 1000000.0);
+      report += line;
+    }
+
+    for (size_t i = 0; i < mHistograms.size(); ++i)
+    {
+      Histogram const& histogram = mHistograms[i];
+      snprintf(line, sizeof(line), "\n%s histogram (bucket start ms, count)\n", cStageNames[i]);
+      report += line;
+
+      for (size_t bucket = 0; bucket < cBucketCount; ++bucket)
+      {
+        if (0 == histogram.mBuckets[bucket])
+        {
+          continue;
+        }
+
+        snprintf(line, sizeof(line), "%s%.1f %u\n", ((cBucketCount - 1) == bucket) ? ">=" : "", (bucket * cBucketWidth) / 1000000.0, histogram.mBuckets[bucket]);
+        report += line;
+      }
+    }
+
+    return WriteFileAtomic(aFile, nullptr, 0, report.data(), report.size());
+  }
+}
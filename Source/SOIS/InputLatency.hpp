@@ -0,0 +1,102 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <deque>
+#include <string>
+
+#include <SDL.h>
+
+namespace SOIS
+{
+  class Renderer;
+
+  // Measures how long input takes to make it to the screen. Input events are stamped
+  // when BeginFrame polls them, and the oldest input of each frame is followed through
+  // ImGui::NewFrame, ImGui::Render and Present, and on to the GPU finishing the frame
+  // where the renderer can tell us (a fence, OpenGL and DX11 only, and not with
+  // threaded rendering). Latencies go into fixed bucket histograms, so there's nothing
+  // to allocate per sample and percentiles are cheap enough to show live.
+  //
+  // Frames skipped for being unchanged don't count, the input didn't change anything
+  // on screen.
+  class InputLatency
+  {
+  public:
+    enum class Stage
+    {
+      NewFrame,
+      Render,
+      Present,
+      Gpu,
+      Count
+    };
+
+    InputLatency() = default;
+    ~InputLatency();
+
+    InputLatency(InputLatency const&) = delete;
+    InputLatency& operator=(InputLatency const&) = delete;
+
+    static bool IsInputEvent(SDL_Event const& aEvent);
+
+    // Start of BeginFrame, checks fences from earlier frames.
+    void NewFrame(Renderer& aRenderer);
+
+    // aTime from Profiler::Now(), the frame remembers the oldest.
+    void InputPolled(int64_t aTime);
+
+    // Records how long the frame's input has been waiting as of aStage.
+    void StageReached(Stage aStage);
+
+    // After the frame's Present, takes a fence from the renderer to time the GPU.
+    void FramePresented(Renderer& aRenderer);
+
+    // The frame wasn't rendered, forget its input.
+    void FrameSkipped();
+
+    // Nanoseconds, from the histogram, so accurate to a bucket.
+    int64_t GetPercentile(Stage aStage, double aPercentile) const;
+
+    // p50/p99 for each stage and a histogram of one of them, as an ImGui window.
+    void DrawWindow(bool* aOpen = nullptr);
+
+    // Percentiles and the non empty buckets of each histogram, as text. Returns false
+    // if the file couldn't be written.
+    bool WriteReport(std::u8string const& aFile) const;
+
+    // Returns any fences we're still waiting on, call before the renderer goes away.
+    void Shutdown(Renderer& aRenderer);
+
+  private:
+    // 100us buckets up to 100ms, the last bucket holds everything slower.
+    static constexpr int64_t cBucketWidth = 100000;
+    static constexpr size_t cBucketCount = 1001;
+
+    struct Histogram
+    {
+      std::array<uint32_t, cBucketCount> mBuckets = {};
+      uint64_t mCount = 0;
+      int64_t mTotal = 0;
+      int64_t mMax = 0;
+
+      void Add(int64_t aLatency);
+      int64_t GetPercentile(double aPercentile) const;
+    };
+
+    struct PendingFence
+    {
+      void* mFence;
+      int64_t mInput;
+    };
+
+    std::array<Histogram, static_cast<size_t>(Stage::Count)> mHistograms;
+    std::deque<PendingFence> mPendingFences;
+
+    // Oldest input polled for the frame in flight, 0 if there wasn't any.
+    int64_t mFrameInput = 0;
+
+    std::array<float, 100> mPlot;
+    int mPlotStage = static_cast<int>(Stage::Present);
+  };
+}
@@ -0,0 +1,126 @@
+#include <SDL.h>
+
+#include "SOIS/OpenGL3GpuTimer.hpp"
+#include "SOIS/Profiler.hpp"
+
+namespace SOIS
+{
+  // The CPU and GPU clocks drift apart, so we line them back up every so often.
+  static constexpr int cFramesBetweenCalibrations = 300;
+
+  // If the GPU is this far behind something's wrong, stop queuing up queries.
+  static constexpr size_t cMaxPendingZones = 256;
+
+  bool OpenGL3GpuTimer::IsSupported()
+  {
+    gl::GLint major = 0;
+    gl::GLint minor = 0;
+    gl::glGetIntegerv(gl::GL_MAJOR_VERSION, &major);
+    gl::glGetIntegerv(gl::GL_MINOR_VERSION, &minor);
+
+    return (major > 3) || (major == 3 && minor >= 3) || SDL_GL_ExtensionSupported("GL_ARB_timer_query");
+  }
+
+  OpenGL3GpuTimer::OpenGL3GpuTimer()
+  {
+    Calibrate();
+  }
+
+  OpenGL3GpuTimer::~OpenGL3GpuTimer()
+  {
+    for (auto& zone : mPending)
+    {
+      mFreeQueries.emplace_back(zone.mBegin);
+      mFreeQueries.emplace_back(zone.mEnd);
+    }
+
+    if (0 != mBeginQuery)
+    {
+      mFreeQueries.emplace_back(mBeginQuery);
+    }
+
+    if (false == mFreeQueries.empty())
+    {
+      gl::glDeleteQueries(static_cast<gl::GLsizei>(mFreeQueries.size()), mFreeQueries.data());
+    }
+  }
+
+  void OpenGL3GpuTimer::Calibrate()
+  {
+    gl::GLint64 gpuTime = 0;
+    gl::glGetInteger64v(gl::GL_TIMESTAMP, &gpuTime);
+    mClockOffset = Profiler::Now() - gpuTime;
+    mFramesSinceCalibration = 0;
+  }
+
+  gl::GLuint OpenGL3GpuTimer::GetQuery()
+  {
+    if (mFreeQueries.empty())
+    {
+      gl::GLuint query;
+      gl::glGenQueries(1, &query);
+      return query;
+    }
+
+    gl::GLuint query = mFreeQueries.back();
+    mFreeQueries.pop_back();
+    return query;
+  }
+
+  void OpenGL3GpuTimer::Begin(char const* aName)
+  {
+    if (mPending.size() >= cMaxPendingZones)
+    {
+      return;
+    }
+
+    mName = aName;
+    mBeginQuery = GetQuery();
+    gl::glQueryCounter(mBeginQuery, gl::GL_TIMESTAMP);
+  }
+
+  void OpenGL3GpuTimer::End()
+  {
+    if (0 == mBeginQuery)
+    {
+      return;
+    }
+
+    gl::GLuint endQuery = GetQuery();
+    gl::glQueryCounter(endQuery, gl::GL_TIMESTAMP);
+
+    mPending.emplace_back(PendingZone{ mName, mBeginQuery, endQuery });
+    mBeginQuery = 0;
+  }
+
+  void OpenGL3GpuTimer::Collect()
+  {
+    // Queries complete in order, so we can stop at the first one that isn't done.
+    while (false == mPending.empty())
+    {
+      PendingZone& zone = mPending.front();
+
+      gl::GLint available = 0;
+      gl::glGetQueryObjectiv(zone.mEnd, gl::GL_QUERY_RESULT_AVAILABLE, &available);
+      if (0 == available)
+      {
+        break;
+      }
+
+      gl::GLuint64 begin = 0;
+      gl::GLuint64 end = 0;
+      gl::glGetQueryObjectui64v(zone.mBegin, gl::GL_QUERY_RESULT, &begin);
+      gl::glGetQueryObjectui64v(zone.mEnd, gl::GL_QUERY_RESULT, &end);
+      Profiler::Get().RecordGpuZone(zone.mName, static_cast<int64_t>(begin) + mClockOffset, static_cast<int64_t>(end) + mClockOffset);
+
+      mFreeQueries.emplace_back(zone.mBegin);
+      mFreeQueries.emplace_back(zone.mEnd);
+      mPending.pop_front();
+    }
+
+    if (++mFramesSinceCalibration >= cFramesBetweenCalibrations)
+    {
+      Calibrate();
+    }
+  }
+}
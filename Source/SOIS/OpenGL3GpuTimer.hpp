@@ -0,0 +1,52 @@
+#pragma once
+
+#include <deque>
+#include <vector>
+
+#include <glbinding/gl/gl.h>
+
+namespace SOIS
+{
+  // Times GPU work with GL_TIMESTAMP queries and hands the results to the Profiler's
+  // GPU track. Results are read back a few frames late, once the queries are available,
+  // so timing never stalls the pipeline.
+  class OpenGL3GpuTimer
+  {
+  public:
+    OpenGL3GpuTimer();
+    ~OpenGL3GpuTimer();
+
+    OpenGL3GpuTimer(OpenGL3GpuTimer const&) = delete;
+    OpenGL3GpuTimer& operator=(OpenGL3GpuTimer const&) = delete;
+
+    // Needs GL 3.3 or ARB_timer_query, check this before creating a timer.
+    static bool IsSupported();
+
+    // Zones don't nest, aName has to outlive the profiler.
+    void Begin(char const* aName);
+    void End();
+
+    // Reports every zone the GPU has finished with, call once a frame.
+    void Collect();
+
+  private:
+    struct PendingZone
+    {
+      char const* mName;
+      gl::GLuint mBegin;
+      gl::GLuint mEnd;
+    };
+
+    gl::GLuint GetQuery();
+    void Calibrate();
+
+    std::deque<PendingZone> mPending;
+    std::vector<gl::GLuint> mFreeQueries;
+    char const* mName = nullptr;
+    gl::GLuint mBeginQuery = 0;
+
+    // Profiler::Now() - GPU timestamp, both in nanoseconds.
+    gl::GLint64 mClockOffset = 0;
+    int mFramesSinceCalibration = 0;
+  };
+}
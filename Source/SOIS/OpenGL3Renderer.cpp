@@ -1,3 +1,7 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <vector>
 
 #include <glbinding/gl/gl.h>
 #include <glbinding/glbinding.h>
@@ -7,9 +11,12 @@
 #include "imgui_impl_sdl.h"
 #include "imgui_impl_opengl3.h"
 
-#include <stb_image.h>
-
+#include "SOIS/OpenGL3GpuTimer.hpp"
 #include "SOIS/OpenGL3Renderer.hpp"
+#include "SOIS/OpenGL3UploadRing.hpp"
+#include "SOIS/Profiler.hpp"
+#include "SOIS/TextureCompression.hpp"
+#include "SOIS/TextureMips.hpp"
 
 namespace SOIS
 {
@@ -83,6 +90,9 @@ namespace SOIS
     return reinterpret_cast<glbinding::ProcAddress>(SDL_GL_GetProcAddress(aName));
   }
 
+  // Enough for a few 1080p RGBA frames in flight, anything bigger uploads directly.
+  static constexpr size_t cUploadRingSize = 32 * 1024 * 1024;
+
   // Decide GL+GLSL versions
 #if __APPLE__
     // GL 3.2 Core + GLSL 150
@@ -148,13 +158,75 @@ namespace SOIS
   }
 
 
+  void OpenGL3Renderer::SetPresentMode(PresentMode aMode)
+  {
+    mPresentMode = aMode;
+
+    // The swap interval belongs to whichever context presents, so let that thread set it.
+    if (nullptr != mRenderContext)
+    {
+      mPresentModeChanged = true;
+      return;
+    }
+
+    SDL_GL_MakeCurrent(mWindow, mContext);
+    ApplyPresentMode(aMode);
+  }
+
+  void OpenGL3Renderer::ApplyPresentMode(PresentMode aMode)
+  {
+    switch (aMode)
+    {
+    case PresentMode::Immediate: SDL_GL_SetSwapInterval(0); break;
+    case PresentMode::AdaptiveVsync:
+    {
+      // Needs EXT_swap_control_tear (or the like), not every driver has it.
+      if (0 == SDL_GL_SetSwapInterval(-1))
+      {
+        break;
+      }
+
+      [[fallthrough]];
+    }
+    default:
+    case PresentMode::Vsync: SDL_GL_SetSwapInterval(1); break;
+    }
+  }
+
+  void OpenGL3Renderer::SetPartialRedraw(bool aPartialRedraw)
+  {
+    mPartialRedraw = aPartialRedraw;
+    mFullRedraw = true;
+
+    // Framebuffers aren't shared between contexts, the render thread cleans up its own.
+    if (false == mPartialRedraw && nullptr == mRenderContext)
+    {
+      SDL_GL_MakeCurrent(mWindow, mContext);
+      DestroyRedrawTarget();
+    }
+  }
+
   OpenGL3Renderer::~OpenGL3Renderer()
   {
+    if (nullptr != mRenderContext)
+    {
+      SDL_GL_DeleteContext(mRenderContext);
+      SDL_GL_MakeCurrent(mWindow, mContext);
+    }
+    else
+    {
+      DestroyRedrawTarget();
+    }
+
+    mGpuTimer.reset();
+    mUploadRing.reset();
     ImGui_ImplOpenGL3_Shutdown();
   }
 
   void OpenGL3Renderer::NewFrame()
   {
+    ProcessAsyncTextureUploads();
+    UpdateTextureResidency();
     ImGui_ImplOpenGL3_NewFrame();
   }
 
@@ -167,6 +239,22 @@ namespace SOIS
   {
     // Clear the viewport to prepare for user rendering.
     SDL_GL_MakeCurrent(mWindow, mContext);
+
+    // The render thread clears when it gets to the frame, SubmitFrame hands it the color.
+    if (nullptr != mRenderContext)
+    {
+      mSubmittedClearColor = aClearColor;
+      return;
+    }
+
+    // Partial redraws clear just the damaged area when rendering.
+    if (mPartialRedraw)
+    {
+      mFullRedraw = mFullRedraw || (aClearColor != mClearColor);
+      mClearColor = aClearColor;
+      return;
+    }
+
     ImGuiIO& io = ImGui::GetIO();
     gl::glViewport(0, 0, (int)io.DisplaySize.x, (int)io.DisplaySize.y);
     gl::glClearColor(aClearColor.x, aClearColor.y, aClearColor.z, aClearColor.w);
@@ -175,35 +263,366 @@ namespace SOIS
 
   void OpenGL3Renderer::RenderImguiData()
   {
-    ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+    SOIS_PROFILE_SCOPE("RenderImguiData");
+    GenerateUpdatedMips();
+    BeginGpuZone("ImGui");
+
+    if (mPartialRedraw && nullptr != ImGui::GetDrawData())
+    {
+      glm::vec4 damage;
+      bool damaged = ComputeDamage(ImGui::GetDrawData(), damage);
+      RenderPartial(ImGui::GetDrawData(), damaged, damage, mFullRedraw);
+      mFullRedraw = false;
+    }
+    else
+    {
+      MergeDrawCommands(ImGui::GetDrawData());
+      ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+    }
+
+    EndGpuZone();
+  }
+
+  void OpenGL3Renderer::BeginGpuZone(char const* aName)
+  {
+    if (false == Profiler::IsEnabled())
+    {
+      return;
+    }
+
+    if (false == mGpuTimerChecked)
+    {
+      mGpuTimerChecked = true;
+
+      if (OpenGL3GpuTimer::IsSupported())
+      {
+        mGpuTimer = std::make_unique<OpenGL3GpuTimer>();
+      }
+    }
+
+    if (mGpuTimer)
+    {
+      mGpuTimer->Collect();
+      mGpuTimer->Begin(aName);
+    }
+  }
+
+  void OpenGL3Renderer::EndGpuZone()
+  {
+    if (mGpuTimer)
+    {
+      mGpuTimer->End();
+    }
+  }
+
+  bool OpenGL3Renderer::EnableRenderThread()
+  {
+    // Created here since sharing needs mContext current, but only ever used on the render thread.
+    SDL_GL_MakeCurrent(mWindow, mContext);
+    SDL_GL_SetAttribute(SDL_GL_SHARE_WITH_CURRENT_CONTEXT, 1);
+    mRenderContext = SDL_GL_CreateContext(mWindow);
+    SDL_GL_SetAttribute(SDL_GL_SHARE_WITH_CURRENT_CONTEXT, 0);
+    SDL_GL_MakeCurrent(mWindow, mContext);
+
+    if (nullptr == mRenderContext)
+    {
+      return false;
+    }
+
+    // Queries aren't shared between contexts, the render thread makes its own timer.
+    mGpuTimer.reset();
+    mGpuTimerChecked = false;
+
+    mSupportsFences = OpenGL3UploadRing::IsSupported();
+    mPresentModeChanged = true;
+    mFullRedraw = true;
+    return true;
+  }
+
+  void OpenGL3Renderer::SubmitFrame(ImDrawData const* aDrawData)
+  {
+    mFullRedraw = mFullRedraw || (mSubmittedClearColor != mClearColor);
+    mClearColor = mSubmittedClearColor;
+
+    // The damage history is fed by UpdateTexture, so it stays with the main thread.
+    mSubmittedDamaged = false;
+    if (mPartialRedraw && nullptr != aDrawData && aDrawData->Valid)
+    {
+      mSubmittedDamaged = ComputeDamage(aDrawData, mSubmittedDamage);
+    }
+
+    mSubmittedPartialRedraw = mPartialRedraw;
+    mSubmittedFullRedraw = mFullRedraw;
+    mFullRedraw = false;
+
+    GenerateUpdatedMips();
+
+    // Uploads and the like from this frame have to land before the render context
+    // samples them. A fence lets it wait on the GPU, without one we wait here.
+    if (mSupportsFences)
+    {
+      mFrameFence = gl::glFenceSync(gl::GL_SYNC_GPU_COMMANDS_COMPLETE, gl::UnusedMask::GL_NONE_BIT);
+      gl::glFlush();
+    }
+    else
+    {
+      gl::glFinish();
+    }
+  }
+
+  void OpenGL3Renderer::RenderFrame(ImDrawData* aDrawData)
+  {
+    if (false == mRenderThreadStarted)
+    {
+      mRenderThreadStarted = true;
+      SDL_GL_MakeCurrent(mWindow, mRenderContext);
+      glbinding::initialize(static_cast<glbinding::ContextHandle>(reinterpret_cast<uintptr_t>(mRenderContext)), GLFunctionLoader);
+      Profiler::Get().SetThreadName("Render");
+    }
+
+    SOIS_PROFILE_SCOPE("RenderFrame");
+
+    if (mPresentModeChanged.exchange(false))
+    {
+      ApplyPresentMode(mPresentMode);
+    }
+
+    if (nullptr != mFrameFence)
+    {
+      gl::GLsync fence = static_cast<gl::GLsync>(mFrameFence);
+      gl::glWaitSync(fence, gl::UnusedMask::GL_NONE_BIT, gl::GL_TIMEOUT_IGNORED);
+      gl::glDeleteSync(fence);
+      mFrameFence = nullptr;
+    }
+
+    BeginGpuZone("Frame");
+
+    if (mSubmittedPartialRedraw && nullptr != aDrawData)
+    {
+      RenderPartial(aDrawData, mSubmittedDamaged, mSubmittedDamage, mSubmittedFullRedraw);
+    }
+    else
+    {
+      // ImGui belongs to the main thread, ask SDL for the size instead.
+      int width;
+      int height;
+      SDL_GL_GetDrawableSize(mWindow, &width, &height);
+      gl::glViewport(0, 0, width, height);
+      gl::glClearColor(mClearColor.x, mClearColor.y, mClearColor.z, mClearColor.w);
+      gl::glClear(gl::GL_COLOR_BUFFER_BIT);
+
+      if (nullptr != aDrawData)
+      {
+        MergeDrawCommands(aDrawData);
+        ImGui_ImplOpenGL3_RenderDrawData(aDrawData);
+      }
+    }
+
+    EndGpuZone();
+
+    SOIS_PROFILE_SCOPE("Present");
+    SDL_GL_SwapWindow(mWindow);
+  }
+
+  void OpenGL3Renderer::DisableRenderThread()
+  {
+    if (mRenderThreadStarted)
+    {
+      mGpuTimer.reset();
+      DestroyRedrawTarget();
+    }
+
+    SDL_GL_MakeCurrent(mWindow, nullptr);
+  }
+
+  void OpenGL3Renderer::RenderPartial(ImDrawData* aDrawData, bool aDamaged, glm::vec4 aDamage, bool aFullRedraw)
+  {
+    int width = static_cast<int>(aDrawData->DisplaySize.x * aDrawData->FramebufferScale.x);
+    int height = static_cast<int>(aDrawData->DisplaySize.y * aDrawData->FramebufferScale.y);
+    if (width <= 0 || height <= 0)
+    {
+      return;
+    }
+
+    glm::vec4 damage = aDamage;
+    bool damaged = aDamaged;
+    if (UpdateRedrawTarget(width, height) || aFullRedraw)
+    {
+      damage = { aDrawData->DisplayPos.x, aDrawData->DisplayPos.y, aDrawData->DisplayPos.x + aDrawData->DisplaySize.x, aDrawData->DisplayPos.y + aDrawData->DisplaySize.y };
+      damaged = true;
+    }
+
+    gl::glBindFramebuffer(gl::GL_FRAMEBUFFER, mRedrawFramebuffer);
+
+    if (damaged)
+    {
+      // Snap to whole framebuffer pixels, rounding outwards.
+      glm::vec2 scale = { aDrawData->FramebufferScale.x, aDrawData->FramebufferScale.y };
+      int x1 = std::max(0, static_cast<int>(std::floor((damage.x - aDrawData->DisplayPos.x) * scale.x)));
+      int y1 = std::max(0, static_cast<int>(std::floor((damage.y - aDrawData->DisplayPos.y) * scale.y)));
+      int x2 = std::min(width, static_cast<int>(std::ceil((damage.z - aDrawData->DisplayPos.x) * scale.x)));
+      int y2 = std::min(height, static_cast<int>(std::ceil((damage.w - aDrawData->DisplayPos.y) * scale.y)));
+
+      // Back to display coordinates, so the commands we keep cover exactly what we clear.
+      damage = { aDrawData->DisplayPos.x + x1 / scale.x, aDrawData->DisplayPos.y + y1 / scale.y, aDrawData->DisplayPos.x + x2 / scale.x, aDrawData->DisplayPos.y + y2 / scale.y };
+
+      gl::glEnable(gl::GL_SCISSOR_TEST);
+      gl::glScissor(x1, height - y2, x2 - x1, y2 - y1);
+      gl::glClearColor(mClearColor.x, mClearColor.y, mClearColor.z, mClearColor.w);
+      gl::glClear(gl::GL_COLOR_BUFFER_BIT);
+      gl::glDisable(gl::GL_SCISSOR_TEST);
+
+      ClipDrawData(aDrawData, damage);
+      MergeDrawCommands(aDrawData);
+      ImGui_ImplOpenGL3_RenderDrawData(aDrawData);
+    }
+
+    // After a swap the back buffer could hold anything, so it always gets the whole frame.
+    gl::glBindFramebuffer(gl::GL_READ_FRAMEBUFFER, mRedrawFramebuffer);
+    gl::glBindFramebuffer(gl::GL_DRAW_FRAMEBUFFER, 0);
+    gl::glBlitFramebuffer(0, 0, width, height, 0, 0, width, height, gl::GL_COLOR_BUFFER_BIT, gl::GL_NEAREST);
+    gl::glBindFramebuffer(gl::GL_FRAMEBUFFER, 0);
+  }
+
+  bool OpenGL3Renderer::UpdateRedrawTarget(int aWidth, int aHeight)
+  {
+    if (0 != mRedrawFramebuffer && aWidth == mRedrawWidth && aHeight == mRedrawHeight)
+    {
+      return false;
+    }
+
+    DestroyRedrawTarget();
+    mRedrawWidth = aWidth;
+    mRedrawHeight = aHeight;
+
+    gl::GLuint texture;
+    gl::glGenTextures(1, &texture);
+    gl::glBindTexture(gl::GL_TEXTURE_2D, texture);
+    gl::glTexParameteri(gl::GL_TEXTURE_2D, gl::GL_TEXTURE_MIN_FILTER, gl::GL_NEAREST);
+    gl::glTexParameteri(gl::GL_TEXTURE_2D, gl::GL_TEXTURE_MAG_FILTER, gl::GL_NEAREST);
+    gl::glTexImage2D(gl::GL_TEXTURE_2D, 0, gl::GL_RGBA8, aWidth, aHeight, 0, gl::GL_RGBA, gl::GL_UNSIGNED_BYTE, nullptr);
+    mRedrawTexture = texture;
+
+    gl::GLuint framebuffer;
+    gl::glGenFramebuffers(1, &framebuffer);
+    gl::glBindFramebuffer(gl::GL_FRAMEBUFFER, framebuffer);
+    gl::glFramebufferTexture2D(gl::GL_FRAMEBUFFER, gl::GL_COLOR_ATTACHMENT0, gl::GL_TEXTURE_2D, texture, 0);
+    gl::glBindFramebuffer(gl::GL_FRAMEBUFFER, 0);
+    mRedrawFramebuffer = framebuffer;
+
+    return true;
+  }
+
+  void OpenGL3Renderer::DestroyRedrawTarget()
+  {
+    if (0 != mRedrawFramebuffer)
+    {
+      gl::GLuint framebuffer = mRedrawFramebuffer;
+      gl::glDeleteFramebuffers(1, &framebuffer);
+      mRedrawFramebuffer = 0;
+    }
+
+    if (0 != mRedrawTexture)
+    {
+      gl::GLuint texture = mRedrawTexture;
+      gl::glDeleteTextures(1, &texture);
+      mRedrawTexture = 0;
+    }
   }
 
   void OpenGL3Renderer::Present()
   {
+    SOIS_PROFILE_SCOPE("Present");
+
     // Swap the buffers and prepare for next frame.
     SDL_GL_MakeCurrent(mWindow, mContext);
     SDL_GL_SwapWindow(mWindow);
 
   }
 
+  void* OpenGL3Renderer::InsertFrameFence()
+  {
+    if (false == mFrameFencesChecked)
+    {
+      mFrameFencesChecked = true;
+      mSupportsFrameFences = OpenGL3UploadRing::IsSupported();
+    }
+
+    // Presents happen on the render thread's context, a fence here wouldn't follow them.
+    if (false == mSupportsFrameFences || nullptr != mRenderContext)
+    {
+      return nullptr;
+    }
+
+    gl::GLsync fence = gl::glFenceSync(gl::GL_SYNC_GPU_COMMANDS_COMPLETE, gl::UnusedMask::GL_NONE_BIT);
+
+    // Without a flush the fence might not reach the GPU until next frame.
+    gl::glFlush();
+    return fence;
+  }
+
+  bool OpenGL3Renderer::IsFrameFenceSignalled(void* aFence)
+  {
+    gl::GLenum result = gl::glClientWaitSync(static_cast<gl::GLsync>(aFence), static_cast<gl::SyncObjectMask>(0), 0);
+    return gl::GL_ALREADY_SIGNALED == result || gl::GL_CONDITION_SATISFIED == result;
+  }
+
+  void OpenGL3Renderer::DestroyFrameFence(void* aFence)
+  {
+    gl::glDeleteSync(static_cast<gl::GLsync>(aFence));
+  }
+
   static gl::GLenum FromSOIS(TextureLayout aLayout)
   {
     switch (aLayout)
     {
-    case TextureLayout::RGBA_Unorm: return gl::GL_RGBA;
-    case TextureLayout::RGBA_Srgb: return gl::GL_RGBA;
+    case TextureLayout::RGBA_Unorm: return gl::GL_RGBA8;
+    case TextureLayout::RGBA_Srgb: return gl::GL_SRGB8_ALPHA8;
+    case TextureLayout::Bc1_Rgba_Unorm: return gl::GL_COMPRESSED_RGBA_S3TC_DXT1_EXT;
     case TextureLayout::Bc1_Rgba_Srgb: return gl::GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT1_EXT;
-    case TextureLayout::Bc3_Srgb: return gl::GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT3_EXT;
-
-    case TextureLayout::Bc1_Rgba_Unorm: //return DXGI_FORMAT_A8_UNORM;
-    case TextureLayout::Bc3_Unorm: //return DXGI_FORMAT_BC3_UNORM;
-    case TextureLayout::Bc7_Unorm: //return DXGI_FORMAT_BC7_UNORM;
-    case TextureLayout::Bc7_Srgb: //return DXGI_FORMAT_BC7_UNORM_SRGB;
+    case TextureLayout::Bc3_Unorm: return gl::GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+    case TextureLayout::Bc3_Srgb: return gl::GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT;
+    case TextureLayout::Bc7_Unorm: return gl::GL_COMPRESSED_RGBA_BPTC_UNORM;
+    case TextureLayout::Bc7_Srgb: return gl::GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM;
     default:
     case TextureLayout::InvalidLayout: return (gl::GLenum)0;
     }
   }
 
+  static bool IsSrgb(TextureLayout aLayout)
+  {
+    return TextureLayout::RGBA_Srgb == aLayout ||
+           TextureLayout::Bc1_Rgba_Srgb == aLayout ||
+           TextureLayout::Bc3_Srgb == aLayout ||
+           TextureLayout::Bc7_Srgb == aLayout;
+  }
+
+  bool OpenGL3Renderer::SupportsLayout(TextureLayout aLayout)
+  {
+    if (false == mCompressionChecked)
+    {
+      mCompressionChecked = true;
+
+      // S3TC isn't core in any version, BPTC is core from 4.2 but drivers still list it.
+      mSupportsS3tc = SDL_GL_ExtensionSupported("GL_EXT_texture_compression_s3tc");
+      mSupportsS3tcSrgb = mSupportsS3tc && (SDL_GL_ExtensionSupported("GL_EXT_texture_sRGB") || SDL_GL_ExtensionSupported("GL_EXT_texture_compression_s3tc_srgb"));
+      mSupportsBptc = SDL_GL_ExtensionSupported("GL_ARB_texture_compression_bptc") || SDL_GL_ExtensionSupported("GL_EXT_texture_compression_bptc");
+    }
+
+    switch (aLayout)
+    {
+    case TextureLayout::RGBA_Unorm:
+    case TextureLayout::RGBA_Srgb: return true;
+    case TextureLayout::Bc1_Rgba_Unorm:
+    case TextureLayout::Bc3_Unorm: return mSupportsS3tc;
+    case TextureLayout::Bc1_Rgba_Srgb:
+    case TextureLayout::Bc3_Srgb: return mSupportsS3tcSrgb;
+    case TextureLayout::Bc7_Unorm:
+    case TextureLayout::Bc7_Srgb: return mSupportsBptc;
+    default: return false;
+    }
+  }
+
   class OpenGL3Texture : public Texture
   {
   public:
@@ -216,6 +635,12 @@ namespace SOIS
 
     ~OpenGL3Texture() override
     {
+      // The render thread may still be drawing with us, the name can't be reused until
+      // it's done.
+      mInFlightFrames->Defer([handle = mTextureHandle]()
+      {
+        gl::glDeleteTextures(1, &handle);
+      });
     }
 
     virtual void* GetTextureId()
@@ -224,74 +649,186 @@ namespace SOIS
     };
 
     gl::GLuint mTextureHandle;
+    std::shared_ptr<InFlightFrames> mInFlightFrames;
   };
 
-  std::unique_ptr<Texture> OpenGL3Renderer::LoadTextureFromData(unsigned char* data, TextureLayout format, int w, int h, int pitch)
+  std::unique_ptr<Texture> OpenGL3Renderer::LoadTextureFromData(unsigned char* data, TextureLayout format, int w, int h, int pitch, int aMipLevels)
   {
+    if (TextureLayout::InvalidLayout == format)
+    {
+      return nullptr;
+    }
+
+    int levels = (cGenerateMips == aMipLevels) ? GetMipLevelCount(w, h) : std::max(1, aMipLevels);
+
+    // We can't render into compressed textures, so their chains are built on the CPU.
+    std::vector<unsigned char> chain;
+    if (cGenerateMips == aMipLevels && IsBlockCompressed(format))
+    {
+      auto pixels = DecompressTexture(data, w, h, format);
+      chain = GenerateMipChain(pixels.data(), w, h, w * 4, format);
+      data = chain.data();
+      pitch = GetRowPitch(format, w);
+      aMipLevels = levels;
+    }
+
+    bool const generateOnGpu = cGenerateMips == aMipLevels;
+
     // Create a OpenGL texture identifier
     gl::GLuint image_texture;
     gl::glGenTextures(1, &image_texture);
     gl::glBindTexture(gl::GL_TEXTURE_2D, image_texture);
 
-    // Setup filtering parameters for display
-    gl::glTexParameteri(gl::GL_TEXTURE_2D, gl::GL_TEXTURE_MIN_FILTER, gl::GL_LINEAR);
+    // Setup filtering parameters for display, trilinear when we have mips to blend between.
+    gl::glTexParameteri(gl::GL_TEXTURE_2D, gl::GL_TEXTURE_MIN_FILTER, (levels > 1) ? gl::GL_LINEAR_MIPMAP_LINEAR : gl::GL_LINEAR);
     gl::glTexParameteri(gl::GL_TEXTURE_2D, gl::GL_TEXTURE_MAG_FILTER, gl::GL_LINEAR);
     gl::glTexParameteri(gl::GL_TEXTURE_2D, gl::GL_TEXTURE_WRAP_S, gl::GL_CLAMP_TO_EDGE); // This is required on WebGL for non power-of-two textures
     gl::glTexParameteri(gl::GL_TEXTURE_2D, gl::GL_TEXTURE_WRAP_T, gl::GL_CLAMP_TO_EDGE); // Same
+    gl::glTexParameteri(gl::GL_TEXTURE_2D, gl::GL_TEXTURE_MAX_LEVEL, levels - 1);
 
     // Upload pixels into texture
-#if defined(GL_UNPACK_ROW_LENGTH) && !defined(__EMSCRIPTEN__)
-    glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
-#endif
-    gl::glTexImage2D(gl::GL_TEXTURE_2D, 0, FromSOIS(format), w, h, 0, FromSOIS(format), gl::GL_UNSIGNED_BYTE, data);
+    for (int level = 0; level < (generateOnGpu ? 1 : levels); ++level)
+    {
+      int width = GetMipSize(w, level);
+      int levelPitch = (0 == level) ? pitch : GetRowPitch(format, width);
+      UploadLevel(image_texture, format, level, width, GetMipSize(h, level), data + GetMipOffset(format, w, h, level), levelPitch);
+    }
+
+    if (generateOnGpu && levels > 1)
+    {
+      gl::glBindTexture(gl::GL_TEXTURE_2D, image_texture);
+      gl::glGenerateMipmap(gl::GL_TEXTURE_2D);
+    }
 
     auto texture = std::make_unique<OpenGL3Texture>(image_texture, w, h);
+    texture->mInFlightFrames = GetInFlightFrames();
+    texture->MipLevels = levels;
+    texture->Owner = this;
+
+    // Compressed layouts the driver can't sample were expanded by UploadLevel.
+    bool expanded = IsBlockCompressed(format) && !SupportsLayout(format);
+    texture->Layout = expanded ? (IsSrgb(format) ? TextureLayout::RGBA_Srgb : TextureLayout::RGBA_Unorm) : format;
 
     return std::unique_ptr<Texture>(texture.release());
   }
 
-  std::unique_ptr<Texture> OpenGL3Renderer::LoadTextureFromFile(std::u8string const& aFile)
+  void OpenGL3Renderer::UploadLevel(unsigned int aTexture, TextureLayout aLayout, int aLevel, int aWidth, int aHeight, unsigned char const* aData, int aPitch)
   {
-    // Load from disk into a raw RGBA buffer
-    std::vector<char> imageData;
-    SDL_RWops* io = SDL_RWFromFile((char const*)aFile.c_str(), "rb");
-    if (io != nullptr)
+    if (!IsBlockCompressed(aLayout))
     {
-      /* Seek to 0 bytes from the end of the file */
-      Sint64 length = SDL_RWseek(io, 0, RW_SEEK_END);
-      SDL_RWseek(io, 0, RW_SEEK_SET);
-      imageData.resize(length);
-      SDL_RWread(io, imageData.data(), length, 1);
-      SDL_RWclose(io);
+      // Allocate storage only, the pixels go through the upload ring.
+      gl::glBindTexture(gl::GL_TEXTURE_2D, aTexture);
+      gl::glTexImage2D(gl::GL_TEXTURE_2D, aLevel, FromSOIS(aLayout), aWidth, aHeight, 0, gl::GL_RGBA, gl::GL_UNSIGNED_BYTE, nullptr);
+      UploadRegion(aTexture, aLevel, TextureRegion{ 0, 0, aWidth, aHeight }, aData, aPitch);
+      return;
     }
 
-    // Load from disk into a raw RGBA buffer
-    int image_width = 0;
-    int image_height = 0;
-    unsigned char* image_data = stbi_load_from_memory((unsigned char*)imageData.data(), imageData.size(), &image_width, &image_height, NULL, 4);
-    if (image_data == NULL)
-      return nullptr;
+    // Compressed uploads ignore the unpack row length, so the rows of blocks need to be packed.
+    int rowPitch = GetRowPitch(aLayout, aWidth);
+    std::vector<unsigned char> packed;
+    if (aPitch != rowPitch)
+    {
+      int blockRows = (aHeight + 3) / 4;
+      packed.resize(GetTextureDataSize(aLayout, aWidth, aHeight));
+      for (int row = 0; row < blockRows; ++row)
+      {
+        memcpy(packed.data() + static_cast<size_t>(row) * rowPitch, aData + static_cast<size_t>(row) * aPitch, rowPitch);
+      }
+
+      aData = packed.data();
+    }
 
-    // Create a OpenGL texture identifier
-    gl::GLuint image_texture;
-    gl::glGenTextures(1, &image_texture);
-    gl::glBindTexture(gl::GL_TEXTURE_2D, image_texture);
+    if (SupportsLayout(aLayout))
+    {
+      gl::glBindTexture(gl::GL_TEXTURE_2D, aTexture);
+      gl::glCompressedTexImage2D(gl::GL_TEXTURE_2D, aLevel, FromSOIS(aLayout), aWidth, aHeight, 0, static_cast<gl::GLsizei>(GetTextureDataSize(aLayout, aWidth, aHeight)), aData);
+    }
+    else
+    {
+      // The driver can't sample this, so expand it back out on the CPU. We lose the
+      // memory savings but the texture still shows up.
+      auto pixels = DecompressTexture(aData, aWidth, aHeight, aLayout);
+      TextureLayout fallback = IsSrgb(aLayout) ? TextureLayout::RGBA_Srgb : TextureLayout::RGBA_Unorm;
+      UploadLevel(aTexture, fallback, aLevel, aWidth, aHeight, pixels.data(), aWidth * 4);
+    }
+  }
 
-    // Setup filtering parameters for display
-    gl::glTexParameteri(gl::GL_TEXTURE_2D, gl::GL_TEXTURE_MIN_FILTER, gl::GL_LINEAR);
-    gl::glTexParameteri(gl::GL_TEXTURE_2D, gl::GL_TEXTURE_MAG_FILTER, gl::GL_LINEAR);
-    gl::glTexParameteri(gl::GL_TEXTURE_2D, gl::GL_TEXTURE_WRAP_S, gl::GL_CLAMP_TO_EDGE); // This is required on WebGL for non power-of-two textures
-    gl::glTexParameteri(gl::GL_TEXTURE_2D, gl::GL_TEXTURE_WRAP_T, gl::GL_CLAMP_TO_EDGE); // Same
+  void OpenGL3Renderer::UpdateTexture(Texture* aTexture, TextureRegion aRegion, unsigned char const* aData, int aPitch)
+  {
+    if (this != aTexture->Owner)
+    {
+      SDL_assert(false && "UpdateTexture was given a texture this renderer didn't load.");
+      return;
+    }
 
-    // Upload pixels into texture
-#if defined(GL_UNPACK_ROW_LENGTH) && !defined(__EMSCRIPTEN__)
-    glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
-#endif
-    gl::glTexImage2D(gl::GL_TEXTURE_2D, 0, gl::GL_RGBA, image_width, image_height, 0, gl::GL_RGBA, gl::GL_UNSIGNED_BYTE, image_data);
-    stbi_image_free(image_data);
+    TextureContentsChanged(aTexture);
+    auto texture = static_cast<OpenGL3Texture*>(aTexture);
 
-    auto texture = std::make_unique<OpenGL3Texture>(image_texture, image_width, image_height);
+    // A frame in flight may be drawing with it, so the write waits until that's done,
+    // on a copy since aData won't be around by then.
+    if (GetInFlightFrames()->IsIdle())
+    {
+      UploadRegion(texture->mTextureHandle, 0, aRegion, aData, aPitch);
+    }
+    else
+    {
+      size_t rowSize = static_cast<size_t>(aRegion.Width) * 4;
+      std::vector<unsigned char> data(rowSize * aRegion.Height);
+      for (int y = 0; y < aRegion.Height; ++y)
+      {
+        memcpy(data.data() + y * rowSize, aData + static_cast<size_t>(y) * aPitch, rowSize);
+      }
+
+      GetInFlightFrames()->Defer([this, handle = texture->mTextureHandle, aRegion, data = std::move(data)]()
+      {
+        UploadRegion(handle, 0, aRegion, data.data(), aRegion.Width * 4);
+      });
+    }
 
-    return std::unique_ptr<Texture>(texture.release());
+    // The smaller levels are rebuilt once before drawing, not for every region updated.
+    if (texture->MipLevels > 1 && mMipsToGenerate.end() == std::find(mMipsToGenerate.begin(), mMipsToGenerate.end(), texture->mTextureHandle))
+    {
+      mMipsToGenerate.emplace_back(texture->mTextureHandle);
+    }
+  }
+
+  void OpenGL3Renderer::GenerateUpdatedMips()
+  {
+    for (unsigned int handle : mMipsToGenerate)
+    {
+      // The texture may have been deleted since it was updated.
+      if (gl::GL_FALSE == gl::glIsTexture(handle))
+      {
+        continue;
+      }
+
+      gl::glBindTexture(gl::GL_TEXTURE_2D, handle);
+      gl::glGenerateMipmap(gl::GL_TEXTURE_2D);
+    }
+
+    mMipsToGenerate.clear();
+  }
+
+  void OpenGL3Renderer::UploadRegion(unsigned int aTexture, int aLevel, TextureRegion aRegion, unsigned char const* aData, int aPitch)
+  {
+    if (false == mUploadRingChecked)
+    {
+      mUploadRingChecked = true;
+
+      if (OpenGL3UploadRing::IsSupported())
+      {
+        mUploadRing = std::make_unique<OpenGL3UploadRing>(cUploadRingSize);
+      }
+    }
+
+    if (mUploadRing && mUploadRing->UploadRegion(aTexture, aLevel, aRegion.X, aRegion.Y, aRegion.Width, aRegion.Height, aData, aPitch))
+    {
+      return;
+    }
+
+    gl::glBindTexture(gl::GL_TEXTURE_2D, aTexture);
+    gl::glPixelStorei(gl::GL_UNPACK_ROW_LENGTH, aPitch / 4);
+    gl::glTexSubImage2D(gl::GL_TEXTURE_2D, aLevel, aRegion.X, aRegion.Y, aRegion.Width, aRegion.Height, gl::GL_RGBA, gl::GL_UNSIGNED_BYTE, aData);
+    gl::glPixelStorei(gl::GL_UNPACK_ROW_LENGTH, 0);
   }
 }
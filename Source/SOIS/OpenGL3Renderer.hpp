@@ -1,12 +1,17 @@
 #pragma once
 
 
+#include <atomic>
+
 #include <SDL.h> // Include glfw3.h after our OpenGL definitions
 
 #include "SOIS/Renderer.hpp"
 
 namespace SOIS
 {
+  class OpenGL3GpuTimer;
+  class OpenGL3UploadRing;
+
   class OpenGL3Renderer : public Renderer
   {
   public:
@@ -16,6 +21,8 @@ namespace SOIS
     void Initialize(SDL_Window* aWindow) override;
 
     SDL_WindowFlags GetAdditionalWindowFlags() override;
+    void SetPresentMode(PresentMode aMode) override;
+    void SetPartialRedraw(bool aPartialRedraw) override;
 
     void NewFrame() override;
     void ResizeRenderTarget(unsigned int aWidth, unsigned int aHeight) override;
@@ -24,10 +31,85 @@ namespace SOIS
     void RenderImguiData() override;
     void Present() override;
 
-    std::unique_ptr<Texture> LoadTextureFromData(unsigned char* data, TextureLayout format, int w, int h, int pitch) override;
-    std::unique_ptr<Texture> LoadTextureFromFile(std::u8string const& aFile) override;
+    void* InsertFrameFence() override;
+    bool IsFrameFenceSignalled(void* aFence) override;
+    void DestroyFrameFence(void* aFence) override;
+
+    bool EnableRenderThread() override;
+    void SubmitFrame(ImDrawData const* aDrawData) override;
+    void RenderFrame(ImDrawData* aDrawData) override;
+    void DisableRenderThread() override;
+
+    std::unique_ptr<Texture> LoadTextureFromData(unsigned char* data, TextureLayout format, int w, int h, int pitch, int aMipLevels = 1) override;
+    void UpdateTexture(Texture* aTexture, TextureRegion aRegion, unsigned char const* aData, int aPitch) override;
 
   private:
+    void ApplyPresentMode(PresentMode aMode);
+
+    // SDL doesn't give us buffer age or swap with damage, so we can't know what's left in
+    // the back buffer. Instead we keep the frame in our own framebuffer, redraw just the
+    // damaged part of it, and copy the whole thing over to the back buffer. aDamage comes
+    // from ComputeDamage, which has to run on the main thread, aFullRedraw overrides it.
+    void RenderPartial(ImDrawData* aDrawData, bool aDamaged, glm::vec4 aDamage, bool aFullRedraw);
+
+    // (Re)creates the framebuffer we redraw into, true if it was (re)created.
+    bool UpdateRedrawTarget(int aWidth, int aHeight);
+    void DestroyRedrawTarget();
+
+    // Whether the driver can sample aLayout directly, compressed layouts it can't are
+    // decompressed on load.
+    bool SupportsLayout(TextureLayout aLayout);
+
+    // Allocates and fills one mip level, decompressing if the layout isn't supported.
+    void UploadLevel(unsigned int aTexture, TextureLayout aLayout, int aLevel, int aWidth, int aHeight, unsigned char const* aData, int aPitch);
+
+    // Uploads through the staging ring when we can, falls back to a direct upload.
+    void UploadRegion(unsigned int aTexture, int aLevel, TextureRegion aRegion, unsigned char const* aData, int aPitch);
+
+    // Rebuilds the mip chains of textures UpdateTexture touched since the last call, on
+    // the main context before the frame is drawn.
+    void GenerateUpdatedMips();
+
+    // The render thread gets its own context, sharing objects with mContext.
+    SDL_GLContext mRenderContext = nullptr;
+    bool mRenderThreadStarted = false;
+    bool mSupportsFences = false;
+    void* mFrameFence = nullptr;
+    bool mFrameFencesChecked = false;
+    bool mSupportsFrameFences = false;
+    PresentMode mPresentMode = PresentMode::Vsync;
+    std::atomic<bool> mPresentModeChanged = false;
+
+    bool mPartialRedraw = false;
+    bool mFullRedraw = true;
+    unsigned int mRedrawFramebuffer = 0;
+    unsigned int mRedrawTexture = 0;
+    int mRedrawWidth = 0;
+    int mRedrawHeight = 0;
+    glm::vec4 mClearColor = { 0.f, 0.f, 0.f, 1.f };
+    glm::vec4 mSubmittedClearColor = { 0.f, 0.f, 0.f, 1.f };
+
+    // Copied out by SubmitFrame for the render thread, which reads nothing else of the
+    // main thread's redraw state.
+    bool mSubmittedPartialRedraw = false;
+    bool mSubmittedFullRedraw = true;
+    bool mSubmittedDamaged = false;
+    glm::vec4 mSubmittedDamage = { 0.f, 0.f, 0.f, 0.f };
+
+    // Only used while the Profiler is on, on whichever context is rendering.
+    void BeginGpuZone(char const* aName);
+    void EndGpuZone();
+
+    std::unique_ptr<OpenGL3GpuTimer> mGpuTimer;
+    bool mGpuTimerChecked = false;
+
+    std::unique_ptr<OpenGL3UploadRing> mUploadRing;
+    std::vector<unsigned int> mMipsToGenerate;
+    bool mUploadRingChecked = false;
+    bool mCompressionChecked = false;
+    bool mSupportsS3tc = false;
+    bool mSupportsS3tcSrgb = false;
+    bool mSupportsBptc = false;
     SDL_GLContext mContext;
     SDL_Window* mWindow = nullptr;
   };
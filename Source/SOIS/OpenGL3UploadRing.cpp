@@ -0,0 +1,185 @@
+#include <cstring>
+
+#include <SDL.h>
+
+#include "SOIS/OpenGL3UploadRing.hpp"
+
+namespace SOIS
+{
+  static void GetGLVersion(gl::GLint& aMajor, gl::GLint& aMinor)
+  {
+    aMajor = 0;
+    aMinor = 0;
+    gl::glGetIntegerv(gl::GL_MAJOR_VERSION, &aMajor);
+    gl::glGetIntegerv(gl::GL_MINOR_VERSION, &aMinor);
+  }
+
+  static bool GLVersionAtLeast(gl::GLint aMajor, gl::GLint aMinor)
+  {
+    gl::GLint major;
+    gl::GLint minor;
+    GetGLVersion(major, minor);
+    return (major > aMajor) || (major == aMajor && minor >= aMinor);
+  }
+
+  bool OpenGL3UploadRing::IsSupported()
+  {
+    return GLVersionAtLeast(3, 2) || SDL_GL_ExtensionSupported("GL_ARB_sync");
+  }
+
+  OpenGL3UploadRing::OpenGL3UploadRing(size_t aCapacity)
+    : mCapacity{ aCapacity }
+  {
+    gl::glGenBuffers(1, &mBuffer);
+    gl::glBindBuffer(gl::GL_PIXEL_UNPACK_BUFFER, mBuffer);
+
+    if (GLVersionAtLeast(4, 4) || SDL_GL_ExtensionSupported("GL_ARB_buffer_storage"))
+    {
+      gl::glBufferStorage(gl::GL_PIXEL_UNPACK_BUFFER, mCapacity, nullptr, gl::GL_MAP_WRITE_BIT | gl::GL_MAP_PERSISTENT_BIT | gl::GL_MAP_COHERENT_BIT);
+      mPersistentMapping = static_cast<unsigned char*>(gl::glMapBufferRange(gl::GL_PIXEL_UNPACK_BUFFER, 0, mCapacity, gl::GL_MAP_WRITE_BIT | gl::GL_MAP_PERSISTENT_BIT | gl::GL_MAP_COHERENT_BIT));
+    }
+    else
+    {
+      gl::glBufferData(gl::GL_PIXEL_UNPACK_BUFFER, mCapacity, nullptr, gl::GL_STREAM_DRAW);
+    }
+
+    // Leaving this bound would redirect every other texture upload (ImGui's font atlas
+    // included) into our buffer.
+    gl::glBindBuffer(gl::GL_PIXEL_UNPACK_BUFFER, 0);
+  }
+
+  OpenGL3UploadRing::~OpenGL3UploadRing()
+  {
+    for (auto& inFlight : mInFlight)
+    {
+      gl::glDeleteSync(inFlight.mFence);
+    }
+
+    if (nullptr != mPersistentMapping)
+    {
+      gl::glBindBuffer(gl::GL_PIXEL_UNPACK_BUFFER, mBuffer);
+      gl::glUnmapBuffer(gl::GL_PIXEL_UNPACK_BUFFER);
+      gl::glBindBuffer(gl::GL_PIXEL_UNPACK_BUFFER, 0);
+    }
+
+    gl::glDeleteBuffers(1, &mBuffer);
+  }
+
+  void OpenGL3UploadRing::RetireOldest()
+  {
+    InFlight& oldest = mInFlight.front();
+
+    while (true)
+    {
+      // One second at a time, a lost fence shouldn't hang us forever in a single call.
+      gl::GLenum result = gl::glClientWaitSync(oldest.mFence, gl::GL_SYNC_FLUSH_COMMANDS_BIT, 1'000'000'000);
+      if (gl::GL_TIMEOUT_EXPIRED != result)
+      {
+        break;
+      }
+    }
+
+    gl::glDeleteSync(oldest.mFence);
+    mInFlight.pop_front();
+  }
+
+  void OpenGL3UploadRing::RetireSignalled()
+  {
+    while (!mInFlight.empty())
+    {
+      gl::GLenum result = gl::glClientWaitSync(mInFlight.front().mFence, static_cast<gl::SyncObjectMask>(0), 0);
+      if (gl::GL_ALREADY_SIGNALED != result && gl::GL_CONDITION_SATISFIED != result)
+      {
+        return;
+      }
+
+      gl::glDeleteSync(mInFlight.front().mFence);
+      mInFlight.pop_front();
+    }
+  }
+
+  size_t OpenGL3UploadRing::Allocate(size_t aSize)
+  {
+    // Keep every allocation 256 byte aligned, drivers like their copies aligned.
+    constexpr size_t alignment = 256;
+    size_t offset = (mHead + alignment - 1) & ~(alignment - 1);
+
+    if (offset + aSize > mCapacity)
+    {
+      offset = 0;
+    }
+
+    auto overlapsInFlight = [this, offset, aSize]()
+    {
+      for (auto& inFlight : mInFlight)
+      {
+        if (offset < (inFlight.mOffset + inFlight.mSize) && inFlight.mOffset < (offset + aSize))
+        {
+          return true;
+        }
+      }
+
+      return false;
+    };
+
+    // Uploads retire in order, so waiting on the oldest until we're clear is always
+    // enough, and usually it has long since finished.
+    while (overlapsInFlight())
+    {
+      RetireOldest();
+    }
+
+    mHead = offset + aSize;
+    return offset;
+  }
+
+  bool OpenGL3UploadRing::UploadRegion(gl::GLuint aTexture, int aLevel, int aX, int aY, int aWidth, int aHeight, unsigned char const* aData, int aPitch)
+  {
+    size_t rowSize = static_cast<size_t>(aWidth) * 4;
+    size_t size = rowSize * static_cast<size_t>(aHeight);
+    if (0 == size || size > mCapacity)
+    {
+      return false;
+    }
+
+    RetireSignalled();
+    size_t offset = Allocate(size);
+
+    gl::glBindBuffer(gl::GL_PIXEL_UNPACK_BUFFER, mBuffer);
+
+    unsigned char* destination = nullptr;
+    if (nullptr != mPersistentMapping)
+    {
+      destination = mPersistentMapping + offset;
+    }
+    else
+    {
+      destination = static_cast<unsigned char*>(gl::glMapBufferRange(gl::GL_PIXEL_UNPACK_BUFFER, offset, size, gl::GL_MAP_WRITE_BIT | gl::GL_MAP_INVALIDATE_RANGE_BIT | gl::GL_MAP_UNSYNCHRONIZED_BIT));
+    }
+
+    if (nullptr == destination)
+    {
+      gl::glBindBuffer(gl::GL_PIXEL_UNPACK_BUFFER, 0);
+      return false;
+    }
+
+    // Repack tightly as we go, so the source pitch doesn't matter to GL.
+    for (int y = 0; y < aHeight; ++y)
+    {
+      memcpy(destination + y * rowSize, aData + static_cast<size_t>(y) * aPitch, rowSize);
+    }
+
+    if (nullptr == mPersistentMapping)
+    {
+      gl::glUnmapBuffer(gl::GL_PIXEL_UNPACK_BUFFER);
+    }
+
+    gl::glBindTexture(gl::GL_TEXTURE_2D, aTexture);
+    gl::glPixelStorei(gl::GL_UNPACK_ROW_LENGTH, 0);
+    gl::glTexSubImage2D(gl::GL_TEXTURE_2D, aLevel, aX, aY, aWidth, aHeight, gl::GL_RGBA, gl::GL_UNSIGNED_BYTE, reinterpret_cast<void const*>(offset));
+    gl::glBindBuffer(gl::GL_PIXEL_UNPACK_BUFFER, 0);
+
+    mInFlight.push_back(InFlight{ offset, size, gl::glFenceSync(gl::GL_SYNC_GPU_COMMANDS_COMPLETE, gl::UnusedMask::GL_NONE_BIT) });
+    return true;
+  }
+}
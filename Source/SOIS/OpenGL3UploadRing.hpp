@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstddef>
+#include <deque>
+
+#include <glbinding/gl/gl.h>
+
+namespace SOIS
+{
+  // Streams texture data through a ring of pixel unpack buffer memory, so texture uploads
+  // are a memcpy into driver visible memory plus an asynchronous glTexSubImage2D rather
+  // than a synchronous copy out of client memory. Each upload is followed by a fence, and
+  // space is only reused once the GPU has signalled it's done reading from it.
+  //
+  // When GL 4.4 or ARB_buffer_storage is available the buffer is persistently mapped,
+  // otherwise each upload maps its range unsynchronized (safe, the fences guard it).
+  class OpenGL3UploadRing
+  {
+  public:
+    OpenGL3UploadRing(size_t aCapacity);
+    ~OpenGL3UploadRing();
+
+    OpenGL3UploadRing(OpenGL3UploadRing const&) = delete;
+    OpenGL3UploadRing& operator=(OpenGL3UploadRing const&) = delete;
+
+    // Needs GL 3.2 or ARB_sync for fences, check this before creating a ring.
+    static bool IsSupported();
+
+    // Uploads an RGBA8 rectangle into level aLevel of aTexture. Returns false without
+    // touching GL if the data can't fit in the ring, the caller should upload directly.
+    bool UploadRegion(gl::GLuint aTexture, int aLevel, int aX, int aY, int aWidth, int aHeight, unsigned char const* aData, int aPitch);
+
+  private:
+    struct InFlight
+    {
+      size_t mOffset;
+      size_t mSize;
+      gl::GLsync mFence;
+    };
+
+    // Returns the offset of aSize free bytes, waiting on the GPU if we've lapped it.
+    size_t Allocate(size_t aSize);
+    void RetireSignalled();
+    void RetireOldest();
+
+    std::deque<InFlight> mInFlight;
+    size_t mCapacity;
+    size_t mHead = 0;
+    gl::GLuint mBuffer = 0;
+    unsigned char* mPersistentMapping = nullptr;
+  };
+}
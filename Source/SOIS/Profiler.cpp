@@ -0,0 +1,395 @@
+#include <algorithm>
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+#include <cstring>
+
+#include "imgui.h"
+
+#include "SOIS/File.hpp"
+#include "SOIS/Hash.hpp"
+#include "SOIS/Profiler.hpp"
+
+namespace SOIS
+{
+  // A few seconds at typical frame rates.
+  static constexpr size_t cFrameHistory = 300;
+
+  // Track id for zones from GPU timer queries.
+  static constexpr int cGpuTrack = -1;
+
+  std::atomic<bool> Profiler::sEnabled = false;
+
+  Profiler& Profiler::Get()
+  {
+    static Profiler profiler;
+    return profiler;
+  }
+
+  void Profiler::SetEnabled(bool aEnabled)
+  {
+    sEnabled = aEnabled;
+  }
+
+  int64_t Profiler::Now()
+  {
+    using namespace std::chrono;
+    return duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count();
+  }
+
+  Profiler::ThreadRing& Profiler::GetThreadRing()
+  {
+    static thread_local ThreadRing* ring = nullptr;
+    if (nullptr != ring)
+    {
+      return *ring;
+    }
+
+    // Rings stay registered after their thread exits, so whatever it recorded still
+    // gets collected. There's only ever a handful of threads.
+    auto created = std::make_shared<ThreadRing>();
+
+    std::unique_lock lock{ mRingsMutex };
+    created->mTrack = static_cast<int>(mRings.size());
+    created->mName = "Thread " + std::to_string(created->mTrack);
+    mRings.emplace_back(created);
+
+    ring = created.get();
+    return *ring;
+  }
+
+  void Profiler::SetThreadName(char const* aName)
+  {
+    ThreadRing& ring = GetThreadRing();
+
+    std::unique_lock lock{ mRingsMutex };
+    ring.mName = aName;
+  }
+
+  void Profiler::Push(ThreadRing& aRing, Zone const& aZone)
+  {
+    uint32_t write = aRing.mWrite.load(std::memory_order_relaxed);
+    uint32_t read = aRing.mRead.load(std::memory_order_acquire);
+
+    if ((write - read) >= ThreadRing::cCapacity)
+    {
+      aRing.mDropped.fetch_add(1, std::memory_order_relaxed);
+      return;
+    }
+
+    aRing.mZones[write % ThreadRing::cCapacity] = aZone;
+    aRing.mWrite.store(write + 1, std::memory_order_release);
+  }
+
+  void Profiler::RecordZone(char const* aName, int64_t aBegin, int64_t aEnd, int aDepth)
+  {
+    ThreadRing& ring = GetThreadRing();
+    Push(ring, Zone{ aName, aBegin, aEnd, aDepth, ring.mTrack });
+  }
+
+  void Profiler::RecordGpuZone(char const* aName, int64_t aBegin, int64_t aEnd)
+  {
+    Push(GetThreadRing(), Zone{ aName, aBegin, aEnd, 0, cGpuTrack });
+  }
+
+  void Profiler::Collect()
+  {
+    std::unique_lock lock{ mRingsMutex };
+
+    for (auto& ring : mRings)
+    {
+      uint32_t read = ring->mRead.load(std::memory_order_relaxed);
+      uint32_t write = ring->mWrite.load(std::memory_order_acquire);
+
+      // Keep draining while paused, otherwise the rings fill up and we lose the first
+      // frames after unpausing.
+      if (false == mPaused)
+      {
+        for (uint32_t i = read; i != write; ++i)
+        {
+          mZones.emplace_back(ring->mZones[i % ThreadRing::cCapacity]);
+        }
+      }
+
+      ring->mRead.store(write, std::memory_order_release);
+    }
+  }
+
+  void Profiler::NewFrame()
+  {
+    if (false == IsEnabled())
+    {
+      mFrameBegin = 0;
+      return;
+    }
+
+    int64_t now = Now();
+    if (0 != mFrameBegin && false == mPaused)
+    {
+      mFrames.emplace_back(Frame{ mFrameBegin, now });
+    }
+
+    mFrameBegin = now;
+    Collect();
+
+    while (mFrames.size() > cFrameHistory)
+    {
+      mFrames.pop_front();
+    }
+
+    // Zones come in roughly in order, good enough for trimming.
+    while (false == mFrames.empty() && false == mZones.empty() && mZones.front().mEnd < mFrames.front().mBegin)
+    {
+      mZones.pop_front();
+    }
+  }
+
+  ////////////////////////////////////////////////////////////////////////////
+  // ProfileZone
+  ////////////////////////////////////////////////////////////////////////////
+  void ProfileZone::Begin(char const* aName)
+  {
+    ++Profiler::Get().GetThreadRing().mDepth;
+    mName = aName;
+    mBegin = Profiler::Now();
+  }
+
+  void ProfileZone::End()
+  {
+    int64_t end = Profiler::Now();
+
+    Profiler& profiler = Profiler::Get();
+    Profiler::ThreadRing& ring = profiler.GetThreadRing();
+    --ring.mDepth;
+    profiler.Push(ring, Profiler::Zone{ mName, mBegin, end, ring.mDepth, ring.mTrack });
+  }
+
+  ////////////////////////////////////////////////////////////////////////////
+  // Overlay
+  ////////////////////////////////////////////////////////////////////////////
+  static ImU32 GetZoneColor(char const* aName)
+  {
+    // Same name, same color, from frame to frame and run to run.
+    uint64_t hash = Hash64(aName, strlen(aName));
+    return IM_COL32(80 + (hash & 0x7F), 80 + ((hash >> 8) & 0x7F), 80 + ((hash >> 16) & 0x7F), 255);
+  }
+
+  void Profiler::DrawWindow(bool* aOpen)
+  {
+    if (false == ImGui::Begin("Profiler", aOpen))
+    {
+      ImGui::End();
+      return;
+    }
+
+    if (false == IsEnabled())
+    {
+      ImGui::TextUnformatted("Profiling is off.");
+      if (ImGui::Button("Turn on"))
+      {
+        SetEnabled(true);
+      }
+
+      ImGui::End();
+      return;
+    }
+
+    mFrameTimes.clear();
+    float total = 0.f;
+    float worst = 0.f;
+    for (Frame const& frame : mFrames)
+    {
+      float milliseconds = (frame.mEnd - frame.mBegin) / 1000000.f;
+      mFrameTimes.emplace_back(milliseconds);
+      total += milliseconds;
+      worst = std::max(worst, milliseconds);
+    }
+
+    if (mFrameTimes.empty())
+    {
+      ImGui::TextUnformatted("Waiting on frames...");
+      ImGui::End();
+      return;
+    }
+
+    ImGui::Text("Last %.2f ms, average %.2f ms, worst %.2f ms", mFrameTimes.back(), total / mFrameTimes.size(), worst);
+
+    uint32_t dropped = 0;
+    {
+      std::unique_lock lock{ mRingsMutex };
+      for (auto& ring : mRings)
+      {
+        dropped += ring->mDropped.load(std::memory_order_relaxed);
+      }
+    }
+
+    if (0 != dropped)
+    {
+      ImGui::Text("%u zones dropped, a thread recorded more than fits between frames.", dropped);
+    }
+
+    ImGui::Checkbox("Pause", &mPaused);
+    ImGui::SameLine();
+    if (ImGui::Button("Export Chrome trace"))
+    {
+      ExportChromeTrace(u8"SOIS_Trace.json");
+    }
+
+    ImGui::PlotHistogram("##FrameTimes", mFrameTimes.data(), static_cast<int>(mFrameTimes.size()), 0, nullptr, 0.f, worst, ImVec2(ImGui::GetContentRegionAvail().x, 60.f));
+
+    // Live, we follow the latest frame. Paused, pick any of them.
+    int last = static_cast<int>(mFrames.size()) - 1;
+    if (mPaused)
+    {
+      mSelectedFrame = std::clamp(mSelectedFrame < 0 ? last : mSelectedFrame, 0, last);
+      ImGui::SliderInt("Frame", &mSelectedFrame, 0, last);
+    }
+    else
+    {
+      mSelectedFrame = -1;
+    }
+
+    ImGui::Separator();
+    DrawFlameGraph(mFrames[mSelectedFrame < 0 ? last : mSelectedFrame]);
+
+    ImGui::End();
+  }
+
+  void Profiler::DrawFlameGraph(Frame const& aFrame)
+  {
+    ImDrawList* drawList = ImGui::GetWindowDrawList();
+    ImVec2 origin = ImGui::GetCursorScreenPos();
+    float width = std::max(1.f, ImGui::GetContentRegionAvail().x);
+    float rowHeight = ImGui::CalcTextSize("A").y + 4.f;
+    int64_t length = std::max<int64_t>(1, aFrame.mEnd - aFrame.mBegin);
+    float scale = width / static_cast<float>(length);
+    ImU32 textColor = ImGui::GetColorU32(ImGuiCol_Text);
+
+    std::vector<std::pair<int, std::string>> tracks;
+    {
+      std::unique_lock lock{ mRingsMutex };
+      for (auto& ring : mRings)
+      {
+        tracks.emplace_back(ring->mTrack, ring->mName);
+      }
+    }
+
+    tracks.emplace_back(cGpuTrack, "GPU");
+
+    float y = origin.y;
+    for (auto& [track, name] : tracks)
+    {
+      bool labelled = false;
+      int deepest = 0;
+
+      for (Zone const& zone : mZones)
+      {
+        if (zone.mTrack != track || zone.mEnd <= aFrame.mBegin || zone.mBegin >= aFrame.mEnd)
+        {
+          continue;
+        }
+
+        // Threads that did nothing this frame don't get a row.
+        if (false == labelled)
+        {
+          labelled = true;
+          drawList->AddText(ImVec2(origin.x, y), textColor, name.c_str());
+          y += rowHeight;
+        }
+
+        float x1 = origin.x + std::max<int64_t>(0, zone.mBegin - aFrame.mBegin) * scale;
+        float x2 = origin.x + std::min(length, zone.mEnd - aFrame.mBegin) * scale;
+        x2 = std::max(x1 + 1.f, x2);
+
+        ImVec2 min = ImVec2(x1, y + zone.mDepth * rowHeight);
+        ImVec2 max = ImVec2(x2, min.y + rowHeight - 1.f);
+        drawList->AddRectFilled(min, max, GetZoneColor(zone.mName));
+
+        if ((x2 - x1) > 8.f)
+        {
+          drawList->PushClipRect(min, max, true);
+          drawList->AddText(ImVec2(x1 + 2.f, min.y + 2.f), IM_COL32(0, 0, 0, 255), zone.mName);
+          drawList->PopClipRect();
+        }
+
+        if (ImGui::IsMouseHoveringRect(min, max))
+        {
+          ImGui::SetTooltip("%s\n%.3f ms", zone.mName, (zone.mEnd - zone.mBegin) / 1000000.0);
+        }
+
+        deepest = std::max(deepest, zone.mDepth);
+      }
+
+      if (labelled)
+      {
+        y += (deepest + 1) * rowHeight + 4.f;
+      }
+    }
+
+    ImGui::Dummy(ImVec2(width, std::max(rowHeight, y - origin.y)));
+  }
+
+  ////////////////////////////////////////////////////////////////////////////
+  // Export
+  ////////////////////////////////////////////////////////////////////////////
+  static void AppendEscaped(std::string& aJson, char const* aText)
+  {
+    for (; '\0' != *aText; ++aText)
+    {
+      if ('"' == *aText || '\\' == *aText)
+      {
+        aJson += '\\';
+      }
+
+      aJson += *aText;
+    }
+  }
+
+  bool Profiler::ExportChromeTrace(std::u8string const& aFile)
+  {
+    // Chrome sorts tracks by id, put the GPU after the threads.
+    auto getTid = [](int aTrack)
+    {
+      return (cGpuTrack == aTrack) ? 1000 : aTrack + 1;
+    };
+
+    std::string json = "{\"traceEvents\":[\n";
+    char buffer[256];
+
+    {
+      std::unique_lock lock{ mRingsMutex };
+      for (auto& ring : mRings)
+      {
+        snprintf(buffer, sizeof(buffer), "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"", getTid(ring->mTrack));
+        json += buffer;
+        AppendEscaped(json, ring->mName.c_str());
+        json += "\"}},\n";
+      }
+    }
+
+    snprintf(buffer, sizeof(buffer), "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"GPU\"}}", getTid(cGpuTrack));
+    json += buffer;
+
+    // Timestamps are in microseconds, relative to the start of the history.
+    int64_t origin = mFrames.empty() ? 0 : mFrames.front().mBegin;
+
+    for (Frame const& frame : mFrames)
+    {
+      snprintf(buffer, sizeof(buffer), ",\n{\"name\":\"Frame\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":0}",
+        (frame.mBegin - origin) / 1000.0, (frame.mEnd - frame.mBegin) / 1000.0);
+      json += buffer;
+    }
+
+    for (Zone const& zone : mZones)
+    {
+      json += ",\n{\"name\":\"";
+      AppendEscaped(json, zone.mName);
+      snprintf(buffer, sizeof(buffer), "\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":%d}",
+        (zone.mBegin - origin) / 1000.0, (zone.mEnd - zone.mBegin) / 1000.0, getTid(zone.mTrack));
+      json += buffer;
+    }
+
+    json += "\n]}\n";
+    return WriteFileAtomic(aFile, nullptr, 0, json.data(), json.size());
+  }
+}
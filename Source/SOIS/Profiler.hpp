@@ -0,0 +1,141 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace SOIS
+{
+  // Times a scope, see Profiler. aName has to outlive the profiler, use string literals.
+  #define SOIS_PROFILE_SCOPE_CONCAT_INNER(aLeft, aRight) aLeft##aRight
+  #define SOIS_PROFILE_SCOPE_CONCAT(aLeft, aRight) SOIS_PROFILE_SCOPE_CONCAT_INNER(aLeft, aRight)
+  #define SOIS_PROFILE_SCOPE(aName) ::SOIS::ProfileZone SOIS_PROFILE_SCOPE_CONCAT(profileZone, __LINE__){ aName }
+
+  // Collects timed zones from any thread, and keeps the last few seconds of frames
+  // around to look at with DrawWindow or export with ExportChromeTrace. Zones cost an
+  // atomic load when the profiler is off, and two clock reads and a write into a ring
+  // owned by the thread when it's on, no locks or allocations.
+  class Profiler
+  {
+  public:
+    static Profiler& Get();
+
+    static bool IsEnabled()
+    {
+      return sEnabled.load(std::memory_order_relaxed);
+    }
+
+    void SetEnabled(bool aEnabled);
+
+    // Nanoseconds on the clock zones are recorded with.
+    static int64_t Now();
+
+    // Shows up in the overlay and trace instead of "Thread N". Call on the thread.
+    void SetThreadName(char const* aName);
+
+    // Called on the main thread at the start of every frame, collects what other threads
+    // recorded and starts a new frame.
+    void NewFrame();
+
+    // Records a zone on the calling thread's track, for when RAII doesn't fit.
+    void RecordZone(char const* aName, int64_t aBegin, int64_t aEnd, int aDepth = 0);
+
+    // GPU timings go on their own track, aBegin and aEnd already converted to Now's clock.
+    void RecordGpuZone(char const* aName, int64_t aBegin, int64_t aEnd);
+
+    // Frame times and a flame graph of a frame, as an ImGui window.
+    void DrawWindow(bool* aOpen = nullptr);
+
+    // Everything in the history, in the Chrome trace event format (chrome://tracing,
+    // Perfetto, Speedscope). Returns false if the file couldn't be written.
+    bool ExportChromeTrace(std::u8string const& aFile);
+
+  private:
+    friend class ProfileZone;
+
+    Profiler() = default;
+
+    struct Zone
+    {
+      char const* mName;
+      int64_t mBegin;
+      int64_t mEnd;
+      int mDepth;
+      int mTrack;
+    };
+
+    // Single producer (the thread), single consumer (NewFrame). Full rings drop zones
+    // rather than block.
+    struct ThreadRing
+    {
+      static constexpr uint32_t cCapacity = 4096;
+
+      std::array<Zone, cCapacity> mZones;
+      std::atomic<uint32_t> mWrite = 0;
+      std::atomic<uint32_t> mRead = 0;
+      std::atomic<uint32_t> mDropped = 0;
+      std::string mName;
+      int mTrack = 0;
+      int mDepth = 0;
+    };
+
+    struct Frame
+    {
+      int64_t mBegin;
+      int64_t mEnd;
+    };
+
+    ThreadRing& GetThreadRing();
+    void Push(ThreadRing& aRing, Zone const& aZone);
+    void Collect();
+    void DrawFlameGraph(Frame const& aFrame);
+
+    static std::atomic<bool> sEnabled;
+
+    std::mutex mRingsMutex;
+    std::vector<std::shared_ptr<ThreadRing>> mRings;
+
+    // Only touched by the main thread.
+    std::deque<Zone> mZones;
+    std::deque<Frame> mFrames;
+    std::vector<float> mFrameTimes;
+    int64_t mFrameBegin = 0;
+    bool mPaused = false;
+    int mSelectedFrame = -1;
+  };
+
+  class ProfileZone
+  {
+  public:
+    ProfileZone(char const* aName)
+    {
+      if (Profiler::IsEnabled())
+      {
+        Begin(aName);
+      }
+    }
+
+    ~ProfileZone()
+    {
+      if (nullptr != mName)
+      {
+        End();
+      }
+    }
+
+    ProfileZone(ProfileZone const&) = delete;
+    ProfileZone& operator=(ProfileZone const&) = delete;
+
+  private:
+    void Begin(char const* aName);
+    void End();
+
+    char const* mName = nullptr;
+    int64_t mBegin = 0;
+  };
+}
@@ -0,0 +1,123 @@
+#include "SOIS/Renderer.hpp"
+#include "SOIS/RenderThread.hpp"
+
+namespace SOIS
+{
+  ////////////////////////////////////////////////////////////////////////////
+  // DrawDataSnapshot
+  ////////////////////////////////////////////////////////////////////////////
+  DrawDataSnapshot::~DrawDataSnapshot()
+  {
+    for (ImDrawList* list : mLists)
+    {
+      IM_DELETE(list);
+    }
+  }
+
+  void DrawDataSnapshot::Capture(ImDrawData const* aDrawData)
+  {
+    if (nullptr == aDrawData || false == aDrawData->Valid)
+    {
+      mDrawData.Valid = false;
+      return;
+    }
+
+    // We only ever copy into these, never draw with them, so they don't need ImGui's
+    // shared draw list data.
+    while (mLists.size() < static_cast<size_t>(aDrawData->CmdListsCount))
+    {
+      mLists.emplace_back(IM_NEW(ImDrawList)(nullptr));
+    }
+
+    for (int n = 0; n < aDrawData->CmdListsCount; ++n)
+    {
+      ImDrawList const* source = aDrawData->CmdLists[n];
+      ImDrawList* list = mLists[n];
+      list->CmdBuffer = source->CmdBuffer;
+      list->IdxBuffer = source->IdxBuffer;
+      list->VtxBuffer = source->VtxBuffer;
+      list->Flags = source->Flags;
+    }
+
+    mDrawData = *aDrawData;
+    mDrawData.CmdLists = mLists.data();
+  }
+
+  ////////////////////////////////////////////////////////////////////////////
+  // RenderThread
+  ////////////////////////////////////////////////////////////////////////////
+  RenderThread::RenderThread(Renderer* aRenderer)
+    : mRenderer{ aRenderer }
+  {
+    mThread = std::thread([this]()
+    {
+      Run();
+    });
+  }
+
+  RenderThread::~RenderThread()
+  {
+    {
+      std::unique_lock lock{ mMutex };
+      mStopping = true;
+    }
+
+    mCondition.notify_all();
+    mThread.join();
+
+    // Nothing's in flight anymore, let whatever was waiting on the last frame go.
+    mRenderer->GetInFlightFrames()->Rendered();
+  }
+
+  void RenderThread::Submit(ImDrawData const* aDrawData)
+  {
+    std::unique_lock lock{ mMutex };
+    mCondition.wait(lock, [this]() { return false == mFramePending; });
+
+    // The render thread is waiting on us, so the snapshot and renderer are ours to touch.
+    // The last frame is done with, so deferred texture deletes and writes can go ahead
+    // before this frame's fence.
+    InFlightFrames& frames = *mRenderer->GetInFlightFrames();
+    frames.Rendered();
+
+    mSnapshot.Capture(aDrawData);
+    mRenderer->SubmitFrame(aDrawData);
+    frames.Submitted();
+    mFramePending = true;
+
+    lock.unlock();
+    mCondition.notify_all();
+  }
+
+  void RenderThread::WaitForIdle()
+  {
+    std::unique_lock lock{ mMutex };
+    mCondition.wait(lock, [this]() { return false == mFramePending; });
+    mRenderer->GetInFlightFrames()->Rendered();
+  }
+
+  void RenderThread::Run()
+  {
+    while (true)
+    {
+      std::unique_lock lock{ mMutex };
+      mCondition.wait(lock, [this]() { return mFramePending || mStopping; });
+
+      // Finish the frame we were given before stopping, it's already been paid for.
+      if (false == mFramePending)
+      {
+        break;
+      }
+
+      lock.unlock();
+      mRenderer->RenderFrame(mSnapshot.GetDrawData());
+      lock.lock();
+
+      mFramePending = false;
+      lock.unlock();
+      mCondition.notify_all();
+    }
+
+    mRenderer->DisableRenderThread();
+  }
+}
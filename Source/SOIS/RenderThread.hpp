@@ -0,0 +1,68 @@
+#pragma once
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "imgui.h"
+
+namespace SOIS
+{
+  class Renderer;
+
+  // Deep copy of an ImDrawData, so it can be rendered while ImGui builds the next frame.
+  // The draw lists are kept between captures, so once they've grown to fit a typical
+  // frame capturing is just copying.
+  class DrawDataSnapshot
+  {
+  public:
+    DrawDataSnapshot() = default;
+    ~DrawDataSnapshot();
+
+    DrawDataSnapshot(DrawDataSnapshot const&) = delete;
+    DrawDataSnapshot& operator=(DrawDataSnapshot const&) = delete;
+
+    void Capture(ImDrawData const* aDrawData);
+
+    // nullptr if the captured draw data wasn't valid.
+    ImDrawData* GetDrawData()
+    {
+      return mDrawData.Valid ? &mDrawData : nullptr;
+    }
+
+  private:
+    ImDrawData mDrawData;
+    std::vector<ImDrawList*> mLists;
+  };
+
+  // Runs Renderer::RenderFrame on its own thread, so the main thread can handle events
+  // and build the next frame while this one is drawn and waits on vsync. One frame is
+  // in flight at most, Submit waits for the last one to finish.
+  class RenderThread
+  {
+  public:
+    // aRenderer must have returned true from EnableRenderThread.
+    RenderThread(Renderer* aRenderer);
+    ~RenderThread();
+
+    RenderThread(RenderThread const&) = delete;
+    RenderThread& operator=(RenderThread const&) = delete;
+
+    void Submit(ImDrawData const* aDrawData);
+
+    // Blocks until the frame in flight, if any, has been presented.
+    void WaitForIdle();
+
+  private:
+    void Run();
+
+    Renderer* mRenderer;
+    DrawDataSnapshot mSnapshot;
+    std::mutex mMutex;
+    std::condition_variable mCondition;
+    bool mFramePending = false;
+    bool mStopping = false;
+    std::thread mThread;
+  };
+}
@@ -1 +1,608 @@
-#include "Renderer.hpp"
+#include <algorithm>
+#include <cfloat>
+#include <cstring>
+#include <thread>
+
+#include "imgui.h"
+
+#include "SOIS/File.hpp"
+#include "SOIS/Hash.hpp"
+#include "SOIS/Image.hpp"
+#include "SOIS/Profiler.hpp"
+#include "SOIS/Renderer.hpp"
+#include "SOIS/TextureAtlas.hpp"
+#include "SOIS/TextureCache.hpp"
+#include "SOIS/TextureCompression.hpp"
+#include "SOIS/TextureMips.hpp"
+#include "SOIS/ThreadPool.hpp"
+
+namespace SOIS
+{
+  Renderer::Renderer()
+    : mUploadQueue{ std::make_shared<UploadQueue>() }
+    , mInFlightFrames{ std::make_shared<InFlightFrames>() }
+  {
+  }
+
+  Renderer::~Renderer()
+  {
+    // Joins the loaders before anything they could be handing results to goes away.
+    mLoaderPool.reset();
+  }
+
+  // Converts freshly decoded RGBA8 pixels into the layout asked for in aOptions.
+  static void ApplyLoadOptions(Image& aImage, TextureLoadOptions const& aOptions, ThreadPool* aPool)
+  {
+    if (aOptions.GenerateMips && IsBlockCompressed(aOptions.Layout))
+    {
+      // GPUs can't generate mips for compressed textures, so the chain is built here
+      // from the RGBA8 source, before it loses quality to compression.
+      aImage.Pixels = GenerateMipChain(aImage.Pixels.data(), aImage.Width, aImage.Height, aImage.Pitch(), aOptions.Layout, aPool);
+      aImage.Layout = aOptions.Layout;
+      aImage.MipLevels = GetMipLevelCount(aImage.Width, aImage.Height);
+      return;
+    }
+
+    if (aOptions.GenerateMips)
+    {
+      aImage.MipLevels = cGenerateMips;
+    }
+
+    if (IsBlockCompressed(aOptions.Layout))
+    {
+      aImage.Pixels = CompressTexture(aImage.Pixels.data(), aImage.Width, aImage.Height, aImage.Pitch(), aOptions.Layout, aPool);
+      aImage.Layout = aOptions.Layout;
+    }
+    else if (TextureLayout::RGBA_Srgb == aOptions.Layout)
+    {
+      aImage.Layout = aOptions.Layout;
+    }
+  }
+
+  // Everything a file load does before touching the renderer, so it can run on any thread.
+  static std::optional<Image> LoadImage(std::u8string const& aFile, TextureLoadOptions const& aOptions, TextureCache const* aCache, ThreadPool* aPool)
+  {
+    SOIS_PROFILE_SCOPE("LoadImage");
+
+    if (nullptr == aCache)
+    {
+      auto image = DecodeImageFile(aFile);
+      if (image)
+      {
+        ApplyLoadOptions(*image, aOptions, aPool);
+      }
+
+      return image;
+    }
+
+    // Hashing the source is far cheaper than decoding it, and unlike timestamps it
+    // can't be fooled by copies or checkouts.
+    auto source = MappedFile::Open(aFile);
+    if (!source)
+    {
+      return std::nullopt;
+    }
+
+    uint64_t key = TextureCache::MakeKey(source->GetData(), source->GetSize(), aOptions);
+    if (auto cached = aCache->Load(key))
+    {
+      return cached;
+    }
+
+    auto image = DecodeImageFromMemory(source->GetData(), source->GetSize());
+    if (image)
+    {
+      ApplyLoadOptions(*image, aOptions, aPool);
+      aCache->Store(key, *image);
+    }
+
+    return image;
+  }
+
+  void Renderer::SetTextureCacheDirectory(std::u8string const& aDirectory)
+  {
+    // Loads already in flight keep whatever cache they started with.
+    mTextureCache = aDirectory.empty() ? nullptr : std::make_shared<TextureCache>(aDirectory);
+  }
+
+  ThreadPool& Renderer::GetLoaderPool()
+  {
+    if (nullptr == mLoaderPool)
+    {
+      // Leave some room for the UI thread and anything else the app is doing.
+      mLoaderPool = std::make_unique<ThreadPool>(std::max(1u, std::thread::hardware_concurrency() / 2));
+    }
+
+    return *mLoaderPool;
+  }
+
+  TextureAtlas& Renderer::GetTextureAtlas()
+  {
+    if (nullptr == mTextureAtlas)
+    {
+      mTextureAtlas = std::make_unique<TextureAtlas>(this);
+    }
+
+    return *mTextureAtlas;
+  }
+
+  void Renderer::MergeDrawCommands(ImDrawData* aDrawData)
+  {
+    if (nullptr == aDrawData)
+    {
+      return;
+    }
+
+    for (int n = 0; n < aDrawData->CmdListsCount; ++n)
+    {
+      ImVector<ImDrawCmd>& commands = aDrawData->CmdLists[n]->CmdBuffer;
+      int merged = 0;
+
+      for (int i = 0; i < commands.Size; ++i)
+      {
+        ImDrawCmd const& command = commands[i];
+
+        if (0 == command.ElemCount && nullptr == command.UserCallback)
+        {
+          continue;
+        }
+
+        if (merged > 0)
+        {
+          ImDrawCmd& previous = commands[merged - 1];
+          if (nullptr == previous.UserCallback &&
+              nullptr == command.UserCallback &&
+              previous.TextureId == command.TextureId &&
+              previous.VtxOffset == command.VtxOffset &&
+              (previous.IdxOffset + previous.ElemCount) == command.IdxOffset &&
+              0 == memcmp(&previous.ClipRect, &command.ClipRect, sizeof(ImVec4)))
+          {
+            previous.ElemCount += command.ElemCount;
+            continue;
+          }
+        }
+
+        commands[merged++] = command;
+      }
+
+      commands.resize(merged);
+    }
+  }
+
+  uint64_t Renderer::HashDrawData(ImDrawData const* aDrawData)
+  {
+    if (nullptr == aDrawData)
+    {
+      return 0;
+    }
+
+    uint64_t hash = Hash64(&aDrawData->DisplayPos, sizeof(ImVec2));
+    hash = Hash64(&aDrawData->DisplaySize, sizeof(ImVec2), hash);
+    hash = Hash64(&aDrawData->FramebufferScale, sizeof(ImVec2), hash);
+    hash = HashCombine(hash, aDrawData->CmdListsCount);
+
+    for (int n = 0; n < aDrawData->CmdListsCount; ++n)
+    {
+      hash = HashCombine(hash, HashDrawList(aDrawData->CmdLists[n]));
+    }
+
+    return hash;
+  }
+
+  uint64_t Renderer::HashDrawList(ImDrawList const* aDrawList)
+  {
+    uint64_t hash = Hash64(aDrawList->VtxBuffer.Data, aDrawList->VtxBuffer.size_in_bytes());
+    hash = Hash64(aDrawList->IdxBuffer.Data, aDrawList->IdxBuffer.size_in_bytes(), hash);
+
+    // Field by field, ImDrawCmd has padding we can't trust to be zeroed.
+    for (ImDrawCmd const& command : aDrawList->CmdBuffer)
+    {
+      hash = Hash64(&command.ClipRect, sizeof(ImVec4), hash);
+      hash = HashCombine(hash, reinterpret_cast<uintptr_t>(command.TextureId));
+      hash = HashCombine(hash, command.VtxOffset);
+      hash = HashCombine(hash, command.IdxOffset);
+      hash = HashCombine(hash, command.ElemCount);
+      hash = HashCombine(hash, reinterpret_cast<uintptr_t>(command.UserCallback));
+      hash = HashCombine(hash, reinterpret_cast<uintptr_t>(command.UserCallbackData));
+    }
+
+    return hash;
+  }
+
+  ////////////////////////////////////////////////////////////////////////////
+  // Damage
+  ////////////////////////////////////////////////////////////////////////////
+  static const glm::vec4 cNoDamage = { FLT_MAX, FLT_MAX, -FLT_MAX, -FLT_MAX };
+
+  static bool IsEmpty(glm::vec4 const& aRect)
+  {
+    return aRect.z <= aRect.x || aRect.w <= aRect.y;
+  }
+
+  static void AddDamage(glm::vec4& aDamage, glm::vec4 const& aRect)
+  {
+    if (IsEmpty(aRect))
+    {
+      return;
+    }
+
+    aDamage = { std::min(aDamage.x, aRect.x), std::min(aDamage.y, aRect.y), std::max(aDamage.z, aRect.z), std::max(aDamage.w, aRect.w) };
+  }
+
+  static glm::vec4 Intersect(glm::vec4 const& aLeft, glm::vec4 const& aRight)
+  {
+    return { std::max(aLeft.x, aRight.x), std::max(aLeft.y, aRight.y), std::min(aLeft.z, aRight.z), std::min(aLeft.w, aRight.w) };
+  }
+
+  // Everything a draw list could have touched, the triangles can't leave their vertices' box.
+  static glm::vec4 GetDrawListBounds(ImDrawList const* aDrawList, glm::vec4 const& aDisplay)
+  {
+    glm::vec4 bounds = cNoDamage;
+    for (ImDrawVert const& vertex : aDrawList->VtxBuffer)
+    {
+      bounds = { std::min(bounds.x, vertex.pos.x), std::min(bounds.y, vertex.pos.y), std::max(bounds.z, vertex.pos.x), std::max(bounds.w, vertex.pos.y) };
+    }
+
+    // Antialiasing can bleed into the pixels we'd round away.
+    return Intersect(glm::vec4{ bounds.x - 1.f, bounds.y - 1.f, bounds.z + 1.f, bounds.w + 1.f }, aDisplay);
+  }
+
+  void Renderer::TextureContentsChanged(Texture* aTexture)
+  {
+    aTexture->HasUpdates = true;
+    ++mTextureContentVersion;
+
+    void* id = aTexture->GetTextureId();
+    if (mUpdatedTextures.end() == std::find(mUpdatedTextures.begin(), mUpdatedTextures.end(), id))
+    {
+      mUpdatedTextures.emplace_back(id);
+    }
+  }
+
+  bool Renderer::ComputeDamage(ImDrawData const* aDrawData, glm::vec4& aDamage)
+  {
+    glm::vec4 display = { aDrawData->DisplayPos.x, aDrawData->DisplayPos.y, aDrawData->DisplayPos.x + aDrawData->DisplaySize.x, aDrawData->DisplayPos.y + aDrawData->DisplaySize.y };
+
+    std::vector<DrawListState> states;
+    states.reserve(aDrawData->CmdListsCount);
+    std::vector<bool> matched(mDrawListStates.size(), false);
+    aDamage = cNoDamage;
+
+    for (int n = 0; n < aDrawData->CmdListsCount; ++n)
+    {
+      ImDrawList const* list = aDrawData->CmdLists[n];
+      DrawListState& state = states.emplace_back(DrawListState{ list, HashDrawList(list), GetDrawListBounds(list, display) });
+
+      // Windows keep their draw list from frame to frame, so the pointer identifies them.
+      auto previous = std::find_if(mDrawListStates.begin(), mDrawListStates.end(), [list](DrawListState const& aState)
+      {
+        return aState.mList == list;
+      });
+
+      if (mDrawListStates.end() == previous)
+      {
+        AddDamage(aDamage, state.mBounds);
+        continue;
+      }
+
+      size_t index = previous - mDrawListStates.begin();
+      matched[index] = true;
+
+      // Moving in the draw order (a window coming to the front) changes what overlaps it.
+      if (previous->mHash != state.mHash || index != static_cast<size_t>(n))
+      {
+        AddDamage(aDamage, previous->mBounds);
+        AddDamage(aDamage, state.mBounds);
+        continue;
+      }
+
+      // Same commands, but a texture they draw with may have new contents.
+      for (ImDrawCmd const& command : list->CmdBuffer)
+      {
+        if (mUpdatedTextures.end() != std::find(mUpdatedTextures.begin(), mUpdatedTextures.end(), command.TextureId))
+        {
+          AddDamage(aDamage, Intersect(glm::vec4{ command.ClipRect.x, command.ClipRect.y, command.ClipRect.z, command.ClipRect.w }, state.mBounds));
+        }
+      }
+    }
+
+    // Whatever went away leaves a hole behind.
+    for (size_t i = 0; i < mDrawListStates.size(); ++i)
+    {
+      if (false == matched[i])
+      {
+        AddDamage(aDamage, mDrawListStates[i].mBounds);
+      }
+    }
+
+    mDrawListStates = std::move(states);
+    mUpdatedTextures.clear();
+    return !IsEmpty(aDamage);
+  }
+
+  void Renderer::ClipDrawData(ImDrawData* aDrawData, glm::vec4 const& aDamage)
+  {
+    for (int n = 0; n < aDrawData->CmdListsCount; ++n)
+    {
+      for (ImDrawCmd& command : aDrawData->CmdLists[n]->CmdBuffer)
+      {
+        glm::vec4 clip = Intersect(glm::vec4{ command.ClipRect.x, command.ClipRect.y, command.ClipRect.z, command.ClipRect.w }, aDamage);
+        if (IsEmpty(clip))
+        {
+          // Callbacks still run, they may be setting state for what comes after.
+          command.ElemCount = 0;
+          continue;
+        }
+
+        command.ClipRect = ImVec4{ clip.x, clip.y, clip.z, clip.w };
+      }
+    }
+  }
+
+  std::unique_ptr<Texture> Renderer::LoadTextureFromFile(std::u8string const& aFile, TextureLoadOptions const& aOptions)
+  {
+    auto image = LoadImage(aFile, aOptions, mTextureCache.get(), &GetLoaderPool());
+    if (!image)
+    {
+      return nullptr;
+    }
+
+    return LoadTextureFromData(image->Pixels.data(), image->Layout, image->Width, image->Height, image->Pitch(), image->MipLevels);
+  }
+
+  std::shared_ptr<AsyncTexture> Renderer::LoadTextureFromFileAsync(std::u8string const& aFile, TextureLoadOptions const& aOptions)
+  {
+    if (nullptr == mPlaceholderTexture)
+    {
+      unsigned char gray[4] = { 128, 128, 128, 255 };
+      mPlaceholderTexture = LoadTextureFromData(gray, TextureLayout::RGBA_Unorm, 1, 1, 4);
+    }
+
+    auto handle = std::make_shared<AsyncTexture>();
+    handle->mPlaceholder = mPlaceholderTexture;
+
+    std::weak_ptr<AsyncTexture> weakHandle = handle;
+    GetLoaderPool().Submit([queue = mUploadQueue, cache = mTextureCache, weakHandle, file = aFile, options = aOptions]()
+    {
+      // Nobody's waiting on this anymore, don't bother decoding it.
+      if (weakHandle.expired())
+      {
+        return;
+      }
+
+      DecodedTexture decoded;
+      decoded.mHandle = weakHandle;
+
+      // Other loads are keeping the rest of the pool busy, so compress on this thread.
+      if (auto image = LoadImage(file, options, cache.get(), nullptr))
+      {
+        decoded.mImage = std::make_unique<Image>(std::move(*image));
+      }
+
+      std::unique_lock lock{ queue->mMutex };
+      queue->mDecoded.emplace_back(std::move(decoded));
+    });
+
+    return handle;
+  }
+
+  void Renderer::ProcessAsyncTextureUploads()
+  {
+    SOIS_PROFILE_SCOPE("ProcessAsyncTextureUploads");
+    auto start = std::chrono::steady_clock::now();
+
+    while (true)
+    {
+      DecodedTexture decoded;
+      {
+        std::unique_lock lock{ mUploadQueue->mMutex };
+        if (mUploadQueue->mDecoded.empty())
+        {
+          return;
+        }
+
+        decoded = std::move(mUploadQueue->mDecoded.front());
+        mUploadQueue->mDecoded.pop_front();
+      }
+
+      auto handle = decoded.mHandle.lock();
+      if (nullptr == handle)
+      {
+        continue;
+      }
+
+      if (nullptr != decoded.mImage)
+      {
+        Image& image = *decoded.mImage;
+        handle->mTexture = LoadTextureFromData(image.Pixels.data(), image.Layout, image.Width, image.Height, image.Pitch(), image.MipLevels);
+      }
+
+      handle->mStatus = handle->mTexture ? TextureLoadStatus::Ready : TextureLoadStatus::Failed;
+
+      if ((std::chrono::steady_clock::now() - start) >= mUploadBudget)
+      {
+        return;
+      }
+    }
+  }
+
+  ////////////////////////////////////////////////////////////////////////////
+  // InFlightFrames
+  ////////////////////////////////////////////////////////////////////////////
+  void InFlightFrames::Defer(std::function<void()> aWork)
+  {
+    if (IsIdle())
+    {
+      aWork();
+      return;
+    }
+
+    mDeferred.emplace_back(DeferredWork{ mSubmitted, std::move(aWork) });
+  }
+
+  void InFlightFrames::Submitted()
+  {
+    ++mSubmitted;
+  }
+
+  void InFlightFrames::Rendered()
+  {
+    mRendered = mSubmitted;
+
+    while (false == mDeferred.empty() && mDeferred.front().mFrame <= mRendered)
+    {
+      auto work = std::move(mDeferred.front().mWork);
+      mDeferred.pop_front();
+      work();
+    }
+  }
+
+  ////////////////////////////////////////////////////////////////////////////
+  // Residency
+  ////////////////////////////////////////////////////////////////////////////
+  ResidentTexture::~ResidentTexture()
+  {
+  }
+
+  void ResidentTexture::SetTexture(std::unique_ptr<Texture> aTexture)
+  {
+    mTexture = std::move(aTexture);
+    if (nullptr == mTexture)
+    {
+      return;
+    }
+
+    mMemorySize = mTexture->GetMemorySize();
+  }
+
+  Texture* ResidentTexture::GetTexture()
+  {
+    mLastUsedFrame = mRenderer->mFrame;
+
+    if (nullptr != mTexture)
+    {
+      return mTexture.get();
+    }
+
+    if (nullptr != mImage)
+    {
+      SetTexture(mRenderer->LoadTextureFromData(mImage->Pixels.data(), mImage->Layout, mImage->Width, mImage->Height, mImage->Pitch(), mImage->MipLevels));
+      return mTexture.get();
+    }
+
+    if (nullptr == mReload)
+    {
+      mReload = mRenderer->LoadTextureFromFileAsync(mFile, mOptions);
+    }
+
+    // A failed load keeps its handle, so we don't hit the disk again every frame.
+    if (mReload->IsReady())
+    {
+      SetTexture(mReload->TakeTexture());
+      mReload.reset();
+      return mTexture.get();
+    }
+
+    return mReload->GetTexture();
+  }
+
+  std::shared_ptr<ResidentTexture> Renderer::LoadResidentTextureFromData(unsigned char const* aData, TextureLayout aLayout, int aWidth, int aHeight, int aPitch, int aMipLevels)
+  {
+    auto image = std::make_unique<Image>();
+    image->Width = aWidth;
+    image->Height = aHeight;
+    image->Layout = aLayout;
+    image->MipLevels = aMipLevels;
+
+    // Level 0 may be padded, anything after it is already tightly packed.
+    int rows = IsBlockCompressed(aLayout) ? (aHeight + 3) / 4 : aHeight;
+    int rowPitch = image->Pitch();
+    size_t levelSize = GetTextureDataSize(aLayout, aWidth, aHeight);
+    size_t chainSize = GetMipOffset(aLayout, aWidth, aHeight, std::max(1, aMipLevels));
+
+    image->Pixels.resize(chainSize);
+    for (int row = 0; row < rows; ++row)
+    {
+      memcpy(image->Pixels.data() + static_cast<size_t>(row) * rowPitch, aData + static_cast<size_t>(row) * aPitch, rowPitch);
+    }
+
+    aData += static_cast<size_t>(rows) * aPitch;
+    memcpy(image->Pixels.data() + levelSize, aData, chainSize - levelSize);
+
+    auto texture = std::make_shared<ResidentTexture>();
+    texture->mRenderer = this;
+    texture->mLastUsedFrame = mFrame;
+    texture->mImage = std::move(image);
+    texture->GetTexture();
+
+    mResidentTextures.emplace_back(texture);
+    return texture;
+  }
+
+  std::shared_ptr<ResidentTexture> Renderer::LoadResidentTextureFromFile(std::u8string const& aFile, TextureLoadOptions const& aOptions)
+  {
+    auto texture = std::make_shared<ResidentTexture>();
+    texture->mRenderer = this;
+    texture->mLastUsedFrame = mFrame;
+    texture->mFile = aFile;
+    texture->mOptions = aOptions;
+    texture->GetTexture();
+
+    mResidentTextures.emplace_back(texture);
+    return texture;
+  }
+
+  void Renderer::UpdateTextureResidency()
+  {
+    ++mFrame;
+
+    if (nullptr != mTextureAtlas)
+    {
+      mTextureAtlas->ReleaseEmptyPages();
+    }
+
+    size_t resident = 0;
+    std::vector<std::shared_ptr<ResidentTexture>> candidates;
+
+    std::erase_if(mResidentTextures, [&](std::weak_ptr<ResidentTexture> const& aWeak)
+    {
+      auto texture = aWeak.lock();
+      if (nullptr == texture)
+      {
+        return true;
+      }
+
+      resident += texture->GetMemorySize();
+
+      // Anything drawn last frame may still be in flight, and is likely to be drawn again.
+      // Updated textures can't be brought back as they are, so they stay.
+      if (texture->IsResident() && false == texture->mTexture->HasUpdates && (texture->mLastUsedFrame + 1) < mFrame)
+      {
+        candidates.emplace_back(std::move(texture));
+      }
+
+      return false;
+    });
+
+    if (0 != mTextureMemoryBudget && resident > mTextureMemoryBudget)
+    {
+      std::sort(candidates.begin(), candidates.end(), [](auto const& aLeft, auto const& aRight)
+      {
+        return aLeft->mLastUsedFrame < aRight->mLastUsedFrame;
+      });
+
+      for (auto& texture : candidates)
+      {
+        if (resident <= mTextureMemoryBudget)
+        {
+          break;
+        }
+
+        resident -= texture->GetMemorySize();
+        texture->mTexture.reset();
+      }
+    }
+
+    mResidentTextureMemory = resident;
+  }
+}
@@ -1,21 +1,33 @@
 #pragma once
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <functional>
 #include <memory>
+#include <mutex>
 #include <string>
+#include <vector>
 
 #include <SDL.h>
 #include "glm/glm.hpp"
 
+struct ImDrawData;
+struct ImDrawList;
+
 namespace SOIS
 {
   class OpenGL3Renderer;
   class DX11Renderer;
+  class SoftwareRenderer;
   class Renderer;
 
   // Make the renderers, we put these into their own cpp files to simplify the code around
   // compiling them on different platforms.
   std::unique_ptr<Renderer> MakeOpenGL3Renderer();
   std::unique_ptr<Renderer> MakeDX11Renderer();
+  std::unique_ptr<Renderer> MakeSoftwareRenderer();
 
   enum class TextureLayout
   {
@@ -30,6 +42,117 @@ namespace SOIS
     InvalidLayout
   };
 
+  inline bool IsBlockCompressed(TextureLayout aLayout)
+  {
+    switch (aLayout)
+    {
+      case TextureLayout::Bc1_Rgba_Unorm:
+      case TextureLayout::Bc1_Rgba_Srgb:
+      case TextureLayout::Bc3_Srgb:
+      case TextureLayout::Bc3_Unorm:
+      case TextureLayout::Bc7_Unorm:
+      case TextureLayout::Bc7_Srgb:
+        return true;
+      default:
+        return false;
+    }
+  }
+
+  // Bytes per 4x4 block for block compressed layouts, bytes per pixel otherwise.
+  inline int GetBlockSize(TextureLayout aLayout)
+  {
+    switch (aLayout)
+    {
+      case TextureLayout::Bc1_Rgba_Unorm:
+      case TextureLayout::Bc1_Rgba_Srgb:
+        return 8;
+      case TextureLayout::Bc3_Srgb:
+      case TextureLayout::Bc3_Unorm:
+      case TextureLayout::Bc7_Unorm:
+      case TextureLayout::Bc7_Srgb:
+        return 16;
+      default:
+        return 4;
+    }
+  }
+
+  // Bytes in one tightly packed row of pixels, or one row of blocks.
+  inline int GetRowPitch(TextureLayout aLayout, int aWidth)
+  {
+    if (IsBlockCompressed(aLayout))
+    {
+      return ((aWidth + 3) / 4) * GetBlockSize(aLayout);
+    }
+
+    return aWidth * GetBlockSize(aLayout);
+  }
+
+  inline size_t GetTextureDataSize(TextureLayout aLayout, int aWidth, int aHeight)
+  {
+    size_t rows = IsBlockCompressed(aLayout) ? (aHeight + 3) / 4 : aHeight;
+    return rows * GetRowPitch(aLayout, aWidth);
+  }
+
+  // Pass as the mip level count when loading a texture to have the renderer build the
+  // full chain from level 0, on the GPU when it can.
+  constexpr int cGenerateMips = 0;
+
+  // Levels in a full chain, down to and including 1x1.
+  inline int GetMipLevelCount(int aWidth, int aHeight)
+  {
+    int levels = 1;
+    for (int size = std::max(aWidth, aHeight); size > 1; size /= 2)
+    {
+      ++levels;
+    }
+
+    return levels;
+  }
+
+  inline int GetMipSize(int aSize, int aLevel)
+  {
+    return std::max(1, aSize >> aLevel);
+  }
+
+  // Where aLevel starts in a chain with every level tightly packed after the last.
+  inline size_t GetMipOffset(TextureLayout aLayout, int aWidth, int aHeight, int aLevel)
+  {
+    size_t offset = 0;
+    for (int level = 0; level < aLevel; ++level)
+    {
+      offset += GetTextureDataSize(aLayout, GetMipSize(aWidth, level), GetMipSize(aHeight, level));
+    }
+
+    return offset;
+  }
+
+  // How Present lines up with the display's refresh.
+  enum class PresentMode
+  {
+    Vsync,
+    AdaptiveVsync, // Vsync, but a late frame goes out right away instead of waiting a whole refresh.
+    Immediate
+  };
+
+  struct TextureLoadOptions
+  {
+    // Layout the texture is stored in on the GPU. Block compressed layouts are encoded
+    // on the CPU after decoding (on the loader threads for async loads), trading some
+    // load time for a quarter to an eighth of the memory.
+    TextureLayout Layout = TextureLayout::RGBA_Unorm;
+
+    // Build a full mip chain so the texture can be drawn small without aliasing.
+    bool GenerateMips = false;
+  };
+
+  // Sub rectangle of a texture, in texels.
+  struct TextureRegion
+  {
+    int X = 0;
+    int Y = 0;
+    int Width = 0;
+    int Height = 0;
+  };
 
   class Texture
   {
@@ -54,26 +177,354 @@ namespace SOIS
 
     int Width;
     int Height;
+
+    // Levels in the mip chain, sampled trilinearly when there's more than one.
+    int MipLevels = 1;
+
+    // How the backend actually stores it, which isn't what was asked for when the GPU
+    // can't sample a compressed layout and it was expanded on load.
+    TextureLayout Layout = TextureLayout::RGBA_Unorm;
+
+    // Set once UpdateTexture has written to it, from then on the GPU holds the only copy
+    // of its contents.
+    bool HasUpdates = false;
+
+    // The Renderer or TextureAtlas that made it, so UpdateTexture can turn away ones it
+    // didn't.
+    void const* Owner = nullptr;
+
+    // Bytes the backend allocated for it, give or take driver padding.
+    size_t GetMemorySize() const
+    {
+      return GetMipOffset(Layout, Width, Height, MipLevels);
+    }
+
+    // Where this texture lives within GetTextureId, pass these along to ImGui::Image.
+    // Only textures that share storage (see TextureAtlas) use anything but the defaults.
+    glm::vec2 UvMin = { 0.f, 0.f };
+    glm::vec2 UvMax = { 1.f, 1.f };
+  };
+
+  class TextureAtlas;
+  class TextureCache;
+  class ThreadPool;
+  struct Image;
+
+  // Keeps textures the render thread may still be drawing with as they are. While frames
+  // are in flight, backends defer deleting or writing to textures until those frames have
+  // been rendered, otherwise it happens straight away. Main thread only.
+  class InFlightFrames
+  {
+  public:
+    bool IsIdle() const
+    {
+      return mSubmitted == mRendered;
+    }
+
+    // Runs aWork now if no frames are in flight, otherwise once they've been rendered.
+    void Defer(std::function<void()> aWork);
+
+    // RenderThread calls these, after each SubmitFrame and once every frame submitted so
+    // far has been rendered.
+    void Submitted();
+    void Rendered();
+
+  private:
+    struct DeferredWork
+    {
+      uint64_t mFrame;
+      std::function<void()> mWork;
+    };
+
+    std::deque<DeferredWork> mDeferred;
+    uint64_t mSubmitted = 0;
+    uint64_t mRendered = 0;
+  };
+
+  enum class TextureLoadStatus
+  {
+    Loading,
+    Ready,
+    Failed,
+    Taken // TakeTexture has handed the texture off, GetTexture is back to the placeholder.
+  };
+
+  // Handle to a texture being loaded in the background by Renderer::LoadTextureFromFileAsync.
+  // Until the load finishes GetTexture returns a placeholder, so it can be drawn right away.
+  // Status only changes inside Renderer::NewFrame (on the thread that owns the renderer)
+  // and TakeTexture.
+  class AsyncTexture
+  {
+  public:
+    TextureLoadStatus GetStatus() const
+    {
+      return mStatus;
+    }
+
+    bool IsReady() const
+    {
+      return TextureLoadStatus::Ready == mStatus;
+    }
+
+    Texture* GetTexture() const
+    {
+      return mTexture ? mTexture.get() : mPlaceholder.get();
+    }
+
+    // Takes ownership of the loaded texture, nullptr if it isn't ready.
+    std::unique_ptr<Texture> TakeTexture()
+    {
+      if (nullptr != mTexture)
+      {
+        mStatus = TextureLoadStatus::Taken;
+      }
+
+      return std::move(mTexture);
+    }
+
+  private:
+    friend class Renderer;
+
+    TextureLoadStatus mStatus = TextureLoadStatus::Loading;
+
+    // Shared, so handles kept past the renderer's placeholder being replaced or freed
+    // don't dangle.
+    std::shared_ptr<Texture> mPlaceholder;
+    std::unique_ptr<Texture> mTexture;
+  };
+
+  // Texture whose GPU memory is managed by the renderer, see Renderer::SetTextureMemoryBudget.
+  // When resident textures go over budget the ones drawn least recently are evicted, and
+  // uploaded again the next time GetTexture is called. Textures written to through
+  // UpdateTexture are pinned, since reloading them would lose those writes. Like any
+  // texture, these shouldn't outlive the renderer that made them.
+  class ResidentTexture
+  {
+  public:
+    ~ResidentTexture();
+
+    // Call this every frame the texture is drawn, it's how we know it's in use. Returns a
+    // placeholder while a file backed texture is (re)loading.
+    Texture* GetTexture();
+
+    bool IsResident() const
+    {
+      return nullptr != mTexture;
+    }
+
+    // GPU bytes while resident, 0 otherwise.
+    size_t GetMemorySize() const
+    {
+      return mTexture ? mMemorySize : 0;
+    }
+
+  private:
+    friend class Renderer;
+
+    void SetTexture(std::unique_ptr<Texture> aTexture);
+
+    Renderer* mRenderer = nullptr;
+    std::unique_ptr<Texture> mTexture;
+    size_t mMemorySize = 0;
+    uint64_t mLastUsedFrame = 0;
+
+    // Where we upload from after an eviction, a CPU side copy or the file (which goes
+    // through the texture cache, if there is one).
+    std::unique_ptr<Image> mImage;
+    std::u8string mFile;
+    TextureLoadOptions mOptions;
+    std::shared_ptr<AsyncTexture> mReload;
   };
 
   class Renderer
   {
   public:
-    virtual ~Renderer() {};
+    Renderer();
+    virtual ~Renderer();
 
     virtual void Initialize(SDL_Window*) {};
 
     virtual SDL_WindowFlags GetAdditionalWindowFlags() { return (SDL_WindowFlags)0; };
 
+    // Call after Initialize. Backends fall back to Vsync for modes they can't do.
+    virtual void SetPresentMode(PresentMode) {};
+
+    // Only redraw the parts of the screen whose draw lists changed since last frame,
+    // for backends that support it. Like frame skipping, this can't see anything the
+    // application draws itself, so leave it off if you do.
+    virtual void SetPartialRedraw(bool) {};
+
     virtual void NewFrame() = 0;
     virtual void ResizeRenderTarget(unsigned int aWidth, unsigned int aHeight) = 0;
 
 
-    virtual std::unique_ptr<Texture> LoadTextureFromData(unsigned char* data, TextureLayout format, int w, int h, int pitch) = 0;
-    virtual std::unique_ptr<Texture> LoadTextureFromFile(std::u8string const& aFile) = 0;
+    // aMipLevels above 1 means data holds that many levels, tightly packed one after
+    // another (see GetMipOffset). cGenerateMips builds the chain from level 0.
+    virtual std::unique_ptr<Texture> LoadTextureFromData(unsigned char* data, TextureLayout format, int w, int h, int pitch, int aMipLevels = 1) = 0;
+    virtual std::unique_ptr<Texture> LoadTextureFromFile(std::u8string const& aFile, TextureLoadOptions const& aOptions = {});
+
+    // Replaces aRegion of an RGBA texture with aData, for streaming things like video
+    // frames or live image viewers into an existing texture. Only takes textures this
+    // renderer loaded, atlas textures go through TextureAtlas::UpdateTexture.
+    virtual void UpdateTexture(Texture* aTexture, TextureRegion aRegion, unsigned char const* aData, int aPitch) = 0;
+
+    // Bumped by every UpdateTexture, so changes that don't show up in the draw data can
+    // still be noticed. Safe to read from any thread.
+    uint64_t GetTextureContentVersion() const
+    {
+      return mTextureContentVersion;
+    }
+
+    // File reading and decoding happen on worker threads, the upload happens in a later
+    // NewFrame, within the budget set by SetTextureUploadBudget.
+    std::shared_ptr<AsyncTexture> LoadTextureFromFileAsync(std::u8string const& aFile, TextureLoadOptions const& aOptions = {});
+
+    // Keeps decoded (and compressed/mipped, per TextureLoadOptions) images from file
+    // loads in aDirectory, so later runs skip decoding. Empty turns the cache off,
+    // which is the default.
+    void SetTextureCacheDirectory(std::u8string const& aDirectory);
+
+    // Textures the renderer may evict from GPU memory and bring back, see ResidentTexture.
+    // From data keeps a CPU side copy of the pixels, from a file loads asynchronously.
+    std::shared_ptr<ResidentTexture> LoadResidentTextureFromData(unsigned char const* aData, TextureLayout aLayout, int aWidth, int aHeight, int aPitch, int aMipLevels = 1);
+    std::shared_ptr<ResidentTexture> LoadResidentTextureFromFile(std::u8string const& aFile, TextureLoadOptions const& aOptions = {});
+
+    // Bytes of GPU memory resident textures may use before we start evicting, 0 (the
+    // default) means no limit. Textures drawn last frame are never evicted, so a frame
+    // that draws more than the budget can go over it.
+    void SetTextureMemoryBudget(size_t aBytes)
+    {
+      mTextureMemoryBudget = aBytes;
+    }
+
+    // What resident textures were using as of the last NewFrame.
+    size_t GetResidentTextureMemory() const
+    {
+      return mResidentTextureMemory;
+    }
+
+    // Shared atlas for small RGBA textures like thumbnails and icons.
+    TextureAtlas& GetTextureAtlas();
+
+    // Time NewFrame may spend uploading finished async loads, at least one upload is
+    // always done per frame so loads can't starve.
+    void SetTextureUploadBudget(std::chrono::microseconds aBudget)
+    {
+      mUploadBudget = aBudget;
+    }
+
+    // Hashes everything in the draw data that affects what ends up on screen (vertices,
+    // indices, commands, display size), for telling whether a frame changed.
+    static uint64_t HashDrawData(ImDrawData const* aDrawData);
+    static uint64_t HashDrawList(ImDrawList const* aDrawList);
 
     virtual void ClearRenderTarget(glm::vec4 aClearColor) = 0;
     virtual void RenderImguiData() = 0;
     virtual void Present() = 0;
+
+    // Debug check for frame skipping, whether the render target still holds the frame
+    // last presented. Backends that can't read it back cheaply always say yes.
+    virtual bool HoldsPresentedFrame() const { return true; };
+
+    // For measuring latency, a fence after everything submitted so far. Returns nullptr
+    // if the backend can't tell when the GPU is done with a frame. Fences are polled
+    // until signalled and then destroyed, never waited on.
+    virtual void* InsertFrameFence() { return nullptr; };
+    virtual bool IsFrameFenceSignalled(void*) { return true; };
+    virtual void DestroyFrameFence(void*) {};
+
+    // Threaded rendering, see RenderThread. EnableRenderThread is called once on the main
+    // thread, and returns false if the backend can't render from another thread. If it
+    // returns true, ClearRenderTarget only records the color, RenderImguiData and Present
+    // aren't called, and instead the render thread calls RenderFrame, which clears,
+    // draws aDrawData, and presents. Everything else stays on the main thread.
+    virtual bool EnableRenderThread() { return false; };
+
+    // Main thread, once a frame's resources are in place and before its RenderFrame.
+    // aDrawData is ImGui's, anything the render thread needs from it (or from us) has to
+    // be copied out here.
+    virtual void SubmitFrame(ImDrawData const*) {};
+
+    // Render thread.
+    virtual void RenderFrame(ImDrawData*) {};
+    virtual void DisableRenderThread() {};
+
+    // Shared with backend textures, so they can defer their deletion while frames are
+    // in flight.
+    std::shared_ptr<InFlightFrames> const& GetInFlightFrames() const
+    {
+      return mInFlightFrames;
+    }
+
+  protected:
+    // Backends call this at the start of NewFrame.
+    void ProcessAsyncTextureUploads();
+
+    // Backends call this at the start of NewFrame, it advances the frame counter and
+    // evicts resident textures until we're back under budget. Empty atlas pages are freed
+    // here too.
+    void UpdateTextureResidency();
+
+    // Backends call this before submitting draw data, it folds consecutive commands that
+    // share a texture, clip rect and vertex offset into one draw call. ImGui only does
+    // this within a single channel, so split draw lists (tables, columns, atlas pages
+    // used from different channels) still benefit.
+    static void MergeDrawCommands(ImDrawData* aDrawData);
+
+    // Backends call this from UpdateTexture.
+    void TextureContentsChanged(Texture* aTexture);
+
+    // For partial redraws. Works out the part of the screen (in display coordinates, as
+    // x1, y1, x2, y2 like ImDrawCmd::ClipRect) that changed since the last call, by
+    // comparing each draw list against what it was last time. False if nothing did.
+    // Main thread only, it shares its history with TextureContentsChanged.
+    bool ComputeDamage(ImDrawData const* aDrawData, glm::vec4& aDamage);
+
+    // Clips every command in aDrawData to aDamage, dropping the ones entirely outside it.
+    static void ClipDrawData(ImDrawData* aDrawData, glm::vec4 const& aDamage);
+
+    // Background threads for decoding and compressing textures, created on first use.
+    ThreadPool& GetLoaderPool();
+
+  private:
+    friend class ResidentTexture;
+
+    // What a draw list looked like last frame, for ComputeDamage.
+    struct DrawListState
+    {
+      ImDrawList const* mList;
+      uint64_t mHash;
+      glm::vec4 mBounds;
+    };
+
+    struct DecodedTexture
+    {
+      std::weak_ptr<AsyncTexture> mHandle;
+      std::unique_ptr<Image> mImage;
+    };
+
+    // Shared with the loader jobs, so they can finish safely even if we're gone.
+    struct UploadQueue
+    {
+      std::mutex mMutex;
+      std::deque<DecodedTexture> mDecoded;
+    };
+
+    std::shared_ptr<UploadQueue> mUploadQueue;
+    std::shared_ptr<InFlightFrames> mInFlightFrames;
+    std::shared_ptr<TextureCache> mTextureCache;
+    std::unique_ptr<ThreadPool> mLoaderPool;
+    std::shared_ptr<Texture> mPlaceholderTexture;
+    std::unique_ptr<TextureAtlas> mTextureAtlas;
+    std::chrono::microseconds mUploadBudget{ 2000 };
+
+    std::vector<DrawListState> mDrawListStates;
+    std::vector<void*> mUpdatedTextures;
+    std::atomic<uint64_t> mTextureContentVersion = 0;
+
+    std::vector<std::weak_ptr<ResidentTexture>> mResidentTextures;
+    size_t mTextureMemoryBudget = 0;
+    size_t mResidentTextureMemory = 0;
+    uint64_t mFrame = 0;
   };
 }
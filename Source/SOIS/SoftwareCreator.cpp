@@ -0,0 +1,10 @@
+
+#include "SOIS/SoftwareRenderer.hpp"
+
+namespace SOIS
+{
+  std::unique_ptr<Renderer> MakeSoftwareRenderer()
+  {
+    return std::make_unique<SoftwareRenderer>();
+  }
+}
@@ -0,0 +1,672 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+  #include <emmintrin.h>
+  #define SOIS_SOFTWARE_SSE2 1
+#endif
+
+#include "imgui.h"
+#include "imgui_impl_sdl.h"
+
+#include <stb_image_write.h>
+
+#include "SOIS/Hash.hpp"
+#include "SOIS/Profiler.hpp"
+#include "SOIS/SoftwareRenderer.hpp"
+#include "SOIS/TextureCompression.hpp"
+#include "SOIS/TextureMips.hpp"
+
+namespace SOIS
+{
+  // One mip level of a texture, what the rasterizer actually samples from.
+  struct TextureLevel
+  {
+    uint32_t const* mPixels = nullptr;
+    int mWidth = 0;
+    int mHeight = 0;
+  };
+
+  class SoftwareTexture : public Texture
+  {
+  public:
+    SoftwareTexture(int aWidth, int aHeight)
+      : Texture{ aWidth, aHeight }
+      , Pixels(static_cast<size_t>(aWidth) * static_cast<size_t>(aHeight))
+    {
+
+    }
+
+    ~SoftwareTexture() override
+    {
+    }
+
+    // The draw data just carries our pointer back to us.
+    void* GetTextureId() override
+    {
+      return this;
+    }
+
+    TextureLevel GetLevel(int aLevel) const
+    {
+      size_t offset = GetMipOffset(TextureLayout::RGBA_Unorm, Width, Height, aLevel) / 4;
+      return TextureLevel{ Pixels.data() + offset, GetMipSize(Width, aLevel), GetMipSize(Height, aLevel) };
+    }
+
+    // Every mip level, tightly packed one after another starting with level 0.
+    std::vector<uint32_t> Pixels;
+  };
+
+  // Rows per job when splitting the framebuffer up between threads.
+  static constexpr int cBandHeight = 32;
+
+  ////////////////////
+  // Pixel helpers, all colors are packed like ImU32 (R in the lowest byte).
+  static inline uint32_t Div255(uint32_t aValue)
+  {
+    aValue += 128;
+    return (aValue + (aValue >> 8)) >> 8;
+  }
+
+  static inline uint32_t Modulate(uint32_t aLeft, uint32_t aRight)
+  {
+    uint32_t r = Div255((aLeft & 0xFF) * (aRight & 0xFF));
+    uint32_t g = Div255(((aLeft >> 8) & 0xFF) * ((aRight >> 8) & 0xFF));
+    uint32_t b = Div255(((aLeft >> 16) & 0xFF) * ((aRight >> 16) & 0xFF));
+    uint32_t a = Div255((aLeft >> 24) * (aRight >> 24));
+    return r | (g << 8) | (b << 16) | (a << 24);
+  }
+
+  // Matches the GL backend: SRC_ALPHA, ONE_MINUS_SRC_ALPHA for color and ONE,
+  // ONE_MINUS_SRC_ALPHA for alpha.
+  static inline uint32_t Blend(uint32_t aDestination, uint32_t aSource)
+  {
+    uint32_t a = aSource >> 24;
+    if (255 == a)
+    {
+      return aSource;
+    }
+    else if (0 == a)
+    {
+      return aDestination;
+    }
+
+    uint32_t inverse = 255 - a;
+    uint32_t r = Div255((aSource & 0xFF) * a + (aDestination & 0xFF) * inverse);
+    uint32_t g = Div255(((aSource >> 8) & 0xFF) * a + ((aDestination >> 8) & 0xFF) * inverse);
+    uint32_t b = Div255(((aSource >> 16) & 0xFF) * a + ((aDestination >> 16) & 0xFF) * inverse);
+    uint32_t outA = Div255(a * 255 + (aDestination >> 24) * inverse);
+    return r | (g << 8) | (b << 16) | (outA << 24);
+  }
+
+  // Blends a single color over a run of pixels, this is the bulk of an ImGui frame
+  // (window backgrounds, frames, buttons) so it gets the SIMD treatment.
+  static void BlendSpan(uint32_t* aDestination, int aCount, uint32_t aColor)
+  {
+    uint32_t a = aColor >> 24;
+    if (0 == a)
+    {
+      return;
+    }
+
+    int i = 0;
+
+    if (255 == a)
+    {
+#if defined(SOIS_SOFTWARE_SSE2)
+      __m128i color = _mm_set1_epi32(static_cast<int>(aColor));
+      for (; i + 4 <= aCount; i += 4)
+      {
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(aDestination + i), color);
+      }
+#endif
+      std::fill(aDestination + i, aDestination + aCount, aColor);
+      return;
+    }
+
+#if defined(SOIS_SOFTWARE_SSE2)
+    short r = static_cast<short>((aColor & 0xFF) * a);
+    short g = static_cast<short>(((aColor >> 8) & 0xFF) * a);
+    short b = static_cast<short>(((aColor >> 16) & 0xFF) * a);
+    short outA = static_cast<short>(a * 255);
+
+    // Two pixels worth of premultiplied source per register, in 16 bit lanes.
+    __m128i source = _mm_set_epi16(outA, b, g, r, outA, b, g, r);
+    __m128i inverse = _mm_set1_epi16(static_cast<short>(255 - a));
+    __m128i bias = _mm_set1_epi16(128);
+    __m128i zero = _mm_setzero_si128();
+
+    auto div255 = [bias](__m128i aValue)
+    {
+      aValue = _mm_add_epi16(aValue, bias);
+      return _mm_srli_epi16(_mm_add_epi16(aValue, _mm_srli_epi16(aValue, 8)), 8);
+    };
+
+    for (; i + 4 <= aCount; i += 4)
+    {
+      __m128i destination = _mm_loadu_si128(reinterpret_cast<__m128i*>(aDestination + i));
+      __m128i low = _mm_unpacklo_epi8(destination, zero);
+      __m128i high = _mm_unpackhi_epi8(destination, zero);
+      low = div255(_mm_add_epi16(_mm_mullo_epi16(low, inverse), source));
+      high = div255(_mm_add_epi16(_mm_mullo_epi16(high, inverse), source));
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(aDestination + i), _mm_packus_epi16(low, high));
+    }
+#endif
+
+    for (; i < aCount; ++i)
+    {
+      aDestination[i] = Blend(aDestination[i], aColor);
+    }
+  }
+
+  static inline uint32_t Sample(TextureLevel const& aLevel, float aU, float aV)
+  {
+    if (nullptr == aLevel.mPixels)
+    {
+      return 0xFFFFFFFF;
+    }
+
+    int x = std::clamp(static_cast<int>(aU * aLevel.mWidth), 0, aLevel.mWidth - 1);
+    int y = std::clamp(static_cast<int>(aV * aLevel.mHeight), 0, aLevel.mHeight - 1);
+    return aLevel.mPixels[static_cast<size_t>(y) * aLevel.mWidth + x];
+  }
+
+  static inline uint32_t LerpColor(uint32_t aColor0, uint32_t aColor1, uint32_t aColor2, float aW0, float aW1, float aW2)
+  {
+    uint32_t result = 0;
+    for (int shift = 0; shift < 32; shift += 8)
+    {
+      float channel = ((aColor0 >> shift) & 0xFF) * aW0 + ((aColor1 >> shift) & 0xFF) * aW1 + ((aColor2 >> shift) & 0xFF) * aW2;
+      result |= static_cast<uint32_t>(std::clamp(channel + 0.5f, 0.f, 255.f)) << shift;
+    }
+
+    return result;
+  }
+
+  struct RasterTarget
+  {
+    uint32_t* mPixels;
+    int mWidth;
+
+    // Pixel bounds we're allowed to touch, [min, max).
+    int mMinX;
+    int mMinY;
+    int mMaxX;
+    int mMaxY;
+  };
+
+  struct RasterVertex
+  {
+    float mX;
+    float mY;
+    float mU;
+    float mV;
+    uint32_t mColor;
+  };
+
+  // ImGui triangles are small enough that one level per triangle is close to what
+  // per pixel selection would give, pick the one with about a texel per pixel.
+  static TextureLevel SelectLevel(SoftwareTexture* aTexture, RasterVertex const& aV0, RasterVertex const& aV1, RasterVertex const& aV2, float aArea)
+  {
+    if (nullptr == aTexture)
+    {
+      return TextureLevel{};
+    }
+
+    int level = 0;
+    if (aTexture->MipLevels > 1)
+    {
+      float texelArea = std::abs((aV1.mU - aV0.mU) * (aV2.mV - aV0.mV) - (aV1.mV - aV0.mV) * (aV2.mU - aV0.mU)) * aTexture->Width * aTexture->Height;
+      if (texelArea > aArea)
+      {
+        level = std::clamp(static_cast<int>(std::lround(0.5f * std::log2(texelArea / aArea))), 0, aTexture->MipLevels - 1);
+      }
+    }
+
+    return aTexture->GetLevel(level);
+  }
+
+  // Edge function of a->b, split into a per row constant and a per pixel step
+  // so we can solve for the covered span of each row directly.
+  struct Edge
+  {
+    Edge(RasterVertex const& aA, RasterVertex const& aB)
+      : mStep{ aA.mY - aB.mY }
+      , mDeltaX{ aB.mX - aA.mX }
+      , mAX{ aA.mX }
+      , mAY{ aA.mY }
+    {
+    }
+
+    float RowConstant(float aY) const
+    {
+      return mDeltaX * (aY - mAY) - mStep * mAX;
+    }
+
+    float mStep;
+    float mDeltaX;
+    float mAX;
+    float mAY;
+  };
+
+  // Span bounds can land far outside the target for nearly horizontal edges, clamp
+  // them before converting so we don't overflow the int.
+  static inline int CeilToPixel(float aValue, int aMin, int aMax)
+  {
+    return static_cast<int>(std::ceil(std::clamp(aValue, static_cast<float>(aMin), static_cast<float>(aMax))));
+  }
+
+  static void RasterizeTriangle(RasterTarget const& aTarget, RasterVertex aV0, RasterVertex aV1, RasterVertex aV2, SoftwareTexture* aTexture)
+  {
+    float area = (aV1.mX - aV0.mX) * (aV2.mY - aV0.mY) - (aV1.mY - aV0.mY) * (aV2.mX - aV0.mX);
+    if (std::abs(area) < 1e-6f)
+    {
+      return;
+    }
+
+    // ImGui emits both windings, normalize so inside is positive.
+    if (area < 0.f)
+    {
+      std::swap(aV1, aV2);
+      area = -area;
+    }
+
+    int minY = std::max(aTarget.mMinY, static_cast<int>(std::floor(std::min({ aV0.mY, aV1.mY, aV2.mY }))));
+    int maxY = std::min(aTarget.mMaxY, static_cast<int>(std::ceil(std::max({ aV0.mY, aV1.mY, aV2.mY }))));
+    int minX = std::max(aTarget.mMinX, static_cast<int>(std::floor(std::min({ aV0.mX, aV1.mX, aV2.mX }))));
+    int maxX = std::min(aTarget.mMaxX, static_cast<int>(std::ceil(std::max({ aV0.mX, aV1.mX, aV2.mX }))));
+    if (minY >= maxY || minX >= maxX)
+    {
+      return;
+    }
+
+    // Weights for v0, v1 and v2 respectively.
+    Edge const edges[3] = { Edge{ aV1, aV2 }, Edge{ aV2, aV0 }, Edge{ aV0, aV1 } };
+
+    bool const flatColor = aV0.mColor == aV1.mColor && aV0.mColor == aV2.mColor;
+    bool const flatUv = aV0.mU == aV1.mU && aV0.mU == aV2.mU && aV0.mV == aV1.mV && aV0.mV == aV2.mV;
+
+    TextureLevel const level = SelectLevel(aTexture, aV0, aV1, aV2, area);
+
+    // Solid fills in ImGui all sample the white pixel, so the whole triangle is one color.
+    uint32_t const flatFill = Modulate(Sample(level, aV0.mU, aV0.mV), aV0.mColor);
+    float const inverseArea = 1.f / area;
+
+    for (int y = minY; y < maxY; ++y)
+    {
+      float const centerY = y + 0.5f;
+      int spanStart = minX;
+      int spanEnd = maxX;
+      float rowWeights[3];
+
+      for (int i = 0; i < 3; ++i)
+      {
+        Edge const& edge = edges[i];
+        float constant = edge.RowConstant(centerY);
+        rowWeights[i] = constant;
+
+        if (edge.mStep > 0.f)
+        {
+          spanStart = std::max(spanStart, CeilToPixel(-constant / edge.mStep - 0.5f, minX, maxX));
+        }
+        else if (edge.mStep < 0.f)
+        {
+          spanEnd = std::min(spanEnd, CeilToPixel(-constant / edge.mStep - 0.5f, minX, maxX));
+        }
+        else if (constant < 0.f || (0.f == constant && edge.mDeltaX > 0.f))
+        {
+          // Horizontal edge, shared edges are walked in opposite directions so only
+          // one of the two triangles claims the row.
+          spanEnd = spanStart;
+        }
+      }
+
+      if (spanStart >= spanEnd)
+      {
+        continue;
+      }
+
+      uint32_t* row = aTarget.mPixels + static_cast<size_t>(y) * aTarget.mWidth;
+
+      if (flatColor && flatUv)
+      {
+        BlendSpan(row + spanStart, spanEnd - spanStart, flatFill);
+        continue;
+      }
+
+      // Barycentric weights at the first pixel center, stepped across the span.
+      float const startX = spanStart + 0.5f;
+      float w0 = (rowWeights[0] + edges[0].mStep * startX) * inverseArea;
+      float w1 = (rowWeights[1] + edges[1].mStep * startX) * inverseArea;
+      float w2 = (rowWeights[2] + edges[2].mStep * startX) * inverseArea;
+      float const step0 = edges[0].mStep * inverseArea;
+      float const step1 = edges[1].mStep * inverseArea;
+      float const step2 = edges[2].mStep * inverseArea;
+
+      for (int x = spanStart; x < spanEnd; ++x)
+      {
+        float u = aV0.mU * w0 + aV1.mU * w1 + aV2.mU * w2;
+        float v = aV0.mV * w0 + aV1.mV * w1 + aV2.mV * w2;
+        uint32_t color = flatColor ? aV0.mColor : LerpColor(aV0.mColor, aV1.mColor, aV2.mColor, w0, w1, w2);
+
+        row[x] = Blend(row[x], Modulate(Sample(level, u, v), color));
+
+        w0 += step0;
+        w1 += step1;
+        w2 += step2;
+      }
+    }
+  }
+
+  ////////////////////
+  // SoftwareRenderer
+  SoftwareRenderer::SoftwareRenderer()
+    : Renderer{}
+    , mThreadPool{ std::make_unique<ThreadPool>() }
+  {
+  }
+
+  SoftwareRenderer::~SoftwareRenderer()
+  {
+    ImGui::GetIO().Fonts->SetTexID(nullptr);
+  }
+
+  void SoftwareRenderer::Initialize(SDL_Window* aWindow)
+  {
+    mWindow = aWindow;
+
+    int width;
+    int height;
+    SDL_GetWindowSize(mWindow, &width, &height);
+    Resize(width, height);
+
+    // The GL context is only used by the SDL backend for multi-viewports, which we
+    // don't enable, so this is the most portable way to initialize it without one.
+    ImGui_ImplSDL2_InitForOpenGL(mWindow, nullptr);
+
+    ImGuiIO& io = ImGui::GetIO();
+    io.BackendRendererName = "SOIS_Software";
+    io.BackendFlags |= ImGuiBackendFlags_RendererHasVtxOffset;
+  }
+
+  void SoftwareRenderer::NewFrame()
+  {
+    ProcessAsyncTextureUploads();
+    UpdateTextureResidency();
+
+    if (nullptr != mFontTexture)
+    {
+      return;
+    }
+
+    // Fonts are built after we're initialized, so grab the atlas on the first frame.
+    ImGuiIO& io = ImGui::GetIO();
+    unsigned char* pixels;
+    int width;
+    int height;
+    io.Fonts->GetTexDataAsRGBA32(&pixels, &width, &height);
+
+    mFontTexture = std::make_unique<SoftwareTexture>(width, height);
+    memcpy(mFontTexture->Pixels.data(), pixels, mFontTexture->Pixels.size() * sizeof(uint32_t));
+    io.Fonts->SetTexID(mFontTexture->GetTextureId());
+  }
+
+  void SoftwareRenderer::Resize(int aWidth, int aHeight)
+  {
+    aWidth = std::max(aWidth, 0);
+    aHeight = std::max(aHeight, 0);
+
+    if (aWidth == mWidth && aHeight == mHeight)
+    {
+      return;
+    }
+
+    mWidth = aWidth;
+    mHeight = aHeight;
+    mFramebuffer.resize(static_cast<size_t>(mWidth) * static_cast<size_t>(mHeight));
+  }
+
+  void SoftwareRenderer::ResizeRenderTarget(unsigned int aWidth, unsigned int aHeight)
+  {
+    Resize(static_cast<int>(aWidth), static_cast<int>(aHeight));
+  }
+
+  void SoftwareRenderer::ClearRenderTarget(glm::vec4 aClearColor)
+  {
+    ImGuiIO& io = ImGui::GetIO();
+    Resize(static_cast<int>(io.DisplaySize.x * io.DisplayFramebufferScale.x),
+           static_cast<int>(io.DisplaySize.y * io.DisplayFramebufferScale.y));
+
+    auto toByte = [](float aChannel)
+    {
+      return static_cast<uint32_t>(std::clamp(aChannel, 0.f, 1.f) * 255.f + 0.5f);
+    };
+
+    uint32_t color = IM_COL32(toByte(aClearColor.x), toByte(aClearColor.y), toByte(aClearColor.z), toByte(aClearColor.w));
+    std::fill(mFramebuffer.begin(), mFramebuffer.end(), color);
+  }
+
+  void SoftwareRenderer::RenderImguiData()
+  {
+    RenderDrawData(ImGui::GetDrawData());
+  }
+
+  void SoftwareRenderer::RenderDrawData(ImDrawData* aDrawData)
+  {
+    SOIS_PROFILE_SCOPE("RenderDrawData");
+
+    if (nullptr == aDrawData || 0 == aDrawData->CmdListsCount)
+    {
+      return;
+    }
+
+    Resize(static_cast<int>(aDrawData->DisplaySize.x * aDrawData->FramebufferScale.x),
+           static_cast<int>(aDrawData->DisplaySize.y * aDrawData->FramebufferScale.y));
+
+    if (0 == mWidth || 0 == mHeight)
+    {
+      return;
+    }
+
+    MergeDrawCommands(aDrawData);
+
+    // Each job owns a horizontal band of the framebuffer and walks the whole command
+    // stream for it, so blending order is preserved without any synchronization.
+    size_t bands = (static_cast<size_t>(mHeight) + cBandHeight - 1) / cBandHeight;
+    mThreadPool->ParallelFor(bands, [this, aDrawData](size_t aBand)
+    {
+      int minY = static_cast<int>(aBand) * cBandHeight;
+      RenderBand(aDrawData, minY, std::min(minY + cBandHeight, mHeight));
+    });
+  }
+
+  void SoftwareRenderer::RenderBand(ImDrawData* aDrawData, int aMinY, int aMaxY)
+  {
+    ImVec2 const offset = aDrawData->DisplayPos;
+    ImVec2 const scale = aDrawData->FramebufferScale;
+
+    for (int n = 0; n < aDrawData->CmdListsCount; ++n)
+    {
+      ImDrawList const* cmdList = aDrawData->CmdLists[n];
+      ImDrawVert const* vertices = cmdList->VtxBuffer.Data;
+      ImDrawIdx const* indices = cmdList->IdxBuffer.Data;
+
+      for (int cmdIndex = 0; cmdIndex < cmdList->CmdBuffer.Size; ++cmdIndex)
+      {
+        ImDrawCmd const& cmd = cmdList->CmdBuffer[cmdIndex];
+
+        // There's no GPU state for callbacks to poke at, and we'd be calling them
+        // once per band, so we skip them entirely.
+        if (nullptr != cmd.UserCallback)
+        {
+          continue;
+        }
+
+        RasterTarget target;
+        target.mPixels = mFramebuffer.data();
+        target.mWidth = mWidth;
+        target.mMinX = std::max(0, static_cast<int>((cmd.ClipRect.x - offset.x) * scale.x));
+        target.mMinY = std::max(aMinY, static_cast<int>((cmd.ClipRect.y - offset.y) * scale.y));
+        target.mMaxX = std::min(mWidth, static_cast<int>((cmd.ClipRect.z - offset.x) * scale.x));
+        target.mMaxY = std::min(aMaxY, static_cast<int>((cmd.ClipRect.w - offset.y) * scale.y));
+
+        if (target.mMinX >= target.mMaxX || target.mMinY >= target.mMaxY)
+        {
+          continue;
+        }
+
+        auto* texture = static_cast<SoftwareTexture*>(cmd.TextureId);
+
+        auto toRaster = [&](ImDrawIdx aIndex)
+        {
+          ImDrawVert const& vertex = vertices[cmd.VtxOffset + aIndex];
+          return RasterVertex{
+            (vertex.pos.x - offset.x) * scale.x,
+            (vertex.pos.y - offset.y) * scale.y,
+            vertex.uv.x,
+            vertex.uv.y,
+            vertex.col
+          };
+        };
+
+        ImDrawIdx const* cmdIndices = indices + cmd.IdxOffset;
+        for (unsigned int i = 0; i + 2 < cmd.ElemCount; i += 3)
+        {
+          RasterVertex v0 = toRaster(cmdIndices[i]);
+          RasterVertex v1 = toRaster(cmdIndices[i + 1]);
+          RasterVertex v2 = toRaster(cmdIndices[i + 2]);
+
+          // Cheap reject before any setup, most triangles miss any given band.
+          if (std::max({ v0.mY, v1.mY, v2.mY }) < target.mMinY || std::min({ v0.mY, v1.mY, v2.mY }) >= target.mMaxY)
+          {
+            continue;
+          }
+
+          RasterizeTriangle(target, v0, v1, v2, texture);
+        }
+      }
+    }
+  }
+
+  void SoftwareRenderer::Present()
+  {
+    SOIS_PROFILE_SCOPE("Present");
+
+#if !defined(NDEBUG)
+    mPresentedHash = Hash64(mFramebuffer.data(), mFramebuffer.size() * sizeof(uint32_t));
+#endif
+
+    if (nullptr == mWindow || mFramebuffer.empty())
+    {
+      return;
+    }
+
+    // Headless drivers may not give us a surface, that's fine, the framebuffer
+    // is still available for readback.
+    SDL_Surface* windowSurface = SDL_GetWindowSurface(mWindow);
+    if (nullptr == windowSurface)
+    {
+      return;
+    }
+
+    SDL_Surface* frame = SDL_CreateRGBSurfaceWithFormatFrom(mFramebuffer.data(), mWidth, mHeight, 32, mWidth * 4, SDL_PIXELFORMAT_RGBA32);
+    if (nullptr == frame)
+    {
+      return;
+    }
+
+    SDL_SetSurfaceBlendMode(frame, SDL_BLENDMODE_NONE);
+    SDL_BlitSurface(frame, nullptr, windowSurface, nullptr);
+    SDL_FreeSurface(frame);
+    SDL_UpdateWindowSurface(mWindow);
+  }
+
+  bool SoftwareRenderer::HoldsPresentedFrame() const
+  {
+#if !defined(NDEBUG)
+    return mPresentedHash == Hash64(mFramebuffer.data(), mFramebuffer.size() * sizeof(uint32_t));
+#else
+    return true;
+#endif
+  }
+
+  bool SoftwareRenderer::SaveFramebufferToFile(std::u8string const& aFile) const
+  {
+    if (mFramebuffer.empty())
+    {
+      return false;
+    }
+
+    return 0 != stbi_write_png((char const*)aFile.c_str(), mWidth, mHeight, 4, mFramebuffer.data(), mWidth * 4);
+  }
+
+  std::unique_ptr<Texture> SoftwareRenderer::LoadTextureFromData(unsigned char* data, TextureLayout format, int w, int h, int pitch, int aMipLevels)
+  {
+    if (IsBlockCompressed(format))
+    {
+      // We only sample RGBA8, so compressed textures are expanded up front. Any mips
+      // they came with are rebuilt from level 0 rather than decompressed one by one.
+      auto pixels = DecompressTexture(data, w, h, format);
+      return LoadTextureFromData(pixels.data(), TextureLayout::RGBA_Unorm, w, h, w * 4, (1 == aMipLevels) ? 1 : cGenerateMips);
+    }
+
+    if (TextureLayout::RGBA_Unorm != format && TextureLayout::RGBA_Srgb != format)
+    {
+      return nullptr;
+    }
+
+    int levels = (cGenerateMips == aMipLevels) ? GetMipLevelCount(w, h) : std::max(1, aMipLevels);
+
+    std::vector<unsigned char> chain;
+    if (cGenerateMips == aMipLevels)
+    {
+      chain = GenerateMipChain(data, w, h, pitch, TextureLayout::RGBA_Unorm, mThreadPool.get());
+      data = chain.data();
+      pitch = w * 4;
+    }
+
+    auto texture = std::make_unique<SoftwareTexture>(w, h);
+    texture->MipLevels = levels;
+    texture->Owner = this;
+    texture->Layout = format;
+    texture->Pixels.resize(GetMipOffset(TextureLayout::RGBA_Unorm, w, h, levels) / 4);
+
+    for (int y = 0; y < h; ++y)
+    {
+      memcpy(texture->Pixels.data() + static_cast<size_t>(y) * w, data + static_cast<size_t>(y) * pitch, static_cast<size_t>(w) * 4);
+    }
+
+    if (levels > 1)
+    {
+      size_t levelsStart = GetMipOffset(TextureLayout::RGBA_Unorm, w, h, 1);
+      memcpy(texture->Pixels.data() + levelsStart / 4, data + levelsStart, texture->Pixels.size() * 4 - levelsStart);
+    }
+
+    return std::unique_ptr<Texture>(texture.release());
+  }
+
+  void SoftwareRenderer::UpdateTexture(Texture* aTexture, TextureRegion aRegion, unsigned char const* aData, int aPitch)
+  {
+    if (this != aTexture->Owner)
+    {
+      SDL_assert(false && "UpdateTexture was given a texture this renderer didn't load.");
+      return;
+    }
+
+    TextureContentsChanged(aTexture);
+    auto texture = static_cast<SoftwareTexture*>(aTexture);
+    for (int y = 0; y < aRegion.Height; ++y)
+    {
+      uint32_t* row = texture->Pixels.data() + static_cast<size_t>(aRegion.Y + y) * texture->Width + aRegion.X;
+      memcpy(row, aData + static_cast<size_t>(y) * aPitch, static_cast<size_t>(aRegion.Width) * 4);
+    }
+
+    // Keep the smaller levels in step with the new contents.
+    if (texture->MipLevels > 1)
+    {
+      auto chain = GenerateMipChain(reinterpret_cast<unsigned char const*>(texture->Pixels.data()), texture->Width, texture->Height, texture->Width * 4, TextureLayout::RGBA_Unorm, mThreadPool.get());
+      memcpy(texture->Pixels.data(), chain.data(), chain.size());
+    }
+  }
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <SDL.h>
+
+#include "SOIS/Renderer.hpp"
+#include "SOIS/ThreadPool.hpp"
+
+struct ImDrawData;
+
+namespace SOIS
+{
+  class SoftwareTexture;
+
+  // Rasterizes ImGui draw data on the CPU into an in memory RGBA8 framebuffer. Useful
+  // on machines without a GPU (CI, servers), pair it with SDL_VIDEODRIVER=dummy or
+  // offscreen to run without a display at all. If the window has a surface we copy
+  // the framebuffer into it on Present, otherwise we just keep it around for readback.
+  class SoftwareRenderer : public Renderer
+  {
+  public:
+    SoftwareRenderer();
+    ~SoftwareRenderer() override;
+
+    void Initialize(SDL_Window* aWindow) override;
+
+    void NewFrame() override;
+    void ResizeRenderTarget(unsigned int aWidth, unsigned int aHeight) override;
+
+    void ClearRenderTarget(glm::vec4 aClearColor) override;
+    void RenderImguiData() override;
+    void Present() override;
+    bool HoldsPresentedFrame() const override;
+
+    std::unique_ptr<Texture> LoadTextureFromData(unsigned char* data, TextureLayout format, int w, int h, int pitch, int aMipLevels = 1) override;
+    void UpdateTexture(Texture* aTexture, TextureRegion aRegion, unsigned char const* aData, int aPitch) override;
+
+    // Framebuffer readback, pixels are tightly packed RGBA8 (R in the lowest byte).
+    uint32_t const* GetFramebuffer() const
+    {
+      return mFramebuffer.data();
+    }
+
+    int GetFramebufferWidth() const
+    {
+      return mWidth;
+    }
+
+    int GetFramebufferHeight() const
+    {
+      return mHeight;
+    }
+
+    // Writes the current framebuffer out as a png, returns false on failure.
+    bool SaveFramebufferToFile(std::u8string const& aFile) const;
+
+  private:
+    void RenderDrawData(ImDrawData* aDrawData);
+    void RenderBand(ImDrawData* aDrawData, int aMinY, int aMaxY);
+    void Resize(int aWidth, int aHeight);
+
+    std::vector<uint32_t> mFramebuffer;
+    int mWidth = 0;
+    int mHeight = 0;
+
+    // Hash of mFramebuffer as of the last Present, debug builds only.
+    uint64_t mPresentedHash = 0;
+
+    std::unique_ptr<SoftwareTexture> mFontTexture;
+    std::unique_ptr<ThreadPool> mThreadPool;
+    SDL_Window* mWindow = nullptr;
+  };
+}
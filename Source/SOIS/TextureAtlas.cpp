@@ -0,0 +1,211 @@
+#include <algorithm>
+#include <cstring>
+
+#include <stb_rect_pack.h>
+
+#include "SOIS/Image.hpp"
+#include "SOIS/TextureAtlas.hpp"
+
+namespace SOIS
+{
+  // Each packed texture gets a one texel border of its own edge pixels, so bilinear
+  // filtering at the edges never picks up a neighbour.
+  static constexpr int cBorder = 1;
+
+  struct TextureAtlas::Page
+  {
+    Page(Renderer* aRenderer, int aSize)
+      : mNodes(aSize)
+      , mSize{ aSize }
+    {
+      std::vector<unsigned char> clear(static_cast<size_t>(aSize) * static_cast<size_t>(aSize) * 4, 0);
+      mTexture = aRenderer->LoadTextureFromData(clear.data(), TextureLayout::RGBA_Unorm, aSize, aSize, aSize * 4);
+      Reset();
+    }
+
+    void Reset()
+    {
+      stbrp_init_target(&mPacker, mSize, mSize, mNodes.data(), static_cast<int>(mNodes.size()));
+    }
+
+    std::unique_ptr<Texture> mTexture;
+    stbrp_context mPacker;
+    std::vector<stbrp_node> mNodes;
+    int mSize;
+
+    // Skyline packing can't reclaim individual rectangles, so we just start the page
+    // over once everything in it has been released.
+    size_t mLiveTextures = 0;
+  };
+
+  class AtlasTexture : public Texture
+  {
+  public:
+    AtlasTexture(std::shared_ptr<TextureAtlas::Page> aPage, int aX, int aY, int aWidth, int aHeight)
+      : Texture{ aWidth, aHeight }
+      , mPage{ std::move(aPage) }
+      , mX{ aX }
+      , mY{ aY }
+    {
+      float pageSize = static_cast<float>(mPage->mSize);
+      UvMin = glm::vec2{ aX / pageSize, aY / pageSize };
+      UvMax = glm::vec2{ (aX + aWidth) / pageSize, (aY + aHeight) / pageSize };
+      ++mPage->mLiveTextures;
+    }
+
+    ~AtlasTexture() override
+    {
+      if (0 == --mPage->mLiveTextures)
+      {
+        mPage->Reset();
+      }
+    }
+
+    void* GetTextureId() override
+    {
+      return mPage->mTexture->GetTextureId();
+    }
+
+    std::shared_ptr<TextureAtlas::Page> mPage;
+
+    // Top left of the texture in the page, inside its border.
+    int mX;
+    int mY;
+  };
+
+  // Writes aRegion of a packed texture (at aX, aY in aPage, aWidth by aHeight) and
+  // carries its edge texels out into the border wherever aRegion reaches an edge.
+  static void UploadBordered(Renderer* aRenderer, Texture* aPage, int aX, int aY, int aWidth, int aHeight, TextureRegion aRegion, unsigned char const* aData, int aPitch)
+  {
+    int left = (0 == aRegion.X) ? cBorder : 0;
+    int top = (0 == aRegion.Y) ? cBorder : 0;
+    int right = (aWidth == aRegion.X + aRegion.Width) ? cBorder : 0;
+    int bottom = (aHeight == aRegion.Y + aRegion.Height) ? cBorder : 0;
+
+    // Build the bordered copy, edge texels clamped outward.
+    int paddedWidth = left + aRegion.Width + right;
+    int paddedHeight = top + aRegion.Height + bottom;
+    std::vector<unsigned char> padded(static_cast<size_t>(paddedWidth) * static_cast<size_t>(paddedHeight) * 4);
+
+    for (int y = 0; y < paddedHeight; ++y)
+    {
+      int sourceY = std::clamp(y - top, 0, aRegion.Height - 1);
+      unsigned char const* sourceRow = aData + static_cast<size_t>(sourceY) * aPitch;
+      unsigned char* row = padded.data() + static_cast<size_t>(y) * paddedWidth * 4;
+
+      memcpy(row + left * 4, sourceRow, static_cast<size_t>(aRegion.Width) * 4);
+      for (int border = 0; border < left; ++border)
+      {
+        memcpy(row + border * 4, sourceRow, 4);
+      }
+
+      for (int border = 0; border < right; ++border)
+      {
+        memcpy(row + (left + aRegion.Width + border) * 4, sourceRow + (aRegion.Width - 1) * 4, 4);
+      }
+    }
+
+    TextureRegion region{ aX + aRegion.X - left, aY + aRegion.Y - top, paddedWidth, paddedHeight };
+    aRenderer->UpdateTexture(aPage, region, padded.data(), paddedWidth * 4);
+  }
+
+  TextureAtlas::TextureAtlas(Renderer* aRenderer, int aPageSize, int aMaxTextureSize)
+    : mRenderer{ aRenderer }
+    , mPageSize{ aPageSize }
+    , mMaxTextureSize{ std::min(aMaxTextureSize, aPageSize - 2 * cBorder) }
+  {
+  }
+
+  TextureAtlas::~TextureAtlas()
+  {
+  }
+
+  std::unique_ptr<Texture> TextureAtlas::LoadTextureFromData(unsigned char const* aData, int aWidth, int aHeight, int aPitch)
+  {
+    if (!Accepts(aWidth, aHeight))
+    {
+      return nullptr;
+    }
+
+    stbrp_rect rect{};
+    rect.w = static_cast<stbrp_coord>(aWidth + 2 * cBorder);
+    rect.h = static_cast<stbrp_coord>(aHeight + 2 * cBorder);
+
+    std::shared_ptr<Page> page;
+    for (auto& candidate : mPages)
+    {
+      if (stbrp_pack_rects(&candidate->mPacker, &rect, 1))
+      {
+        page = candidate;
+        break;
+      }
+    }
+
+    if (nullptr == page)
+    {
+      page = std::make_shared<Page>(mRenderer, mPageSize);
+      if (nullptr == page->mTexture || !stbrp_pack_rects(&page->mPacker, &rect, 1))
+      {
+        return nullptr;
+      }
+
+      mPages.emplace_back(page);
+    }
+
+    UploadBordered(mRenderer, page->mTexture.get(), rect.x + cBorder, rect.y + cBorder, aWidth, aHeight, TextureRegion{ 0, 0, aWidth, aHeight }, aData, aPitch);
+
+    auto texture = std::make_unique<AtlasTexture>(page, rect.x + cBorder, rect.y + cBorder, aWidth, aHeight);
+    texture->Owner = this;
+    return texture;
+  }
+
+  void TextureAtlas::UpdateTexture(Texture* aTexture, TextureRegion aRegion, unsigned char const* aData, int aPitch)
+  {
+    if (this != aTexture->Owner)
+    {
+      mRenderer->UpdateTexture(aTexture, aRegion, aData, aPitch);
+      return;
+    }
+
+    auto texture = static_cast<AtlasTexture*>(aTexture);
+    UploadBordered(mRenderer, texture->mPage->mTexture.get(), texture->mX, texture->mY, texture->Width, texture->Height, aRegion, aData, aPitch);
+  }
+
+  void TextureAtlas::ReleaseEmptyPages()
+  {
+    // A spare page saves reallocating one every time a view of thumbnails empties
+    // and refills.
+    bool keptSpare = false;
+    std::erase_if(mPages, [&keptSpare](std::shared_ptr<Page> const& aPage)
+    {
+      if (0 != aPage->mLiveTextures)
+      {
+        return false;
+      }
+
+      if (false == keptSpare)
+      {
+        keptSpare = true;
+        return false;
+      }
+
+      return true;
+    });
+  }
+
+  std::unique_ptr<Texture> TextureAtlas::LoadTextureFromFile(std::u8string const& aFile)
+  {
+    auto image = DecodeImageFile(aFile);
+    if (!image)
+    {
+      return nullptr;
+    }
+
+    if (!Accepts(image->Width, image->Height))
+    {
+      return mRenderer->LoadTextureFromData(image->Pixels.data(), image->Layout, image->Width, image->Height, image->Pitch());
+    }
+
+    return LoadTextureFromData(image->Pixels.data(), image->Width, image->Height, image->Pitch());
+  }
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+
+#include "SOIS/Renderer.hpp"
+
+namespace SOIS
+{
+  // Packs small textures into shared pages using stb_rect_pack. Textures handed out
+  // share their page's GetTextureId and describe their sub rectangle through UvMin and
+  // UvMax, so a grid of thumbnails from one page draws as a single ImGui command
+  // instead of a texture switch and draw call per image.
+  class TextureAtlas
+  {
+  public:
+    TextureAtlas(Renderer* aRenderer, int aPageSize = 2048, int aMaxTextureSize = 256);
+    ~TextureAtlas();
+
+    TextureAtlas(TextureAtlas const&) = delete;
+    TextureAtlas& operator=(TextureAtlas const&) = delete;
+
+    // RGBA8 only. Returns nullptr if the texture is too large to be worth packing,
+    // load those through the Renderer directly.
+    std::unique_ptr<Texture> LoadTextureFromData(unsigned char const* aData, int aWidth, int aHeight, int aPitch);
+
+    // Images too large for the atlas are loaded as standalone textures instead.
+    std::unique_ptr<Texture> LoadTextureFromFile(std::u8string const& aFile);
+
+    // Renderer::UpdateTexture for textures we packed, aRegion is relative to aTexture.
+    // Anything else (including the standalone fallbacks) goes to the Renderer.
+    void UpdateTexture(Texture* aTexture, TextureRegion aRegion, unsigned char const* aData, int aPitch);
+
+    bool Accepts(int aWidth, int aHeight) const
+    {
+      return aWidth > 0 && aHeight > 0 && aWidth <= mMaxTextureSize && aHeight <= mMaxTextureSize;
+    }
+
+    size_t GetPageCount() const
+    {
+      return mPages.size();
+    }
+
+    // Frees pages nothing is packed into anymore, keeping one as a spare. The renderer
+    // calls this every NewFrame.
+    void ReleaseEmptyPages();
+
+    struct Page;
+
+  private:
+    Renderer* mRenderer;
+    int mPageSize;
+    int mMaxTextureSize;
+
+    // Pages are shared with the textures packed into them, so a page outlives the
+    // atlas for as long as anything still references it.
+    std::vector<std::shared_ptr<Page>> mPages;
+  };
+}
@@ -0,0 +1,130 @@
+#include <cinttypes>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <system_error>
+
+#include "SOIS/File.hpp"
+#include "SOIS/Hash.hpp"
+#include "SOIS/TextureCache.hpp"
+
+namespace SOIS
+{
+  static constexpr uint32_t cMagic = 0x54494F53; // "SOIT"
+
+  // Bump whenever the header, or the way we produce pixels for a given set of options
+  // (compressor, mip filter), changes. Old entries then just miss.
+  static constexpr uint32_t cVersion = 1;
+
+  // Payloads start a cache line in, so a mapped entry is aligned for SIMD reads.
+  static constexpr uint64_t cPayloadOffset = 64;
+
+  struct EntryHeader
+  {
+    uint32_t mMagic;
+    uint32_t mVersion;
+    uint64_t mKey;
+    int32_t mWidth;
+    int32_t mHeight;
+    int32_t mLayout;
+    int32_t mMipLevels;
+    uint64_t mPayloadOffset;
+    uint64_t mPayloadSize;
+  };
+
+  static_assert(sizeof(EntryHeader) <= cPayloadOffset);
+
+  static size_t GetPayloadSize(TextureLayout aLayout, int aWidth, int aHeight, int aMipLevels)
+  {
+    // cGenerateMips payloads only hold level 0, the renderer builds the rest.
+    return GetMipOffset(aLayout, aWidth, aHeight, std::max(1, aMipLevels));
+  }
+
+  TextureCache::TextureCache(std::u8string const& aDirectory)
+    : mDirectory{ aDirectory }
+  {
+    std::error_code error;
+    std::filesystem::create_directories(std::filesystem::path(mDirectory), error);
+  }
+
+  uint64_t TextureCache::MakeKey(unsigned char const* aSource, size_t aSize, TextureLoadOptions const& aOptions)
+  {
+    uint64_t key = Hash64(aSource, aSize);
+    key = HashCombine(key, static_cast<uint64_t>(aOptions.Layout));
+    key = HashCombine(key, aOptions.GenerateMips ? 1 : 0);
+    return HashCombine(key, cVersion);
+  }
+
+  std::u8string TextureCache::GetEntryPath(uint64_t aKey) const
+  {
+    char name[32];
+    snprintf(name, sizeof(name), "%016" PRIx64 ".soistex", aKey);
+    return (std::filesystem::path(mDirectory) / name).u8string();
+  }
+
+  std::optional<Image> TextureCache::Load(uint64_t aKey) const
+  {
+    auto file = MappedFile::Open(GetEntryPath(aKey));
+    if (!file || file->GetSize() < cPayloadOffset)
+    {
+      return std::nullopt;
+    }
+
+    EntryHeader header;
+    memcpy(&header, file->GetData(), sizeof(header));
+
+    if (cMagic != header.mMagic ||
+        cVersion != header.mVersion ||
+        aKey != header.mKey ||
+        header.mWidth <= 0 ||
+        header.mHeight <= 0 ||
+        header.mLayout < 0 ||
+        header.mLayout >= static_cast<int32_t>(TextureLayout::InvalidLayout) ||
+        header.mPayloadOffset < cPayloadOffset ||
+        header.mPayloadOffset + header.mPayloadSize > file->GetSize())
+    {
+      return std::nullopt;
+    }
+
+    Image image;
+    image.Width = header.mWidth;
+    image.Height = header.mHeight;
+    image.Layout = static_cast<TextureLayout>(header.mLayout);
+    image.MipLevels = header.mMipLevels;
+
+    if (GetPayloadSize(image.Layout, image.Width, image.Height, image.MipLevels) != header.mPayloadSize)
+    {
+      return std::nullopt;
+    }
+
+    // The one copy we make, straight from the page cache into the image.
+    auto payload = file->GetData() + header.mPayloadOffset;
+    image.Pixels.assign(payload, payload + header.mPayloadSize);
+    return image;
+  }
+
+  void TextureCache::Store(uint64_t aKey, Image const& aImage) const
+  {
+    size_t payloadSize = GetPayloadSize(aImage.Layout, aImage.Width, aImage.Height, aImage.MipLevels);
+    if (aImage.Pixels.size() < payloadSize)
+    {
+      return;
+    }
+
+    EntryHeader header;
+    header.mMagic = cMagic;
+    header.mVersion = cVersion;
+    header.mKey = aKey;
+    header.mWidth = aImage.Width;
+    header.mHeight = aImage.Height;
+    header.mLayout = static_cast<int32_t>(aImage.Layout);
+    header.mMipLevels = aImage.MipLevels;
+    header.mPayloadOffset = cPayloadOffset;
+    header.mPayloadSize = payloadSize;
+
+    unsigned char padded[cPayloadOffset] = {};
+    memcpy(padded, &header, sizeof(header));
+
+    WriteFileAtomic(GetEntryPath(aKey), padded, sizeof(padded), aImage.Pixels.data(), payloadSize);
+  }
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <string>
+
+#include "SOIS/Image.hpp"
+#include "SOIS/Renderer.hpp"
+
+namespace SOIS
+{
+  // Decoded images on disk, one file per entry, keyed by a hash of the source file's
+  // bytes and the load options that shaped the pixels (layout, mips). Entries are a
+  // fixed header followed by the payload at an aligned offset, so they can be mapped
+  // and handed to the renderer as is. Load and Store are safe to call from any thread.
+  class TextureCache
+  {
+  public:
+    TextureCache(std::u8string const& aDirectory);
+
+    static uint64_t MakeKey(unsigned char const* aSource, size_t aSize, TextureLoadOptions const& aOptions);
+
+    // nullopt on a miss, or if the entry is damaged or from an older version.
+    std::optional<Image> Load(uint64_t aKey) const;
+
+    // Failures are ignored, we just decode again next time.
+    void Store(uint64_t aKey, Image const& aImage) const;
+
+  private:
+    std::u8string GetEntryPath(uint64_t aKey) const;
+
+    std::u8string mDirectory;
+  };
+}
@@ -0,0 +1,890 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+  #include <emmintrin.h>
+  #define SOIS_COMPRESSION_SSE2 1
+#endif
+
+#include "SOIS/TextureCompression.hpp"
+#include "SOIS/ThreadPool.hpp"
+
+namespace SOIS
+{
+  ////////////////////
+  // Shared helpers
+  struct Color565
+  {
+    static uint16_t Pack(float const aColor[4])
+    {
+      auto quantize = [](float aValue, float aMax)
+      {
+        return static_cast<uint16_t>(std::clamp(std::round(aValue * aMax / 255.f), 0.f, aMax));
+      };
+
+      return static_cast<uint16_t>((quantize(aColor[0], 31.f) << 11) | (quantize(aColor[1], 63.f) << 5) | quantize(aColor[2], 31.f));
+    }
+
+    static void Unpack(uint16_t aColor, uint8_t aOut[4])
+    {
+      uint8_t r = (aColor >> 11) & 0x1F;
+      uint8_t g = (aColor >> 5) & 0x3F;
+      uint8_t b = aColor & 0x1F;
+      aOut[0] = static_cast<uint8_t>((r << 3) | (r >> 2));
+      aOut[1] = static_cast<uint8_t>((g << 2) | (g >> 4));
+      aOut[2] = static_cast<uint8_t>((b << 3) | (b >> 2));
+      aOut[3] = 255;
+    }
+  };
+
+  // Pulls a 4x4 block out of the image, clamping at the edges for partial blocks.
+  static void LoadBlock(unsigned char const* aData, int aWidth, int aHeight, int aPitch, int aBlockX, int aBlockY, uint8_t aBlock[64])
+  {
+    for (int y = 0; y < 4; ++y)
+    {
+      int sourceY = std::min(aBlockY * 4 + y, aHeight - 1);
+      unsigned char const* row = aData + static_cast<size_t>(sourceY) * aPitch;
+
+      for (int x = 0; x < 4; ++x)
+      {
+        int sourceX = std::min(aBlockX * 4 + x, aWidth - 1);
+        memcpy(aBlock + (y * 4 + x) * 4, row + sourceX * 4, 4);
+      }
+    }
+  }
+
+  // dot(pixel - aBase, aAxis) over all four channels, for all 16 pixels of a block. This
+  // is the inner loop of index selection in every format, so it's vectorized.
+  static void DotBlock(uint8_t const aBlock[64], int16_t const aBase[4], int16_t const aAxis[4], int32_t aOut[16])
+  {
+#if defined(SOIS_COMPRESSION_SSE2)
+    __m128i const zero = _mm_setzero_si128();
+    __m128i const base = _mm_set_epi16(aBase[3], aBase[2], aBase[1], aBase[0], aBase[3], aBase[2], aBase[1], aBase[0]);
+    __m128i const axis = _mm_set_epi16(aAxis[3], aAxis[2], aAxis[1], aAxis[0], aAxis[3], aAxis[2], aAxis[1], aAxis[0]);
+
+    for (int i = 0; i < 16; i += 4)
+    {
+      __m128i pixels = _mm_loadu_si128(reinterpret_cast<__m128i const*>(aBlock + i * 4));
+      __m128i low = _mm_madd_epi16(_mm_sub_epi16(_mm_unpacklo_epi8(pixels, zero), base), axis);
+      __m128i high = _mm_madd_epi16(_mm_sub_epi16(_mm_unpackhi_epi8(pixels, zero), base), axis);
+
+      // Each pixel is now split over two lanes (rg and ba), add the halves together.
+      __m128i evens = _mm_castps_si128(_mm_shuffle_ps(_mm_castsi128_ps(low), _mm_castsi128_ps(high), _MM_SHUFFLE(2, 0, 2, 0)));
+      __m128i odds = _mm_castps_si128(_mm_shuffle_ps(_mm_castsi128_ps(low), _mm_castsi128_ps(high), _MM_SHUFFLE(3, 1, 3, 1)));
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(aOut + i), _mm_add_epi32(evens, odds));
+    }
+#else
+    for (int i = 0; i < 16; ++i)
+    {
+      int32_t dot = 0;
+      for (int c = 0; c < 4; ++c)
+      {
+        dot += (aBlock[i * 4 + c] - aBase[c]) * aAxis[c];
+      }
+
+      aOut[i] = dot;
+    }
+#endif
+  }
+
+  // Projects every pixel onto the aStart->aEnd segment and returns the nearest of
+  // aLevels evenly spaced steps along it.
+  static void SelectIndices(uint8_t const aBlock[64], uint8_t const aStart[4], uint8_t const aEnd[4], int aChannels, int aLevels, int aIndices[16])
+  {
+    int16_t base[4] = { 0, 0, 0, 0 };
+    int16_t axis[4] = { 0, 0, 0, 0 };
+    int32_t lengthSquared = 0;
+
+    for (int c = 0; c < aChannels; ++c)
+    {
+      base[c] = aStart[c];
+      axis[c] = static_cast<int16_t>(aEnd[c] - aStart[c]);
+      lengthSquared += axis[c] * axis[c];
+    }
+
+    if (0 == lengthSquared)
+    {
+      std::fill(aIndices, aIndices + 16, 0);
+      return;
+    }
+
+    int32_t dots[16];
+    DotBlock(aBlock, base, axis, dots);
+
+    float scale = static_cast<float>(aLevels - 1) / static_cast<float>(lengthSquared);
+    for (int i = 0; i < 16; ++i)
+    {
+      int index = static_cast<int>(std::lround(dots[i] * scale));
+      aIndices[i] = std::clamp(index, 0, aLevels - 1);
+    }
+  }
+
+  // Endpoints along the principal axis of the included pixels, found with a few
+  // rounds of power iteration on their covariance.
+  static void FitEndpoints(uint8_t const aBlock[64], int aChannels, bool const* aExclude, float aInsetFraction, float aLow[4], float aHigh[4])
+  {
+    float mean[4] = { 0.f, 0.f, 0.f, 0.f };
+    float minimum[4] = { 255.f, 255.f, 255.f, 255.f };
+    float maximum[4] = { 0.f, 0.f, 0.f, 0.f };
+    int count = 0;
+
+    for (int i = 0; i < 16; ++i)
+    {
+      if (aExclude && aExclude[i])
+      {
+        continue;
+      }
+
+      for (int c = 0; c < aChannels; ++c)
+      {
+        float value = aBlock[i * 4 + c];
+        mean[c] += value;
+        minimum[c] = std::min(minimum[c], value);
+        maximum[c] = std::max(maximum[c], value);
+      }
+
+      ++count;
+    }
+
+    for (int c = 0; c < 4; ++c)
+    {
+      aLow[c] = 255.f;
+      aHigh[c] = 255.f;
+    }
+
+    if (0 == count)
+    {
+      return;
+    }
+
+    for (int c = 0; c < aChannels; ++c)
+    {
+      mean[c] /= count;
+    }
+
+    float covariance[4][4] = {};
+    for (int i = 0; i < 16; ++i)
+    {
+      if (aExclude && aExclude[i])
+      {
+        continue;
+      }
+
+      for (int row = 0; row < aChannels; ++row)
+      {
+        for (int column = 0; column < aChannels; ++column)
+        {
+          covariance[row][column] += (aBlock[i * 4 + row] - mean[row]) * (aBlock[i * 4 + column] - mean[column]);
+        }
+      }
+    }
+
+    float axis[4] = { 0.f, 0.f, 0.f, 0.f };
+    for (int c = 0; c < aChannels; ++c)
+    {
+      axis[c] = maximum[c] - minimum[c];
+    }
+
+    for (int iteration = 0; iteration < 4; ++iteration)
+    {
+      float next[4] = { 0.f, 0.f, 0.f, 0.f };
+      float length = 0.f;
+      for (int row = 0; row < aChannels; ++row)
+      {
+        for (int column = 0; column < aChannels; ++column)
+        {
+          next[row] += covariance[row][column] * axis[column];
+        }
+
+        length = std::max(length, std::abs(next[row]));
+      }
+
+      if (length < 1e-6f)
+      {
+        break;
+      }
+
+      for (int c = 0; c < aChannels; ++c)
+      {
+        axis[c] = next[c] / length;
+      }
+    }
+
+    float axisLengthSquared = 0.f;
+    for (int c = 0; c < aChannels; ++c)
+    {
+      axisLengthSquared += axis[c] * axis[c];
+    }
+
+    float lowT = 0.f;
+    float highT = 0.f;
+    if (axisLengthSquared > 1e-6f)
+    {
+      lowT = 1e30f;
+      highT = -1e30f;
+
+      for (int i = 0; i < 16; ++i)
+      {
+        if (aExclude && aExclude[i])
+        {
+          continue;
+        }
+
+        float t = 0.f;
+        for (int c = 0; c < aChannels; ++c)
+        {
+          t += (aBlock[i * 4 + c] - mean[c]) * axis[c];
+        }
+
+        t /= axisLengthSquared;
+        lowT = std::min(lowT, t);
+        highT = std::max(highT, t);
+      }
+
+      // Pull the ends in a little, the interpolated steps cover the extremes better
+      // than the extremes themselves.
+      float inset = (highT - lowT) * aInsetFraction;
+      lowT += inset;
+      highT -= inset;
+    }
+
+    for (int c = 0; c < aChannels; ++c)
+    {
+      aLow[c] = std::clamp(mean[c] + axis[c] * lowT, 0.f, 255.f);
+      aHigh[c] = std::clamp(mean[c] + axis[c] * highT, 0.f, 255.f);
+    }
+  }
+
+  // 128 bit little endian bit stream, as used by BC7.
+  struct BlockBits
+  {
+    void Write(uint32_t aValue, int aCount)
+    {
+      for (int i = 0; i < aCount; ++i, ++mPosition)
+      {
+        if ((aValue >> i) & 1)
+        {
+          mBytes[mPosition / 8] |= static_cast<uint8_t>(1 << (mPosition % 8));
+        }
+      }
+    }
+
+    uint32_t Read(int aCount)
+    {
+      uint32_t value = 0;
+      for (int i = 0; i < aCount; ++i, ++mPosition)
+      {
+        value |= static_cast<uint32_t>((mBytes[mPosition / 8] >> (mPosition % 8)) & 1) << i;
+      }
+
+      return value;
+    }
+
+    uint8_t mBytes[16] = {};
+    int mPosition = 0;
+  };
+
+  ////////////////////
+  // BC1 / BC3
+  static void EncodeColorBlock(uint8_t const aBlock[64], uint8_t* aOut, bool aAllowTransparency)
+  {
+    bool transparent[16];
+    int transparentCount = 0;
+    for (int i = 0; i < 16; ++i)
+    {
+      transparent[i] = aAllowTransparency && aBlock[i * 4 + 3] < 128;
+      transparentCount += transparent[i] ? 1 : 0;
+    }
+
+    uint32_t indexBits = 0;
+    uint16_t color0;
+    uint16_t color1;
+
+    if (16 == transparentCount)
+    {
+      // color0 <= color1 selects the three color mode, where index 3 is transparent.
+      color0 = 0;
+      color1 = 0;
+      indexBits = 0xFFFFFFFF;
+    }
+    else
+    {
+      float low[4];
+      float high[4];
+      FitEndpoints(aBlock, 3, transparentCount ? transparent : nullptr, 1.f / 32.f, low, high);
+
+      color0 = Color565::Pack(high);
+      color1 = Color565::Pack(low);
+
+      bool threeColor = transparentCount > 0;
+
+      // The order of the endpoints picks the mode, four colors needs color0 > color1.
+      if (threeColor ? (color0 > color1) : (color0 < color1))
+      {
+        std::swap(color0, color1);
+      }
+
+      uint8_t start[4];
+      uint8_t end[4];
+      Color565::Unpack(color0, start);
+      Color565::Unpack(color1, end);
+
+      int steps[16];
+      SelectIndices(aBlock, start, end, 3, threeColor ? 3 : 4, steps);
+
+      // Positions along the segment to the index the format stores for them.
+      static constexpr uint32_t fourColorOrder[4] = { 0, 2, 3, 1 };
+      static constexpr uint32_t threeColorOrder[3] = { 0, 2, 1 };
+
+      for (int i = 0; i < 16; ++i)
+      {
+        uint32_t index;
+        if (transparent[i])
+        {
+          index = 3;
+        }
+        else if (color0 == color1)
+        {
+          index = 0;
+        }
+        else
+        {
+          index = threeColor ? threeColorOrder[steps[i]] : fourColorOrder[steps[i]];
+        }
+
+        indexBits |= index << (i * 2);
+      }
+    }
+
+    aOut[0] = static_cast<uint8_t>(color0 & 0xFF);
+    aOut[1] = static_cast<uint8_t>(color0 >> 8);
+    aOut[2] = static_cast<uint8_t>(color1 & 0xFF);
+    aOut[3] = static_cast<uint8_t>(color1 >> 8);
+    memcpy(aOut + 4, &indexBits, 4);
+  }
+
+  static void EncodeAlphaBlock(uint8_t const aBlock[64], uint8_t* aOut)
+  {
+    int minimum = 255;
+    int maximum = 0;
+    for (int i = 0; i < 16; ++i)
+    {
+      minimum = std::min<int>(minimum, aBlock[i * 4 + 3]);
+      maximum = std::max<int>(maximum, aBlock[i * 4 + 3]);
+    }
+
+    // alpha0 > alpha1 selects the eight value mode.
+    aOut[0] = static_cast<uint8_t>(maximum);
+    aOut[1] = static_cast<uint8_t>(minimum);
+
+    uint64_t indexBits = 0;
+    if (maximum != minimum)
+    {
+      float scale = 7.f / static_cast<float>(maximum - minimum);
+      for (int i = 0; i < 16; ++i)
+      {
+        int step = static_cast<int>(std::lround((aBlock[i * 4 + 3] - minimum) * scale));
+
+        // Step 7 is alpha0, step 0 is alpha1, the rest count down from index 2.
+        uint64_t index = (7 == step) ? 0 : (0 == step) ? 1 : static_cast<uint64_t>(8 - step);
+        indexBits |= index << (i * 3);
+      }
+    }
+
+    for (int i = 0; i < 6; ++i)
+    {
+      aOut[2 + i] = static_cast<uint8_t>(indexBits >> (i * 8));
+    }
+  }
+
+  static void DecodeColorBlock(uint8_t const* aIn, uint8_t aBlock[64], bool aAlwaysFourColor)
+  {
+    uint16_t color0 = static_cast<uint16_t>(aIn[0] | (aIn[1] << 8));
+    uint16_t color1 = static_cast<uint16_t>(aIn[2] | (aIn[3] << 8));
+
+    uint8_t palette[4][4];
+    Color565::Unpack(color0, palette[0]);
+    Color565::Unpack(color1, palette[1]);
+
+    for (int c = 0; c < 3; ++c)
+    {
+      if (aAlwaysFourColor || color0 > color1)
+      {
+        palette[2][c] = static_cast<uint8_t>((2 * palette[0][c] + palette[1][c]) / 3);
+        palette[3][c] = static_cast<uint8_t>((palette[0][c] + 2 * palette[1][c]) / 3);
+      }
+      else
+      {
+        palette[2][c] = static_cast<uint8_t>((palette[0][c] + palette[1][c]) / 2);
+        palette[3][c] = 0;
+      }
+    }
+
+    palette[2][3] = 255;
+    palette[3][3] = (aAlwaysFourColor || color0 > color1) ? 255 : 0;
+
+    uint32_t indexBits;
+    memcpy(&indexBits, aIn + 4, 4);
+    for (int i = 0; i < 16; ++i)
+    {
+      memcpy(aBlock + i * 4, palette[(indexBits >> (i * 2)) & 3], 4);
+    }
+  }
+
+  static void DecodeAlphaBlock(uint8_t const* aIn, uint8_t aBlock[64])
+  {
+    int alpha0 = aIn[0];
+    int alpha1 = aIn[1];
+
+    uint8_t palette[8];
+    palette[0] = static_cast<uint8_t>(alpha0);
+    palette[1] = static_cast<uint8_t>(alpha1);
+
+    if (alpha0 > alpha1)
+    {
+      for (int i = 2; i < 8; ++i)
+      {
+        palette[i] = static_cast<uint8_t>(((8 - i) * alpha0 + (i - 1) * alpha1) / 7);
+      }
+    }
+    else
+    {
+      for (int i = 2; i < 6; ++i)
+      {
+        palette[i] = static_cast<uint8_t>(((6 - i) * alpha0 + (i - 1) * alpha1) / 5);
+      }
+
+      palette[6] = 0;
+      palette[7] = 255;
+    }
+
+    uint64_t indexBits = 0;
+    for (int i = 0; i < 6; ++i)
+    {
+      indexBits |= static_cast<uint64_t>(aIn[2 + i]) << (i * 8);
+    }
+
+    for (int i = 0; i < 16; ++i)
+    {
+      aBlock[i * 4 + 3] = palette[(indexBits >> (i * 3)) & 7];
+    }
+  }
+
+  ////////////////////
+  // BC7 encoding, mode 6 only
+  static constexpr int cBc7Weights4[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+  // Mode 6 endpoints are 7 bits per channel plus a shared low bit (the p-bit), we try
+  // both p-bits and keep whichever lands closer.
+  static void QuantizeBc7Endpoint(float const aEndpoint[4], uint8_t aQuantized[4], uint32_t& aPBit, uint8_t aReconstructed[4])
+  {
+    float bestError = 1e30f;
+
+    for (uint32_t pBit = 0; pBit < 2; ++pBit)
+    {
+      uint8_t quantized[4];
+      uint8_t reconstructed[4];
+      float error = 0.f;
+
+      for (int c = 0; c < 4; ++c)
+      {
+        int value = static_cast<int>(std::lround((aEndpoint[c] - pBit) / 2.f));
+        quantized[c] = static_cast<uint8_t>(std::clamp(value, 0, 127));
+        reconstructed[c] = static_cast<uint8_t>((quantized[c] << 1) | pBit);
+
+        float difference = reconstructed[c] - aEndpoint[c];
+        error += difference * difference;
+      }
+
+      if (error < bestError)
+      {
+        bestError = error;
+        aPBit = pBit;
+        memcpy(aQuantized, quantized, 4);
+        memcpy(aReconstructed, reconstructed, 4);
+      }
+    }
+  }
+
+  static void EncodeBc7Block(uint8_t const aBlock[64], uint8_t* aOut)
+  {
+    float low[4];
+    float high[4];
+    FitEndpoints(aBlock, 4, nullptr, 0.f, low, high);
+
+    uint8_t quantized[2][4];
+    uint8_t reconstructed[2][4];
+    uint32_t pBits[2];
+    QuantizeBc7Endpoint(low, quantized[0], pBits[0], reconstructed[0]);
+    QuantizeBc7Endpoint(high, quantized[1], pBits[1], reconstructed[1]);
+
+    int indices[16];
+    SelectIndices(aBlock, reconstructed[0], reconstructed[1], 4, 16, indices);
+
+    // The first index is stored without its top bit, so it has to be in the lower half.
+    if (indices[0] >= 8)
+    {
+      std::swap(quantized[0], quantized[1]);
+      std::swap(pBits[0], pBits[1]);
+      for (int& index : indices)
+      {
+        index = 15 - index;
+      }
+    }
+
+    BlockBits bits;
+    bits.Write(1 << 6, 7);
+
+    for (int c = 0; c < 4; ++c)
+    {
+      bits.Write(quantized[0][c], 7);
+      bits.Write(quantized[1][c], 7);
+    }
+
+    bits.Write(pBits[0], 1);
+    bits.Write(pBits[1], 1);
+
+    bits.Write(indices[0], 3);
+    for (int i = 1; i < 16; ++i)
+    {
+      bits.Write(indices[i], 4);
+    }
+
+    memcpy(aOut, bits.mBytes, 16);
+  }
+
+  ////////////////////
+  // BC7 decoding, all modes. Tables are from the BC7 spec.
+  struct Bc7Mode
+  {
+    int mSubsets;
+    int mPartitionBits;
+    int mRotationBits;
+    int mIndexSelectionBits;
+    int mColorBits;
+    int mAlphaBits;
+    int mEndpointPBits;
+    int mSharedPBits;
+    int mIndexBits;
+    int mSecondaryIndexBits;
+  };
+
+  static constexpr Bc7Mode cBc7Modes[8] =
+  {
+    { 3, 4, 0, 0, 4, 0, 1, 0, 3, 0 },
+    { 2, 6, 0, 0, 6, 0, 0, 1, 3, 0 },
+    { 3, 6, 0, 0, 5, 0, 0, 0, 2, 0 },
+    { 2, 6, 0, 0, 7, 0, 1, 0, 2, 0 },
+    { 1, 0, 2, 1, 5, 6, 0, 0, 2, 3 },
+    { 1, 0, 2, 0, 7, 8, 0, 0, 2, 2 },
+    { 1, 0, 0, 0, 7, 7, 1, 0, 4, 0 },
+    { 2, 6, 0, 0, 5, 5, 1, 0, 2, 0 },
+  };
+
+  static constexpr int cBc7Weights2[4] = { 0, 21, 43, 64 };
+  static constexpr int cBc7Weights3[8] = { 0, 9, 18, 27, 37, 46, 55, 64 };
+
+  static constexpr uint8_t cBc7Partitions2[64][16] =
+  {
+    { 0,0,1,1,0,0,1,1,0,0,1,1,0,0,1,1 }, { 0,0,0,1,0,0,0,1,0,0,0,1,0,0,0,1 }, { 0,1,1,1,0,1,1,1,0,1,1,1,0,1,1,1 }, { 0,0,0,1,0,0,1,1,0,0,1,1,0,1,1,1 },
+    { 0,0,0,0,0,0,0,1,0,0,0,1,0,0,1,1 }, { 0,0,1,1,0,1,1,1,0,1,1,1,1,1,1,1 }, { 0,0,0,1,0,0,1,1,0,1,1,1,1,1,1,1 }, { 0,0,0,0,0,0,0,1,0,0,1,1,0,1,1,1 },
+    { 0,0,0,0,0,0,0,0,0,0,0,1,0,0,1,1 }, { 0,0,1,1,0,1,1,1,1,1,1,1,1,1,1,1 }, { 0,0,0,0,0,0,0,1,0,1,1,1,1,1,1,1 }, { 0,0,0,0,0,0,0,0,0,0,0,1,0,1,1,1 },
+    { 0,0,0,1,0,1,1,1,1,1,1,1,1,1,1,1 }, { 0,0,0,0,0,0,0,0,1,1,1,1,1,1,1,1 }, { 0,0,0,0,1,1,1,1,1,1,1,1,1,1,1,1 }, { 0,0,0,0,0,0,0,0,0,0,0,0,1,1,1,1 },
+    { 0,0,0,0,1,0,0,0,1,1,1,0,1,1,1,1 }, { 0,1,1,1,0,0,0,1,0,0,0,0,0,0,0,0 }, { 0,0,0,0,0,0,0,0,1,0,0,0,1,1,1,0 }, { 0,1,1,1,0,0,1,1,0,0,0,1,0,0,0,0 },
+    { 0,0,1,1,0,0,0,1,0,0,0,0,0,0,0,0 }, { 0,0,0,0,1,0,0,0,1,1,0,0,1,1,1,0 }, { 0,0,0,0,0,0,0,0,1,0,0,0,1,1,0,0 }, { 0,1,1,1,0,0,1,1,0,0,1,1,0,0,0,1 },
+    { 0,0,1,1,0,0,0,1,0,0,0,1,0,0,0,0 }, { 0,0,0,0,1,0,0,0,1,0,0,0,1,1,0,0 }, { 0,1,1,0,0,1,1,0,0,1,1,0,0,1,1,0 }, { 0,0,1,1,0,1,1,0,0,1,1,0,1,1,0,0 },
+    { 0,0,0,1,0,1,1,1,1,1,1,0,1,0,0,0 }, { 0,0,0,0,1,1,1,1,1,1,1,1,0,0,0,0 }, { 0,1,1,1,0,0,0,1,1,0,0,0,1,1,1,0 }, { 0,0,1,1,1,0,0,1,1,0,0,1,1,1,0,0 },
+    { 0,1,0,1,0,1,0,1,0,1,0,1,0,1,0,1 }, { 0,0,0,0,1,1,1,1,0,0,0,0,1,1,1,1 }, { 0,1,0,1,1,0,1,0,0,1,0,1,1,0,1,0 }, { 0,0,1,1,0,0,1,1,1,1,0,0,1,1,0,0 },
+    { 0,0,1,1,1,1,0,0,0,0,1,1,1,1,0,0 }, { 0,1,0,1,0,1,0,1,1,0,1,0,1,0,1,0 }, { 0,1,1,0,1,0,0,1,0,1,1,0,1,0,0,1 }, { 0,1,0,1,1,0,1,0,1,0,1,0,0,1,0,1 },
+    { 0,1,1,1,0,0,1,1,1,1,0,0,1,1,1,0 }, { 0,0,0,1,0,0,1,1,1,1,0,0,1,0,0,0 }, { 0,0,1,1,0,0,1,0,0,1,0,0,1,1,0,0 }, { 0,0,1,1,1,0,1,1,1,1,0,1,1,1,0,0 },
+    { 0,1,1,0,1,0,0,1,1,0,0,1,0,1,1,0 }, { 0,0,1,1,1,1,0,0,1,1,0,0,0,0,1,1 }, { 0,1,1,0,0,1,1,0,1,0,0,1,1,0,0,1 }, { 0,0,0,0,0,1,1,0,0,1,1,0,0,0,0,0 },
+    { 0,1,0,0,1,1,1,0,0,1,0,0,0,0,0,0 }, { 0,0,1,0,0,1,1,1,0,0,1,0,0,0,0,0 }, { 0,0,0,0,0,0,1,0,0,1,1,1,0,0,1,0 }, { 0,0,0,0,0,1,0,0,1,1,1,0,0,1,0,0 },
+    { 0,1,1,0,1,1,0,0,1,0,0,1,0,0,1,1 }, { 0,0,1,1,0,1,1,0,1,1,0,0,1,0,0,1 }, { 0,1,1,0,0,0,1,1,1,0,0,1,1,1,0,0 }, { 0,0,1,1,1,0,0,1,1,1,0,0,0,1,1,0 },
+    { 0,1,1,0,1,1,0,0,1,1,0,0,1,0,0,1 }, { 0,1,1,0,0,0,1,1,0,0,1,1,1,0,0,1 }, { 0,1,1,1,1,1,1,0,1,0,0,0,0,0,0,1 }, { 0,0,0,1,1,0,0,0,1,1,1,0,0,1,1,1 },
+    { 0,0,0,0,1,1,1,1,0,0,1,1,0,0,1,1 }, { 0,0,1,1,0,0,1,1,1,1,1,1,0,0,0,0 }, { 0,0,1,0,0,0,1,0,1,1,1,0,1,1,1,0 }, { 0,1,0,0,0,1,0,0,0,1,1,1,0,1,1,1 },
+  };
+
+  static constexpr uint8_t cBc7Partitions3[64][16] =
+  {
+    { 0,0,1,1,0,0,1,1,0,2,2,1,2,2,2,2 }, { 0,0,0,1,0,0,1,1,2,2,1,1,2,2,2,1 }, { 0,0,0,0,2,0,0,1,2,2,1,1,2,2,1,1 }, { 0,2,2,2,0,0,2,2,0,0,1,1,0,1,1,1 },
+    { 0,0,0,0,0,0,0,0,1,1,2,2,1,1,2,2 }, { 0,0,1,1,0,0,1,1,0,0,2,2,0,0,2,2 }, { 0,0,2,2,0,0,2,2,1,1,1,1,1,1,1,1 }, { 0,0,1,1,0,0,1,1,2,2,1,1,2,2,1,1 },
+    { 0,0,0,0,0,0,0,0,1,1,1,1,2,2,2,2 }, { 0,0,0,0,1,1,1,1,1,1,1,1,2,2,2,2 }, { 0,0,0,0,1,1,1,1,2,2,2,2,2,2,2,2 }, { 0,0,1,2,0,0,1,2,0,0,1,2,0,0,1,2 },
+    { 0,1,1,2,0,1,1,2,0,1,1,2,0,1,1,2 }, { 0,1,2,2,0,1,2,2,0,1,2,2,0,1,2,2 }, { 0,0,1,1,0,1,1,2,1,1,2,2,1,2,2,2 }, { 0,0,1,1,2,0,0,1,2,2,0,0,2,2,2,0 },
+    { 0,0,0,1,0,0,1,1,0,1,1,2,1,1,2,2 }, { 0,1,1,1,0,0,1,1,2,0,0,1,2,2,0,0 }, { 0,0,0,0,1,1,2,2,1,1,2,2,1,1,2,2 }, { 0,0,2,2,0,0,2,2,0,0,2,2,1,1,1,1 },
+    { 0,1,1,1,0,1,1,1,0,2,2,2,0,2,2,2 }, { 0,0,0,1,0,0,0,1,2,2,2,1,2,2,2,1 }, { 0,0,0,0,0,0,1,1,0,1,2,2,0,1,2,2 }, { 0,0,0,0,1,1,0,0,2,2,1,0,2,2,1,0 },
+    { 0,1,2,2,0,1,2,2,0,0,1,1,0,0,0,0 }, { 0,0,1,2,0,0,1,2,1,1,2,2,2,2,2,2 }, { 0,1,1,0,1,2,2,1,1,2,2,1,0,1,1,0 }, { 0,0,0,0,0,1,1,0,1,2,2,1,1,2,2,1 },
+    { 0,0,2,2,1,1,0,2,1,1,0,2,0,0,2,2 }, { 0,1,1,0,0,1,1,0,2,0,0,2,2,2,2,2 }, { 0,0,1,1,0,1,2,2,0,1,2,2,0,0,1,1 }, { 0,0,0,0,2,0,0,0,2,2,1,1,2,2,2,1 },
+    { 0,0,0,0,0,0,0,2,1,1,2,2,1,2,2,2 }, { 0,2,2,2,0,0,2,2,0,0,1,2,0,0,1,1 }, { 0,0,1,1,0,0,1,2,0,0,2,2,0,2,2,2 }, { 0,1,2,0,0,1,2,0,0,1,2,0,0,1,2,0 },
+    { 0,0,0,0,1,1,1,1,2,2,2,2,0,0,0,0 }, { 0,1,2,0,1,2,0,1,2,0,1,2,0,1,2,0 }, { 0,1,2,0,2,0,1,2,1,2,0,1,0,1,2,0 }, { 0,0,1,1,2,2,0,0,1,1,2,2,0,0,1,1 },
+    { 0,0,1,1,1,1,2,2,2,2,0,0,0,0,1,1 }, { 0,1,0,1,0,1,0,1,2,2,2,2,2,2,2,2 }, { 0,0,0,0,0,0,0,0,2,1,2,1,2,1,2,1 }, { 0,0,2,2,1,1,2,2,0,0,2,2,1,1,2,2 },
+    { 0,0,2,2,0,0,1,1,0,0,2,2,0,0,1,1 }, { 0,2,2,0,1,2,2,1,0,2,2,0,1,2,2,1 }, { 0,1,0,1,2,2,2,2,2,2,2,2,0,1,0,1 }, { 0,0,0,0,2,1,2,1,2,1,2,1,2,1,2,1 },
+    { 0,1,0,1,0,1,0,1,0,1,0,1,2,2,2,2 }, { 0,2,2,2,0,1,1,1,0,2,2,2,0,1,1,1 }, { 0,0,0,2,1,1,1,2,0,0,0,2,1,1,1,2 }, { 0,0,0,0,2,1,1,2,2,1,1,2,2,1,1,2 },
+    { 0,2,2,2,0,1,1,1,0,1,1,1,0,2,2,2 }, { 0,0,0,2,1,1,1,2,1,1,1,2,0,0,0,2 }, { 0,1,1,0,0,1,1,0,0,1,1,0,2,2,2,2 }, { 0,0,0,0,0,0,0,0,2,1,1,2,2,1,1,2 },
+    { 0,1,1,0,0,1,1,0,2,2,2,2,2,2,2,2 }, { 0,0,2,2,0,0,1,1,0,0,1,1,0,0,2,2 }, { 0,0,2,2,1,1,2,2,1,1,2,2,0,0,2,2 }, { 0,0,0,0,0,0,0,0,0,0,0,0,2,1,1,2 },
+    { 0,0,0,2,0,0,0,1,0,0,0,2,0,0,0,1 }, { 0,2,2,2,1,2,2,2,0,2,2,2,1,2,2,2 }, { 0,1,0,1,2,2,2,2,2,2,2,2,2,2,2,2 }, { 0,1,1,1,2,0,1,1,2,2,0,1,2,2,2,0 },
+  };
+
+  // Index of the pixel in each extra subset whose index drops its top bit.
+  static constexpr uint8_t cBc7Anchors2[64] =
+  {
+    15,15,15,15,15,15,15,15, 15,15,15,15,15,15,15,15, 15, 2, 8, 2, 2, 8, 8,15,  2, 8, 2, 2, 8, 8, 2, 2,
+    15,15, 6, 8, 2, 8,15,15,  2, 8, 2, 2, 2,15,15, 6,  6, 2, 6, 8,15,15, 2, 2, 15,15,15,15,15, 2, 2,15,
+  };
+
+  static constexpr uint8_t cBc7Anchors3[2][64] =
+  {
+    {
+       3, 3,15,15, 8, 3,15,15,  8, 8, 6, 6, 6, 5, 3, 3,  3, 3, 8,15, 3, 3, 6,10,  5, 8, 8, 6, 8, 5,15,15,
+       8,15, 3, 5, 6,10, 8,15, 15, 3,15, 5,15,15,15,15,  3,15, 5, 5, 5, 8, 5,10,  5,10, 8,13,15,12, 3, 3,
+    },
+    {
+      15, 8, 8, 3,15,15, 3, 8, 15,15,15,15,15,15,15, 8, 15, 8,15, 3,15, 8,15, 8,  3,15, 6,10,15,15,10, 8,
+      15, 3,15,10,10, 8, 9,10,  6,15, 8,15, 3, 6, 6, 8, 15, 3,15,15,15,15,15,15, 15,15,15,15, 3,15,15, 8,
+    },
+  };
+
+  static int const* GetBc7Weights(int aIndexBits)
+  {
+    return (2 == aIndexBits) ? cBc7Weights2 : (3 == aIndexBits) ? cBc7Weights3 : cBc7Weights4;
+  }
+
+  static void DecodeBc7Block(uint8_t const* aIn, uint8_t aBlock[64])
+  {
+    // Mode is the position of the lowest set bit, a block without one is reserved and
+    // decodes as transparent black.
+    int mode = 0;
+    while (mode < 8 && 0 == ((aIn[0] >> mode) & 1))
+    {
+      ++mode;
+    }
+
+    if (8 == mode)
+    {
+      memset(aBlock, 0, 64);
+      return;
+    }
+
+    Bc7Mode const& info = cBc7Modes[mode];
+    BlockBits bits;
+    memcpy(bits.mBytes, aIn, 16);
+    bits.Read(mode + 1);
+
+    uint32_t partition = bits.Read(info.mPartitionBits);
+    uint32_t rotation = bits.Read(info.mRotationBits);
+    uint32_t indexSelection = bits.Read(info.mIndexSelectionBits);
+
+    // Endpoints are stored channel by channel, then subset, then which end.
+    uint32_t endpoints[3][2][4] = {};
+    for (int c = 0; c < 4; ++c)
+    {
+      int channelBits = (c < 3) ? info.mColorBits : info.mAlphaBits;
+      for (int s = 0; s < info.mSubsets; ++s)
+      {
+        endpoints[s][0][c] = bits.Read(channelBits);
+        endpoints[s][1][c] = bits.Read(channelBits);
+      }
+    }
+
+    int colorBits = info.mColorBits;
+    int alphaBits = info.mAlphaBits;
+    if (info.mEndpointPBits || info.mSharedPBits)
+    {
+      for (int s = 0; s < info.mSubsets; ++s)
+      {
+        uint32_t pBits[2];
+        pBits[0] = bits.Read(1);
+        pBits[1] = info.mSharedPBits ? pBits[0] : bits.Read(1);
+
+        for (int e = 0; e < 2; ++e)
+        {
+          for (int c = 0; c < 4; ++c)
+          {
+            endpoints[s][e][c] = (endpoints[s][e][c] << 1) | pBits[e];
+          }
+        }
+      }
+
+      ++colorBits;
+      alphaBits += (0 != alphaBits) ? 1 : 0;
+    }
+
+    // Widen to 8 bits by repeating the top bits, modes without alpha are opaque.
+    for (int s = 0; s < info.mSubsets; ++s)
+    {
+      for (int e = 0; e < 2; ++e)
+      {
+        for (int c = 0; c < 4; ++c)
+        {
+          int channelBits = (c < 3) ? colorBits : alphaBits;
+          uint32_t& value = endpoints[s][e][c];
+          value = (0 == channelBits) ? 255 : (value << (8 - channelBits)) | (value >> (2 * channelBits - 8));
+        }
+      }
+    }
+
+    uint8_t subsets[16];
+    for (int i = 0; i < 16; ++i)
+    {
+      subsets[i] = (1 == info.mSubsets) ? 0 : (2 == info.mSubsets) ? cBc7Partitions2[partition][i] : cBc7Partitions3[partition][i];
+    }
+
+    auto isAnchor = [&](int aPixel)
+    {
+      return 0 == aPixel
+        || (2 == info.mSubsets && cBc7Anchors2[partition] == aPixel)
+        || (3 == info.mSubsets && (cBc7Anchors3[0][partition] == aPixel || cBc7Anchors3[1][partition] == aPixel));
+    };
+
+    uint32_t indices[16];
+    for (int i = 0; i < 16; ++i)
+    {
+      indices[i] = bits.Read(info.mIndexBits - (isAnchor(i) ? 1 : 0));
+    }
+
+    // Modes 4 and 5 have a second set of indices, the color uses one and the alpha the
+    // other.
+    uint32_t secondaryIndices[16] = {};
+    if (0 != info.mSecondaryIndexBits)
+    {
+      for (int i = 0; i < 16; ++i)
+      {
+        secondaryIndices[i] = bits.Read(info.mSecondaryIndexBits - (0 == i ? 1 : 0));
+      }
+    }
+
+    for (int i = 0; i < 16; ++i)
+    {
+      uint32_t const (&low)[4] = endpoints[subsets[i]][0];
+      uint32_t const (&high)[4] = endpoints[subsets[i]][1];
+
+      int colorWeight = GetBc7Weights(info.mIndexBits)[indices[i]];
+      int alphaWeight = colorWeight;
+      if (0 != info.mSecondaryIndexBits)
+      {
+        int secondaryWeight = GetBc7Weights(info.mSecondaryIndexBits)[secondaryIndices[i]];
+        alphaWeight = indexSelection ? colorWeight : secondaryWeight;
+        colorWeight = indexSelection ? secondaryWeight : colorWeight;
+      }
+
+      uint8_t* pixel = aBlock + i * 4;
+      for (int c = 0; c < 4; ++c)
+      {
+        int weight = (c < 3) ? colorWeight : alphaWeight;
+        pixel[c] = static_cast<uint8_t>(((64 - weight) * low[c] + weight * high[c] + 32) >> 6);
+      }
+
+      // Rotation swaps alpha with one of the color channels.
+      if (0 != rotation)
+      {
+        std::swap(pixel[rotation - 1], pixel[3]);
+      }
+    }
+  }
+
+  ////////////////////
+  // Entry points
+  std::vector<unsigned char> CompressTexture(unsigned char const* aData, int aWidth, int aHeight, int aPitch, TextureLayout aLayout, ThreadPool* aPool)
+  {
+    if (!IsBlockCompressed(aLayout) || aWidth <= 0 || aHeight <= 0)
+    {
+      return {};
+    }
+
+    int blocksX = (aWidth + 3) / 4;
+    int blocksY = (aHeight + 3) / 4;
+    int blockSize = GetBlockSize(aLayout);
+
+    std::vector<unsigned char> compressed(GetTextureDataSize(aLayout, aWidth, aHeight));
+
+    auto compressRow = [&](size_t aBlockY)
+    {
+      uint8_t block[64];
+      unsigned char* out = compressed.data() + aBlockY * blocksX * blockSize;
+
+      for (int blockX = 0; blockX < blocksX; ++blockX, out += blockSize)
+      {
+        LoadBlock(aData, aWidth, aHeight, aPitch, blockX, static_cast<int>(aBlockY), block);
+
+        switch (aLayout)
+        {
+        case TextureLayout::Bc1_Rgba_Unorm:
+        case TextureLayout::Bc1_Rgba_Srgb:
+          EncodeColorBlock(block, out, true);
+          break;
+        case TextureLayout::Bc3_Unorm:
+        case TextureLayout::Bc3_Srgb:
+          EncodeAlphaBlock(block, out);
+          EncodeColorBlock(block, out + 8, false);
+          break;
+        default:
+          EncodeBc7Block(block, out);
+          break;
+        }
+      }
+    };
+
+    if (nullptr != aPool && blocksY > 1)
+    {
+      aPool->ParallelFor(blocksY, compressRow);
+    }
+    else
+    {
+      for (int blockY = 0; blockY < blocksY; ++blockY)
+      {
+        compressRow(blockY);
+      }
+    }
+
+    return compressed;
+  }
+
+  std::vector<unsigned char> DecompressTexture(unsigned char const* aData, int aWidth, int aHeight, TextureLayout aLayout)
+  {
+    if (!IsBlockCompressed(aLayout) || aWidth <= 0 || aHeight <= 0)
+    {
+      return {};
+    }
+
+    int blocksX = (aWidth + 3) / 4;
+    int blocksY = (aHeight + 3) / 4;
+    int blockSize = GetBlockSize(aLayout);
+
+    std::vector<unsigned char> pixels(static_cast<size_t>(aWidth) * static_cast<size_t>(aHeight) * 4);
+    unsigned char const* in = aData;
+
+    for (int blockY = 0; blockY < blocksY; ++blockY)
+    {
+      for (int blockX = 0; blockX < blocksX; ++blockX, in += blockSize)
+      {
+        uint8_t block[64];
+
+        switch (aLayout)
+        {
+        case TextureLayout::Bc1_Rgba_Unorm:
+        case TextureLayout::Bc1_Rgba_Srgb:
+          DecodeColorBlock(in, block, false);
+          break;
+        case TextureLayout::Bc3_Unorm:
+        case TextureLayout::Bc3_Srgb:
+          DecodeColorBlock(in + 8, block, true);
+          DecodeAlphaBlock(in, block);
+          break;
+        default:
+          DecodeBc7Block(in, block);
+          break;
+        }
+
+        for (int y = 0; y < 4 && (blockY * 4 + y) < aHeight; ++y)
+        {
+          int columns = std::min(4, aWidth - blockX * 4);
+          unsigned char* row = pixels.data() + (static_cast<size_t>(blockY * 4 + y) * aWidth + blockX * 4) * 4;
+          memcpy(row, block + y * 16, static_cast<size_t>(columns) * 4);
+        }
+      }
+    }
+
+    return pixels;
+  }
+}
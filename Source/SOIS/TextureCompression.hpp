@@ -0,0 +1,21 @@
+#pragma once
+
+#include <vector>
+
+#include "SOIS/Renderer.hpp"
+
+namespace SOIS
+{
+  class ThreadPool;
+
+  // CPU block compression from RGBA8 into any of the Bc layouts. BC1 and BC3 use a
+  // principal axis fit, BC7 is encoded entirely in mode 6 (single subset RGBA, 4 bit
+  // indices), which is fast and holds up well for photos and UI art. Rows of blocks
+  // are spread over aPool when one is given.
+  std::vector<unsigned char> CompressTexture(unsigned char const* aData, int aWidth, int aHeight, int aPitch, TextureLayout aLayout, ThreadPool* aPool = nullptr);
+
+  // Expands tightly packed rows of blocks back to tightly packed RGBA8, for backends or
+  // devices that can't sample the format directly. Handles every BC7 mode, not just the
+  // one we encode, so BC7 from other tools decodes too.
+  std::vector<unsigned char> DecompressTexture(unsigned char const* aData, int aWidth, int aHeight, TextureLayout aLayout);
+}
@@ -0,0 +1,131 @@
+#include <algorithm>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+  #include <emmintrin.h>
+  #define SOIS_MIPS_SSE2 1
+#endif
+
+#include "SOIS/TextureCompression.hpp"
+#include "SOIS/TextureMips.hpp"
+#include "SOIS/ThreadPool.hpp"
+
+namespace SOIS
+{
+  // Levels smaller than this aren't worth handing out to the pool.
+  static constexpr int cParallelRows = 64;
+
+  static void DownsampleRow(unsigned char const* aRow0, unsigned char const* aRow1, int aWidth, unsigned char* aDestination, int aDestinationWidth)
+  {
+    int x = 0;
+
+#if defined(SOIS_MIPS_SSE2)
+    __m128i const zero = _mm_setzero_si128();
+    __m128i const round = _mm_set1_epi16(2);
+
+    // Sums one source pixel pair from each row, leaving each pair's total in the low half.
+    auto sumPairs = [&zero](__m128i aTop, __m128i aBottom, __m128i& aLow, __m128i& aHigh)
+    {
+      __m128i low = _mm_add_epi16(_mm_unpacklo_epi8(aTop, zero), _mm_unpacklo_epi8(aBottom, zero));
+      __m128i high = _mm_add_epi16(_mm_unpackhi_epi8(aTop, zero), _mm_unpackhi_epi8(aBottom, zero));
+      aLow = _mm_add_epi16(low, _mm_srli_si128(low, 8));
+      aHigh = _mm_add_epi16(high, _mm_srli_si128(high, 8));
+    };
+
+    // Four destination pixels from eight source pixels on each row.
+    for (; (x + 4) * 2 <= aWidth && x + 4 <= aDestinationWidth; x += 4)
+    {
+      __m128i sums[4];
+      for (int half = 0; half < 2; ++half)
+      {
+        __m128i top = _mm_loadu_si128(reinterpret_cast<__m128i const*>(aRow0 + (x * 2 + half * 4) * 4));
+        __m128i bottom = _mm_loadu_si128(reinterpret_cast<__m128i const*>(aRow1 + (x * 2 + half * 4) * 4));
+        sumPairs(top, bottom, sums[half * 2], sums[half * 2 + 1]);
+      }
+
+      __m128i first = _mm_srli_epi16(_mm_add_epi16(_mm_unpacklo_epi64(sums[0], sums[1]), round), 2);
+      __m128i second = _mm_srli_epi16(_mm_add_epi16(_mm_unpacklo_epi64(sums[2], sums[3]), round), 2);
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(aDestination + x * 4), _mm_packus_epi16(first, second));
+    }
+#endif
+
+    for (; x < aDestinationWidth; ++x)
+    {
+      int x0 = std::min(x * 2, aWidth - 1);
+      int x1 = std::min(x * 2 + 1, aWidth - 1);
+
+      for (int c = 0; c < 4; ++c)
+      {
+        int sum = aRow0[x0 * 4 + c] + aRow0[x1 * 4 + c] + aRow1[x0 * 4 + c] + aRow1[x1 * 4 + c];
+        aDestination[x * 4 + c] = static_cast<unsigned char>((sum + 2) >> 2);
+      }
+    }
+  }
+
+  // 2x2 box filter into the next level down, odd sizes round down like GPU mip chains
+  // do, which drops the last row/column.
+  static void Downsample(unsigned char const* aSource, int aWidth, int aHeight, int aPitch, unsigned char* aDestination, ThreadPool* aPool)
+  {
+    int destinationWidth = GetMipSize(aWidth, 1);
+    int destinationHeight = GetMipSize(aHeight, 1);
+
+    auto downsampleRow = [&](size_t aY)
+    {
+      int y = static_cast<int>(aY);
+      unsigned char const* row0 = aSource + static_cast<size_t>(std::min(y * 2, aHeight - 1)) * aPitch;
+      unsigned char const* row1 = aSource + static_cast<size_t>(std::min(y * 2 + 1, aHeight - 1)) * aPitch;
+      DownsampleRow(row0, row1, aWidth, aDestination + static_cast<size_t>(y) * destinationWidth * 4, destinationWidth);
+    };
+
+    if (nullptr != aPool && destinationHeight >= cParallelRows)
+    {
+      aPool->ParallelFor(destinationHeight, downsampleRow);
+    }
+    else
+    {
+      for (int y = 0; y < destinationHeight; ++y)
+      {
+        downsampleRow(y);
+      }
+    }
+  }
+
+  std::vector<unsigned char> GenerateMipChain(unsigned char const* aData, int aWidth, int aHeight, int aPitch, TextureLayout aLayout, ThreadPool* aPool)
+  {
+    int levels = GetMipLevelCount(aWidth, aHeight);
+
+    // Downsample everything as RGBA8 first, compressed layouts are encoded from this after.
+    std::vector<unsigned char> chain(GetMipOffset(TextureLayout::RGBA_Unorm, aWidth, aHeight, levels));
+
+    for (int y = 0; y < aHeight; ++y)
+    {
+      memcpy(chain.data() + static_cast<size_t>(y) * aWidth * 4, aData + static_cast<size_t>(y) * aPitch, static_cast<size_t>(aWidth) * 4);
+    }
+
+    for (int level = 1; level < levels; ++level)
+    {
+      int width = GetMipSize(aWidth, level - 1);
+      unsigned char const* source = chain.data() + GetMipOffset(TextureLayout::RGBA_Unorm, aWidth, aHeight, level - 1);
+      unsigned char* destination = chain.data() + GetMipOffset(TextureLayout::RGBA_Unorm, aWidth, aHeight, level);
+      Downsample(source, width, GetMipSize(aHeight, level - 1), width * 4, destination, aPool);
+    }
+
+    if (!IsBlockCompressed(aLayout))
+    {
+      return chain;
+    }
+
+    std::vector<unsigned char> compressed;
+    compressed.reserve(GetMipOffset(aLayout, aWidth, aHeight, levels));
+
+    for (int level = 0; level < levels; ++level)
+    {
+      int width = GetMipSize(aWidth, level);
+      unsigned char const* source = chain.data() + GetMipOffset(TextureLayout::RGBA_Unorm, aWidth, aHeight, level);
+      auto blocks = CompressTexture(source, width, GetMipSize(aHeight, level), width * 4, aLayout, aPool);
+      compressed.insert(compressed.end(), blocks.begin(), blocks.end());
+    }
+
+    return compressed;
+  }
+}
@@ -0,0 +1,15 @@
+#pragma once
+
+#include <vector>
+
+#include "SOIS/Renderer.hpp"
+
+namespace SOIS
+{
+  class ThreadPool;
+
+  // Builds the full mip chain of an RGBA8 image with a 2x2 box filter, every level
+  // tightly packed after the last in aLayout (see GetMipOffset). Block compressed
+  // layouts are downsampled as RGBA8 and then compressed level by level.
+  std::vector<unsigned char> GenerateMipChain(unsigned char const* aData, int aWidth, int aHeight, int aPitch, TextureLayout aLayout, ThreadPool* aPool = nullptr);
+}
@@ -0,0 +1,124 @@
+#include <algorithm>
+#include <atomic>
+#include <memory>
+
+#include "SOIS/ThreadPool.hpp"
+
+namespace SOIS
+{
+  ThreadPool::ThreadPool(size_t aThreadCount)
+  {
+    if (0 == aThreadCount)
+    {
+      aThreadCount = std::thread::hardware_concurrency();
+    }
+
+    if (0 == aThreadCount)
+    {
+      aThreadCount = 1;
+    }
+
+    mThreads.reserve(aThreadCount);
+    for (size_t i = 0; i < aThreadCount; ++i)
+    {
+      mThreads.emplace_back(&ThreadPool::WorkerLoop, this);
+    }
+  }
+
+  ThreadPool::~ThreadPool()
+  {
+    {
+      std::unique_lock lock{ mMutex };
+      mStopping = true;
+
+      // Anything that hasn't started yet is dropped, jobs are expected to hold on
+      // to whatever state they need so they can be safely discarded.
+      mJobs.clear();
+    }
+
+    mJobAvailable.notify_all();
+
+    for (auto& thread : mThreads)
+    {
+      thread.join();
+    }
+  }
+
+  void ThreadPool::Submit(std::function<void()> aJob)
+  {
+    {
+      std::unique_lock lock{ mMutex };
+      mJobs.emplace_back(std::move(aJob));
+    }
+
+    mJobAvailable.notify_one();
+  }
+
+  void ThreadPool::ParallelFor(size_t aCount, std::function<void(size_t)> const& aJob)
+  {
+    if (0 == aCount)
+    {
+      return;
+    }
+
+    struct SharedState
+    {
+      std::atomic<size_t> mNext{ 0 };
+      std::atomic<size_t> mFinished{ 0 };
+      std::mutex mMutex;
+      std::condition_variable mDone;
+    };
+
+    auto state = std::make_shared<SharedState>();
+
+    // Helpers only touch aJob while they hold an index, and we don't return until
+    // every index has finished, so capturing it by pointer is fine.
+    auto runIndices = [state, aCount, job = &aJob]()
+    {
+      size_t index;
+      while ((index = state->mNext.fetch_add(1)) < aCount)
+      {
+        (*job)(index);
+
+        if ((state->mFinished.fetch_add(1) + 1) == aCount)
+        {
+          std::unique_lock lock{ state->mMutex };
+          state->mDone.notify_all();
+        }
+      }
+    };
+
+    size_t helpers = std::min(mThreads.size(), aCount - 1);
+    for (size_t i = 0; i < helpers; ++i)
+    {
+      Submit(runIndices);
+    }
+
+    runIndices();
+
+    std::unique_lock lock{ state->mMutex };
+    state->mDone.wait(lock, [&state, aCount]() { return state->mFinished.load() == aCount; });
+  }
+
+  void ThreadPool::WorkerLoop()
+  {
+    std::unique_lock lock{ mMutex };
+
+    while (true)
+    {
+      mJobAvailable.wait(lock, [this]() { return mStopping || !mJobs.empty(); });
+
+      if (mStopping)
+      {
+        return;
+      }
+
+      auto job = std::move(mJobs.front());
+      mJobs.pop_front();
+
+      lock.unlock();
+      job();
+      lock.lock();
+    }
+  }
+}
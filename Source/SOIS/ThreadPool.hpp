@@ -0,0 +1,45 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace SOIS
+{
+  // Small fixed size pool of worker threads. Jobs are run in the order they're
+  // submitted, ParallelFor blocks the calling thread until every index has run.
+  class ThreadPool
+  {
+  public:
+    // A thread count of 0 picks one thread per hardware thread.
+    ThreadPool(size_t aThreadCount = 0);
+    ~ThreadPool();
+
+    ThreadPool(ThreadPool const&) = delete;
+    ThreadPool& operator=(ThreadPool const&) = delete;
+
+    void Submit(std::function<void()> aJob);
+
+    // Runs aJob(i) for every i in [0, aCount), the calling thread helps out
+    // so this is safe to call with a pool of a single thread.
+    void ParallelFor(size_t aCount, std::function<void(size_t)> const& aJob);
+
+    size_t GetThreadCount() const
+    {
+      return mThreads.size();
+    }
+
+  private:
+    void WorkerLoop();
+
+    std::vector<std::thread> mThreads;
+    std::deque<std::function<void()>> mJobs;
+    std::mutex mMutex;
+    std::condition_variable mJobAvailable;
+    bool mStopping = false;
+  };
+}